@@ -6,6 +6,7 @@
 // Project includes.
 #include "Core/ApplicationBase.h"
 #include "Core/Events.h"
+#include "Core/TaskGraph.h"
 #include "Graphics/FrameBuffer.h"
 #include "Graphics/EditorCamera.h"
 #include "Layers/Layers.h"
@@ -44,6 +45,7 @@ namespace Strontium
     Entity getSelectedEntity();
     SceneState getSceneState() { return this->sceneState; }
     std::string& getDNDScenePath() { return this->dndScenePath; }
+    TaskGraph& getFrameGraph() { return this->frameGraph; }
 
     void saveWindows();
   protected:
@@ -60,6 +62,8 @@ namespace Strontium
     Shared<FrameBuffer> drawBuffer;
     // Editor camera.
     Shared<EditorCamera> editorCam;
+    // The per-frame graph of scene and renderer stages.
+    TaskGraph frameGraph;
 
     // Managing the current scene.
     SceneState sceneState;
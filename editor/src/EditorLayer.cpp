@@ -217,14 +217,14 @@ namespace Strontium
     {
       case SceneState::Edit:
       {
-        // Update the scene.
-        this->currentScene->onUpdateEditor(dt);
-
-        // Draw the scene.
+        // Update and draw the scene.
         this->drawBuffer->clear();
-        Renderer3D::begin(this->editorSize.x, this->editorSize.y, (Camera) (*this->editorCam.get()));
-        this->currentScene->onRenderEditor(this->getSelectedEntity());
-        Renderer3D::end(this->drawBuffer);
+        this->frameGraph.clear();
+        Renderer3D::registerFrameTasks(this->frameGraph, this->editorSize.x,
+                                       this->editorSize.y, (Camera) (*this->editorCam.get()),
+                                       this->drawBuffer);
+        this->currentScene->registerEditorTasks(this->frameGraph, dt, this->getSelectedEntity());
+        this->frameGraph.execute();
 
         // Update the editor camera.
         this->editorCam->onUpdate(dt);
@@ -233,9 +233,6 @@ namespace Strontium
 
       case SceneState::Play:
       {
-        // Update the scene.
-        this->currentScene->onUpdateRuntime(dt);
-
         // Fetch the primary camera entity.
         auto primaryCameraEntity = this->currentScene->getPrimaryCameraEntity();
         Camera primaryCamera;
@@ -255,10 +252,14 @@ namespace Strontium
           this->editorCam->onUpdate(dt);
         }
 
+        // Update and draw the scene.
         this->drawBuffer->clear();
-        Renderer3D::begin(this->editorSize.x, this->editorSize.y, primaryCamera);
-        this->currentScene->onRenderRuntime();
-        Renderer3D::end(this->drawBuffer);
+        this->frameGraph.clear();
+        Renderer3D::registerFrameTasks(this->frameGraph, this->editorSize.x,
+                                       this->editorSize.y, primaryCamera,
+                                       this->drawBuffer);
+        this->currentScene->registerRuntimeTasks(this->frameGraph, dt);
+        this->frameGraph.execute();
         break;
       }
     }
@@ -5,6 +5,7 @@
 #include "GuiElements/Styles.h"
 #include "Scenes/Entity.h"
 #include "GuiElements/Styles.h"
+#include "Graphics/ModelCache.h"
 
 namespace Strontium
 {
@@ -251,7 +252,8 @@ namespace Strontium
     {
       std::string name = entry.path().filename().string();
 
-      if (entry.is_regular_file() && name[0] != '.')
+      if (entry.is_regular_file() && name[0] != '.'
+          && entry.path().extension().string() != MODEL_CACHE_EXTENSION)
       {
         ImGui::TreeNodeEx(name.c_str(), leafFlag);
 
@@ -327,8 +329,8 @@ namespace Strontium
         std::string fileName = entry.path().filename().string();
         std::string fileExt = entry.path().extension().string();
 
-        // Ignore hidden files.
-        if (fileName[0] == '.')
+        // Ignore hidden files and cooked models.
+        if (fileName[0] == '.' || fileExt == MODEL_CACHE_EXTENSION)
           continue;
 
         if (this->searched != "" && fileName.find(this->searched) == std::string::npos)
@@ -118,6 +118,9 @@ namespace Strontium
             ImGui::Text("Duration: %f", animation.getDuration());
             ImGui::Text("Ticks per second: %f", animation.getTPS());
             ImGui::Text("Total number of nodes: %d", animation.getAniNodes().size());
+            ImGui::Text("Keyframe memory: %.2f KB (%.2f KB uncompressed)",
+                        animation.getKeyframeMemory() / 1024.0f,
+                        animation.getRawKeyframeMemory() / 1024.0f);
 
             ImGui::Separator();
             ImGui::Text("Animation Nodes");
@@ -132,7 +135,10 @@ namespace Strontium
                   bool isSelected = (&aniNode.second == this->selectedAniNode);
 
                   if (ImGui::Selectable(aniNode.first.c_str(), isSelected))
+                  {
                     this->selectedAniNode = (&aniNode.second);
+                    animation.decodeNodeKeys(aniNode.second);
+                  }
 
                   if (isSelected)
                     ImGui::SetItemDefaultFocus();
@@ -186,7 +192,10 @@ namespace Strontium
                   bool isSelected = (&aniNode.second == this->selectedAniNode);
 
                   if (ImGui::Selectable(aniNode.first.c_str(), isSelected))
+                  {
                     this->selectedAniNode = (&aniNode.second);
+                    animation.decodeNodeKeys(aniNode.second);
+                  }
 
                   if (isSelected)
                     ImGui::SetItemDefaultFocus();
@@ -2,6 +2,7 @@
 
 // Project includes.
 #include "Graphics/Renderer.h"
+#include "EditorLayer.h"
 
 // ImGui includes.
 #include "imgui/imgui.h"
@@ -28,21 +29,121 @@ namespace Strontium
 
     ImGui::Begin("Renderer Settings", &isOpen);
 
+    ImGui::Text("Culling frametime: %f ms", stats->cullFrametime);
     ImGui::Text("Geometry pass frametime: %f ms", stats->geoFrametime);
     ImGui::Text("Shadow pass frametime: %f ms", stats->shadowFrametime);
     ImGui::Text("Lighting pass frametime: %f ms", stats->lightFrametime);
     ImGui::Text("Post-processing pass frametime: %f ms", stats->postFramtime);
     ImGui::Text("");
 
-    ImGui::Text("Drawcalls: %u", stats->drawCalls);
+    ImGui::Text("Drawcalls: %u (%u draws)", stats->drawCalls, stats->drawCommands);
+    ImGui::Text("Instanced meshes: %u", stats->numInstances);
     ImGui::Text("Total vertices: %u", stats->numVertices);
     ImGui::Text("Total triangles: %u", stats->numTriangles);
     ImGui::Text("Total lights: D: %u, P: %u, S: %u", stats->numDirLights,
                 stats->numPointLights, stats->numSpotLights);
+    ImGui::Text("Clustered lights GPU time: %f ms", stats->clusteredLightGPUTime);
+    ImGui::Text("Active clusters: %u / %u", stats->numActiveClusters, NUM_CLUSTERS);
+    ImGui::Text("Lights per cluster: Avg: %.2f, Max: %u (%u overflowed)",
+                stats->avgLightsPerCluster, stats->maxLightsPerCluster,
+                stats->numOverflowedClusters);
+    ImGui::Text("Skipped binds: Shader: %u, Material: %u",
+                stats->skippedShaderBinds, stats->skippedMaterialBinds);
+    ImGui::Text("Animators: %u (%u reduced rate, %u frozen)", stats->numAnimators,
+                stats->numReducedRateAnimators, stats->numFrozenAnimators);
+    ImGui::Text("Skinned vertices: %u", stats->numSkinnedVertices);
 
     ImGui::Checkbox("Frustum Cull", &state->frustumCull);
+    ImGui::Checkbox("GPU Culling", &state->gpuCulling);
+    ImGui::Checkbox("Compute Skinning", &state->computeSkinning);
     ImGui::Checkbox("Enable FXAA", &state->enableFXAA);
 
+    if (ImGui::CollapsingHeader("Animation LOD"))
+    {
+      ImGui::Checkbox("Enable Animation LOD", &state->animationLOD);
+      ImGui::Checkbox("Freeze Off-screen", &state->aniLODFreezeOffscreen);
+      ImGui::DragFloat("Full Rate Size", &state->aniLODFullRateSize, 0.005f, 0.0f, 1.0f);
+      ImGui::DragFloat("Half Rate Size", &state->aniLODHalfRateSize, 0.005f, 0.0f, 1.0f);
+      ImGui::DragFloat("Reduced Bones Size", &state->aniLODReducedBonesSize, 0.005f, 0.0f, 1.0f);
+
+      int droppedLevels = state->aniLODDroppedBoneLevels;
+      if (ImGui::InputInt("Dropped Bone Levels", &droppedLevels))
+        state->aniLODDroppedBoneLevels = std::max(droppedLevels, 0);
+    }
+
+    if (ImGui::CollapsingHeader("Mesh LOD"))
+    {
+      ImGui::Checkbox("Enable Mesh LOD", &state->meshLOD);
+      ImGui::DragFloat("Error Threshold (px)", &state->meshLODThreshold, 0.05f, 0.0f, 64.0f);
+      ImGui::DragFloat("Shadow Bias", &state->meshLODShadowBias, 0.05f, 1.0f, 64.0f);
+
+      std::string geometryTriangles, shadowTriangles;
+      for (uint i = 0; i < MAX_MESH_LODS; i++)
+      {
+        geometryTriangles += " " + std::to_string(stats->numLODTriangles[i]);
+        shadowTriangles += " " + std::to_string(stats->numShadowLODTriangles[i]);
+      }
+      ImGui::Text("Geometry triangles per LOD:%s", geometryTriangles.c_str());
+      ImGui::Text("Shadow triangles per LOD:%s", shadowTriangles.c_str());
+    }
+
+    if (ImGui::CollapsingHeader("Meshlet Culling"))
+    {
+      ImGui::Checkbox("Enable Meshlet Culling", &state->meshletCulling);
+      ImGui::Checkbox("Normal Cone Culling", &state->meshletConeCulling);
+
+      float numMeshlets = std::max(stats->numMeshlets, 1u);
+      float numShadowMeshlets = std::max(stats->numShadowMeshlets, 1u);
+      ImGui::Text("Geometry meshlets: %u (%.1f%% frustum, %.1f%% cone culled)",
+                  stats->numMeshlets, 100.0f * stats->numFrustumCulledMeshlets / numMeshlets,
+                  100.0f * stats->numConeCulledMeshlets / numMeshlets);
+      ImGui::Text("Shadow meshlets: %u (%.1f%% frustum, %.1f%% cone culled)",
+                  stats->numShadowMeshlets,
+                  100.0f * stats->numShadowFrustumCulledMeshlets / numShadowMeshlets,
+                  100.0f * stats->numShadowConeCulledMeshlets / numShadowMeshlets);
+    }
+
+    if (ImGui::CollapsingHeader("Occlusion Culling"))
+    {
+      ImGui::Checkbox("Enable Occlusion Culling", &state->occlusionCulling);
+
+      float numTested = std::max(stats->numOcclusionTested, 1u);
+      ImGui::Text("Tested submeshes: %u", stats->numOcclusionTested);
+      ImGui::Text("Occluded submeshes: %u (%.1f%%)", stats->numOcclusionCulled,
+                  100.0f * stats->numOcclusionCulled / numTested);
+      ImGui::Text("Depth pyramid: %s", storage->depthPyramid.valid ? "ready" : "not read back yet");
+    }
+
+    if (ImGui::CollapsingHeader("Static Batching"))
+    {
+      auto& batcher = activeScene->getStaticBatcher();
+      bool batching = batcher.isEnabled();
+      if (ImGui::Checkbox("Enable Static Batching", &batching))
+        batcher.setEnabled(batching);
+
+      auto& batchStats = batcher.getStats();
+      ImGui::Text("Batches: %u", batchStats.numBatches);
+      ImGui::Text("Batched entities: %u", batchStats.numSourceEntities);
+      ImGui::Text("Batched vertices: %u", batchStats.numVertices);
+      ImGui::Text("Batches rebuilt this frame: %u", batchStats.numRebuiltBatches);
+    }
+
+    if (ImGui::CollapsingHeader("Frame Task Graph"))
+    {
+      auto& frameGraph = this->parentLayer->getFrameGraph();
+
+      ImGui::Text("Total frametime: %f ms", frameGraph.getTotalTime());
+      ImGui::Text("Critical path: %f ms", frameGraph.getCriticalPathTime());
+      ImGui::Text("");
+
+      // Tasks on the critical path are marked with an asterisk.
+      for (auto& timing : frameGraph.getTimings())
+      {
+        ImGui::Text("%s%s: %f ms (started at %f ms)", timing.onCriticalPath ? "* " : "",
+                    timing.name.c_str(), timing.duration, timing.startTime);
+      }
+    }
+
     // TODO: Soft shadow quality settings (Hard shadows, Low, medium, high, ultra). 
     // Low is a simple box blur, medium->ultra are gaussian with different number 
     // of taps.Hard shadows are regular shadow maps with zero prefiltering.
@@ -201,9 +201,19 @@ namespace Strontium
     // Only draw the gizmo if the entity has a transform component and if a gizmo is selected.
     if (entity.hasComponent<TransformComponent>() && this->gizmoType != -1)
     {
-      // Fetch the transform component.
+      // Fetch the transform component. The gizmo works in world space, use
+      // the cached world transforms of the entity and its parent.
       auto& transform = entity.getComponent<TransformComponent>();
       glm::mat4 transformMatrix = transform;
+      glm::mat4 parentMatrix = glm::mat4(1.0f);
+      if (entity.hasComponent<WorldTransformComponent>())
+        transformMatrix = entity.getComponent<WorldTransformComponent>().worldMatrix;
+      if (entity.hasComponent<ParentEntityComponent>())
+      {
+        auto parent = entity.getComponent<ParentEntityComponent>().parent;
+        if (parent.hasComponent<WorldTransformComponent>())
+          parentMatrix = parent.getComponent<WorldTransformComponent>().worldMatrix;
+      }
 
       // Manipulate the matrix. TODO: Add snapping.
       ImGuizmo::Manipulate(glm::value_ptr(camView), glm::value_ptr(camProjection),
@@ -216,7 +226,8 @@ namespace Strontium
         glm::vec3 translation, scale, skew;
         glm::vec4 perspective;
         glm::quat rotation;
-        glm::decompose(transformMatrix, scale, rotation, translation, skew, perspective);
+        glm::mat4 localMatrix = glm::inverse(parentMatrix) * transformMatrix;
+        glm::decompose(localMatrix, scale, rotation, translation, skew, perspective);
 
         transform.translation = translation;
         transform.rotation = glm::eulerAngles(rotation);
@@ -32,11 +32,57 @@ namespace Strontium
     float bSphereRadius;
   };
 
+  // Worldspace AABBs packed as a structure of arrays for batch culling. The
+  // arrays are padded out to a multiple of 32 boxes so each visibility mask
+  // word is owned by a single batch.
+  struct BoundingBoxArray
+  {
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+    uint count;
+
+    BoundingBoxArray()
+      : count(0)
+    { }
+
+    // Resize to hold numBoxes boxes. The padding boxes are zeroed.
+    void resize(uint numBoxes);
+    void clear() { this->resize(0); }
+
+    // Set a box, safe to call from multiple threads for different indices.
+    void set(uint index, const BoundingBox &box);
+
+    uint paddedCount() const { return this->centerX.size(); }
+  };
+
+  // Bitmask of visible boxes, bit i of word i / 32 is set if box i is visible.
+  typedef std::vector<uint> VisibilityMask;
+
+  inline bool
+  isVisible(const VisibilityMask &mask, uint index)
+  {
+    return (mask[index >> 5] >> (index & 31)) & 1u;
+  }
+
   // Builds a bounding box given the min+max coordinates of an object (in local space).
   BoundingBox buildBoundingBox(const glm::vec3 &min, const glm::vec3 &max);
   // Builds an AABB given the min+max coordinates of an object plus the localspace to worldspace transformation matrix.
   BoundingBox buildBoundingBox(const glm::vec3& min, const glm::vec3& max, const glm::mat4 &modelMatrix);
 
+  // Grow the bounds (outMin, outMax) to contain the box (min, max) transformed
+  // by an affine matrix. Uses SSE when available.
+  void expandTransformedBounds(const glm::vec3 &min, const glm::vec3 &max,
+                               const glm::mat4 &transform, glm::vec3 &outMin,
+                               glm::vec3 &outMax);
+
+  // Octahedral encoding of unit vectors, both components are in [-1, 1].
+  glm::vec2 encodeOctahedral(const glm::vec3 &vector);
+  glm::vec3 decodeOctahedral(const glm::vec2 &encoded);
+
   // Builds a camera frustum given a camera struct.
   Frustum buildCameraFrustum(const Camera &camera);
 
@@ -50,4 +96,11 @@ namespace Strontium
   bool boundingBoxInFrustum(const Frustum &frustum, const glm::vec3 min, const glm::vec3 max);
   bool boundingBoxInFrustum(const Frustum& frustum, const glm::vec3 min, const glm::vec3 max, 
                             const glm::mat4 &transform);
+
+  // Batch test a set of worldspace boxes against numFrustums frustums, writing
+  // one visibility mask per frustum. Uses SSE/AVX when available and splits the
+  // boxes across the thread pool when there are enough of them.
+  void boundingBoxesInFrustums(const BoundingBoxArray &boxes, const Frustum* frustums,
+                               uint numFrustums, VisibilityMask* outMasks,
+                               bool multithreaded = true);
 }
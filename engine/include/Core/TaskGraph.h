@@ -0,0 +1,112 @@
+#pragma once
+
+// Macro include file.
+#include "StrontiumPCH.h"
+
+// Project includes.
+#include "Core/ApplicationBase.h"
+#include "Core/ThreadPool.h"
+
+namespace Strontium
+{
+  // Where a task is allowed to execute. Anything which touches the OpenGL
+  // context has to run on the main thread.
+  enum class TaskAffinity
+  {
+    Any = 0,
+    MainThread = 1
+  };
+
+  // Timing information for a single task, in milliseconds relative to the
+  // start of the graph execution.
+  struct TaskTiming
+  {
+    std::string name;
+    float startTime;
+    float duration;
+    bool onCriticalPath;
+
+    TaskTiming()
+      : name("")
+      , startTime(0.0f)
+      , duration(0.0f)
+      , onCriticalPath(false)
+    { }
+  };
+
+  // A directed acyclic graph of named tasks which gets executed on the engine
+  // thread pool. Tasks are referenced by name so different systems can wire
+  // their stages together without knowing about each other, dependencies on
+  // tasks which were never added are ignored. The graph is rebuilt each frame.
+  class TaskGraph
+  {
+  public:
+    TaskGraph();
+    ~TaskGraph();
+
+    // Add a task to the graph. Task names must be unique.
+    void addTask(const std::string &name, const std::function<void()> &task,
+                 TaskAffinity affinity = TaskAffinity::Any);
+
+    // Add an edge so that the task "after" only starts once "before" finishes.
+    void addDependency(const std::string &before, const std::string &after);
+
+    // Execute all the tasks, returns once every task has finished. The calling
+    // thread executes the main thread tasks and helps out with the others.
+    void execute();
+
+    // Remove all the tasks (but not the timings of the last execution).
+    void clear();
+
+    bool hasTask(const std::string &name) { return this->taskIndices.find(name) != this->taskIndices.end(); }
+
+    const std::vector<TaskTiming>& getTimings() const { return this->timings; }
+    const std::vector<std::string>& getCriticalPath() const { return this->criticalPath; }
+    float getCriticalPathTime() const { return this->criticalPathTime; }
+    float getTotalTime() const { return this->totalTime; }
+  private:
+    struct TaskNode
+    {
+      std::string name;
+      std::function<void()> task;
+      TaskAffinity affinity;
+
+      std::vector<uint> successors;
+      uint numDependencies;
+
+      TaskNode(const std::string &name, const std::function<void()> &task,
+               TaskAffinity affinity)
+        : name(name)
+        , task(task)
+        , affinity(affinity)
+        , numDependencies(0)
+      { }
+    };
+
+    // Resolve the named edges, returns false if the graph has a cycle.
+    bool compile();
+    void computeCriticalPath();
+
+    void schedule(uint taskIndex);
+    void runTask(uint taskIndex);
+
+    std::vector<TaskNode> tasks;
+    std::unordered_map<std::string, uint> taskIndices;
+    std::vector<std::pair<std::string, std::string>> dependencies;
+
+    // Execution state.
+    std::vector<uint> topologicalOrder;
+    Unique<std::atomic<uint>[]> pendingDependencies;
+    std::atomic<uint> remainingTasks;
+    std::queue<uint> mainThreadTasks;
+    std::mutex mainThreadMutex;
+    JobCounter workerTasks;
+    std::chrono::steady_clock::time_point executionStart;
+
+    // Stats from the last execution.
+    std::vector<TaskTiming> timings;
+    std::vector<std::string> criticalPath;
+    float criticalPathTime;
+    float totalTime;
+  };
+}
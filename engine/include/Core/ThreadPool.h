@@ -11,13 +11,144 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
-#include <future>
 #include <atomic>
+#include <tuple>
+#include <type_traits>
+#include <new>
 
 namespace Strontium
 {
-  // A thread pool to support safe concurrency in SciRender. Its a singleton to
-  // force all modes of execution to go through one pipeline, preventing unnecessary spawns.
+  // Maximum number of jobs which can be queued up on a single worker before
+  // the submitting thread starts executing jobs inline.
+  #define MAX_JOBS_PER_WORKER 1024
+
+  // A counter which tracks the number of jobs in flight. Jobs decrement the
+  // counter they were submitted with once they finish executing.
+  class JobCounter
+  {
+  public:
+    JobCounter()
+      : count(0)
+    { }
+
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    void add(uint numJobs) { this->count.fetch_add(numJobs, std::memory_order_relaxed); }
+    void decrement() { this->count.fetch_sub(1, std::memory_order_acq_rel); }
+    bool isDone() const { return this->count.load(std::memory_order_acquire) == 0; }
+    uint getCount() const { return this->count.load(std::memory_order_acquire); }
+  private:
+    std::atomic<uint> count;
+  };
+
+  // A one-shot fence. Signaled by a job (or any thread) to let waiting threads
+  // continue. Reset it to reuse it.
+  class JobFence
+  {
+  public:
+    JobFence()
+      : signaled(false)
+    { }
+
+    JobFence(const JobFence&) = delete;
+    JobFence& operator=(const JobFence&) = delete;
+
+    void signal() { this->signaled.store(true, std::memory_order_release); }
+    void reset() { this->signaled.store(false, std::memory_order_relaxed); }
+    bool isSignaled() const { return this->signaled.load(std::memory_order_acquire); }
+  private:
+    std::atomic_bool signaled;
+  };
+
+  // A type erased job. Small callables are stored inline so queueing them
+  // doesn't touch the heap, larger ones fall back to a heap allocation.
+  class Job
+  {
+  public:
+    Job()
+      : invokeFunc(nullptr)
+      , manageFunc(nullptr)
+      , counter(nullptr)
+    { }
+
+    template <typename Function, typename = std::enable_if_t<!std::is_same<std::decay_t<Function>, Job>::value>>
+    Job(Function&& func, JobCounter* counter = nullptr)
+      : counter(counter)
+    {
+      typedef std::decay_t<Function> Stored;
+
+      if constexpr (sizeof(Stored) <= inlineSize && alignof(Stored) <= alignof(std::max_align_t)
+                    && std::is_nothrow_move_constructible<Stored>::value)
+      {
+        new (this->storage) Stored(std::forward<Function>(func));
+
+        this->invokeFunc = [](void* storage)
+        {
+          (*std::launder(reinterpret_cast<Stored*>(storage)))();
+        };
+        this->manageFunc = [](ManageOp op, void* dst, void* src)
+        {
+          if (op == ManageOp::Move)
+          {
+            Stored* source = std::launder(reinterpret_cast<Stored*>(src));
+            new (dst) Stored(std::move(*source));
+            source->~Stored();
+          }
+          else
+            std::launder(reinterpret_cast<Stored*>(dst))->~Stored();
+        };
+      }
+      else
+      {
+        *reinterpret_cast<Stored**>(this->storage) = new Stored(std::forward<Function>(func));
+
+        this->invokeFunc = [](void* storage)
+        {
+          (**reinterpret_cast<Stored**>(storage))();
+        };
+        this->manageFunc = [](ManageOp op, void* dst, void* src)
+        {
+          if (op == ManageOp::Move)
+            *reinterpret_cast<Stored**>(dst) = *reinterpret_cast<Stored**>(src);
+          else
+            delete *reinterpret_cast<Stored**>(dst);
+        };
+      }
+    }
+
+    Job(Job&& other);
+    Job& operator=(Job&& other);
+    ~Job();
+
+    // Jobs can only be moved.
+    Job(const Job&) = delete;
+    Job& operator=(const Job&) = delete;
+
+    // Execute the job, releases the callable and decrements the counter.
+    void operator()();
+
+    bool isValid() const { return this->invokeFunc != nullptr; }
+
+    // Check if the job was submitted with the counter.
+    bool belongsTo(const JobCounter &jobCounter) const { return this->counter == &jobCounter; }
+  private:
+    enum class ManageOp { Move, Destroy };
+
+    static constexpr std::size_t inlineSize = 48;
+
+    void release();
+
+    alignas(std::max_align_t) unsigned char storage[inlineSize];
+    void (*invokeFunc)(void*);
+    void (*manageFunc)(ManageOp, void*, void*);
+    JobCounter* counter;
+  };
+
+  // A work stealing thread pool to support safe concurrency in Strontium. Its
+  // a singleton to force all modes of execution to go through one pipeline,
+  // preventing unnecessary spawns. Each worker owns a deque of jobs, it pops
+  // from the bottom of its own deque and steals from the top of the others.
   class ThreadPool
   {
   public:
@@ -28,73 +159,146 @@ namespace Strontium
 
     ~ThreadPool();
 
-    // Fetch the pool.
-    static ThreadPool* getInstance(unsigned int numThreads);
+    // Fetch the pool. Zero threads sizes the pool off of the hardware
+    // concurrency (leaving a core for the main thread).
+    static ThreadPool* getInstance(unsigned int numThreads = 0);
 
-    // Queue up jobs for the workers to execute.
-    template <typename Function, typename... Args >
-    auto push(Function&& func, Args&&... args)
+    // Queue up a fire and forget job for the workers to execute.
+    template <typename Function, typename... Args>
+    void push(Function&& func, Args&&... args)
     {
-      // Fetch the return type of the function.
-      typedef decltype(func(args...)) retType;
+      this->submit(Job([func = std::forward<Function>(func),
+                        arguments = std::make_tuple(std::forward<Args>(args)...)]() mutable
+      {
+        std::apply(func, arguments);
+      }));
+    }
 
-      // Package up the function and its arguements.
-      std::packaged_task<retType()> newTask(std::move(std::bind(func, args...)));
+    // Queue up a long running fire and forget job, like an asset import.
+    // Background jobs are only picked up by idle workers, never by threads
+    // executing jobs while they wait, so a wait can't end up stuck behind one.
+    // All but one of the workers run them at most.
+    template <typename Function, typename... Args>
+    void pushBackground(Function&& func, Args&&... args)
+    {
+      this->submitBackground(Job([func = std::forward<Function>(func),
+                                  arguments = std::make_tuple(std::forward<Args>(args)...)]() mutable
+      {
+        std::apply(func, arguments);
+      }));
+    }
+
+    // Queue up a job which decrements the counter once it finishes.
+    template <typename Function>
+    void push(JobCounter &counter, Function&& func)
+    {
+      counter.add(1);
+      this->submit(Job(std::forward<Function>(func), &counter));
+    }
 
-      // Lock out the task queue so the new task can be added async.
-      std::unique_lock<std::mutex> lock(taskMutex);
+    // Split the range [0, count) into chunks of grainSize and execute
+    // func(start, end) on each chunk across the workers. The calling thread
+    // executes jobs until every chunk is complete.
+    template <typename Function>
+    void parallelFor(uint count, uint grainSize, Function&& func)
+    {
+      if (count == 0)
+        return;
 
-      // Get the future for tasks which return non-void.
-      std::future<retType> returnValue = newTask.get_future();
+      grainSize = grainSize == 0 ? 1 : grainSize;
+      uint numChunks = (count + grainSize - 1) / grainSize;
 
-      // Push the task and notify one of the workers a job is available.
-      this->tasks.emplace(createShared<ReturnJob<retType>>(std::move(newTask)));
-      this->signal.notify_one();
+      if (numChunks == 1)
+      {
+        func(0u, count);
+        return;
+      }
 
-      return returnValue;
-    }
+      auto funcPtr = &func;
+      JobCounter counter;
+      counter.add(numChunks - 1);
+      for (uint i = 1; i < numChunks; i++)
+      {
+        uint start = i * grainSize;
+        uint end = std::min(start + grainSize, count);
+        this->submit(Job([funcPtr, start, end]() { (*funcPtr)(start, end); }, &counter));
+      }
 
-  private:
-    friend class Job;
-    friend class ReturnJob;
+      // Do some of the work on this thread instead of sleeping.
+      func(0u, std::min(grainSize, count));
 
-    // Inner classes to abuse function polymorphism.
-    class Job
+      this->wait(counter);
+    }
+
+    // Parallel for with a grain size picked to give each worker a few chunks.
+    template <typename Function>
+    void parallelFor(uint count, Function&& func)
     {
-    public:
-      virtual ~Job()
-      { }
+      uint grainSize = count / (4 * (this->getNumWorkers() + 1));
+      this->parallelFor(count, grainSize, std::forward<Function>(func));
+    }
 
-      virtual void execute()
-      { }
-    };
+    // Wait on a counter or fence, executing queued jobs while waiting.
+    void wait(const JobCounter &counter);
+    void wait(const JobFence &fence);
 
-    template <typename ReturnType>
-    class ReturnJob : public Job
+    // Execute a single queued job submitted with the counter on the calling
+    // thread if one is at either end of a queue. Jobs of other submitters are
+    // left alone, so the caller can't get stuck running someone else's work.
+    bool tryExecuteJob(const JobCounter &counter);
+
+    uint getNumWorkers() const { return this->workers.size(); }
+
+    // Check if the calling thread is one of the pool workers.
+    bool isWorkerThread() const;
+
+  private:
+    // Queue of jobs owned by a single worker. Guarded by a lock which the owner
+    // only contends on when another thread is stealing.
+    struct alignas(64) WorkQueue
     {
-    public:
-      ReturnJob(std::packaged_task<ReturnType()> function)
-        : function(std::move(function))
-      { }
+      std::mutex queueMutex;
+      Job jobs[MAX_JOBS_PER_WORKER];
+      uint top;
+      uint bottom;
 
-      void execute() override
-      {
-        this->function();
-      }
-    private:
-      std::packaged_task<ReturnType()> function;
+      WorkQueue()
+        : top(0)
+        , bottom(0)
+      { }
     };
 
     // Construct the thread pool.
     ThreadPool(unsigned int numThreads);
 
+    void submit(Job &&job);
+    void submitBackground(Job &&job);
+    bool tryGetJob(int workerIndex, Job &outJob);
+    bool tryGetBackgroundJob(Job &outJob);
+    bool tryPopBottom(WorkQueue &queue, Job &outJob);
+    bool tryStealTop(WorkQueue &queue, Job &outJob);
+    bool tryTakeCounted(WorkQueue &queue, const JobCounter &counter, Job &outJob);
+
+    void workerLoop(uint workerIndex);
+
     static ThreadPool* instance;
 
     // Member variables for the pool.
     std::vector<std::thread> workers;
-    std::queue<Shared<Job>> tasks;
+    std::vector<Unique<WorkQueue>> queues;
+    std::atomic<uint> nextQueue;
+
+    // Long running jobs, see pushBackground().
+    std::mutex backgroundMutex;
+    std::queue<Job> backgroundJobs;
+    std::atomic<uint> pendingBackgroundJobs;
+    std::atomic<uint> runningBackgroundJobs;
+    uint maxBackgroundJobs;
+
     std::condition_variable signal;
-    std::mutex taskMutex;
+    std::mutex sleepMutex;
+    std::atomic<uint> pendingJobs;
+    std::atomic<uint> sleepingWorkers;
     std::atomic_bool isActive;
   };
 }
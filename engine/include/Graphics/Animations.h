@@ -4,12 +4,25 @@
 #define MAX_BONES_PER_VERTEX 4
 // Maximum bones in a single model file. Using SSBOs to pass them to the skinning shaders.
 #define MAX_BONES_PER_MODEL 512
+// Poses are sampled on a fixed grid of this many samples per second, so
+// animators playing the same animation in lockstep can share a pose.
+#define ANIMATION_SAMPLE_RATE 120.0f
+// Maximum error allowed when removing keyframes at import. Translations and
+// scales are in model units, rotations in radians.
+#define ANIMATION_TRANSLATION_ERROR 0.0001f
+#define ANIMATION_ROTATION_ERROR 0.001f
+#define ANIMATION_SCALE_ERROR 0.0001f
+// Maximum number of keys a single removed run can span.
+#define ANIMATION_MAX_KEY_SPAN 256
 
 // Macro include file.
 #include "StrontiumPCH.h"
 
 #include "Assets/AssetManager.h"
 
+// STL includes.
+#include <cstdint>
+
 // Forward declare Assimp garbage.
 struct aiAnimation;
 
@@ -17,6 +30,7 @@ namespace Strontium
 {
   // Forward declare various classes.
   class Model;
+  class Animation;
 
   struct VertexBone
   {
@@ -63,6 +77,96 @@ namespace Strontium
     SceneNode() = default;
   };
 
+  // The node hierarchy of a model flattened into parent-first order, so a
+  // pose can be composed in a single linear pass over the nodes. Built once
+  // when the model is loaded.
+  struct Skeleton
+  {
+    std::vector<std::string> nodeNames;
+    std::vector<int> parents; // -1 for the root node.
+    std::vector<uint> depths; // Depth of each node in the hierarchy, 0 for the root.
+    std::vector<glm::mat4> bindTransforms; // Local transforms of the nodes.
+    std::vector<int> boneSlots; // Index into the model bones, -1 for non-bone nodes.
+    std::vector<glm::mat4> boneOffsets; // Offset matrices of the bone slots.
+    std::unordered_map<std::string, uint> nodeIndices;
+    glm::mat4 globalInverseTransform;
+    uint numBones;
+    uint maxDepth;
+
+    Skeleton()
+      : globalInverseTransform(1.0f)
+      , numBones(0)
+      , maxDepth(0)
+    { }
+
+    void build(Model &model);
+
+    // Returns -1 if the node isn't part of the skeleton.
+    int findNode(const std::string &nodeName) const;
+    uint getNumNodes() const { return this->parents.size(); }
+  };
+
+  // A translation or scale key quantized to 16 bits per component over the
+  // range of its track.
+  struct QuantizedVec3
+  {
+    uint16_t x;
+    uint16_t y;
+    uint16_t z;
+  };
+
+  // A rotation key in the smallest three encoding, 48 bits total. The index
+  // of the largest component is stored in 2 bits and the other three
+  // components in 15 bits each. The largest component is rebuilt from the
+  // unit length.
+  struct QuantizedQuat
+  {
+    uint16_t data[3];
+  };
+
+  // The keyframes of an animated node. Each channel is a contiguous range of
+  // the animation's key arrays.
+  struct AnimationTrack
+  {
+    uint node;
+
+    uint translationStart;
+    uint numTranslations;
+    uint rotationStart;
+    uint numRotations;
+    uint scaleStart;
+    uint numScales;
+
+    // Ranges the translation and scale keys are quantized over.
+    glm::vec3 translationMin;
+    glm::vec3 translationExtent;
+    glm::vec3 scaleMin;
+    glm::vec3 scaleExtent;
+
+    // Channels with a range too wide to quantize within their error bound keep
+    // full precision keys instead. The key starts index the quantized or the
+    // full precision keys, whichever the channel is stored in.
+    uint translationKeyStart;
+    uint scaleKeyStart;
+    uint32_t quantizedTranslations;
+    uint32_t quantizedScales;
+  };
+
+  // Per-animator sampling state. The key cursors of each track persist
+  // between frames so sampling a steadily advancing time only steps forward a
+  // key at a time instead of searching the whole track.
+  struct AnimationPlayback
+  {
+    const Animation* animation = nullptr;
+
+    std::vector<uint> translationCursors;
+    std::vector<uint> rotationCursors;
+    std::vector<uint> scaleCursors;
+
+    // Scratch space for the global node transforms.
+    std::vector<glm::mat4> globalTransforms;
+  };
+
   class Animation
   {
   public:
@@ -72,27 +176,57 @@ namespace Strontium
 
     void loadAnimation(const aiAnimation* animation);
 
-    void computeBoneTransforms(float aniTime, std::vector<glm::mat4> &outBones);
+    // Compile the keyframes into compressed tracks against the skeleton of
+    // the parent model. Keys which can be rebuilt by interpolating their
+    // neighbours are removed and the rest are quantized where that fits the
+    // error bounds. The raw keys are released afterwards, so this is only done
+    // once on load.
+    void compileTracks();
+
+    // Fill in the keys of an animation node from the compressed tracks, for
+    // inspecting the animation.
+    void decodeNodeKeys(AnimationNode &node) const;
+
+    // Sample the animation at aniTime and write the final bone matrices.
+    // Nodes deeper than maxDepth skip sampling and keep their bind pose.
+    // Doesn't allocate once the playback state and the output are sized for
+    // this animation.
+    void computeBoneTransforms(float aniTime, AnimationPlayback &playback,
+                               std::vector<glm::mat4> &outBones,
+                               uint maxDepth = std::numeric_limits<uint>::max()) const;
+
+    const Skeleton& getSkeleton() const;
 
     float getDuration() const { return this->duration; }
     float getTPS() const { return this->ticksPerSecond; }
     std::string getName() const { return this->name; }
     std::unordered_map<std::string, AnimationNode>& getAniNodes() { return this->animationNodes; }
+    uint getRawKeyframeMemory() const { return this->rawKeyframeMemory; }
+    uint getKeyframeMemory() const;
   private:
-    glm::mat4 interpolateTranslation(float aniTime, const AnimationNode &node);
-    glm::mat4 interpolateRotation(float aniTime, const AnimationNode &node);
-    glm::mat4 interpolateScale(float aniTime, const AnimationNode &node);
-
-    void readNodeHierarchy(float aniTime, const SceneNode &node,
-                           const glm::mat4 parentTransform,
-                           std::vector<glm::mat4> &outBones);
     Model* parentModel;
 
     std::unordered_map<std::string, AnimationNode> animationNodes;
 
+    // Compiled tracks, with the keyframe times and values of every track
+    // stored in separate arrays.
+    std::vector<AnimationTrack> tracks;
+    std::vector<int> nodeTracks; // Track index of each skeleton node, -1 if it isn't animated.
+    std::vector<float> translationTimes;
+    std::vector<QuantizedVec3> translationKeys;
+    std::vector<float> rotationTimes;
+    std::vector<QuantizedQuat> rotationKeys;
+    std::vector<float> scaleTimes;
+    std::vector<QuantizedVec3> scaleKeys;
+    std::vector<glm::vec3> fullTranslationKeys;
+    std::vector<glm::vec3> fullScaleKeys;
+    uint rawKeyframeMemory;
+
     std::string name;
     float duration;
     float ticksPerSecond;
+
+    friend class ModelCache;
   };
 
   class Animator
@@ -105,6 +239,26 @@ namespace Strontium
 
     void onUpdate(float dt);
 
+    // Advance the animation clock. Returns true if the pose is out of date,
+    // paused animators and animators still on the same sample return false.
+    bool advance(float dt);
+
+    // Sample the pose at the current sample time.
+    void evaluate();
+
+    // Reuse the pose of an animator playing the same animation at the same
+    // sample and bone LOD.
+    void copyPose(const Animator &other);
+
+    // Blend the displayed pose towards the last sampled pose. Only does work
+    // for animators updating at a reduced rate.
+    void blendPose();
+
+    // Set the level of detail. The pose is evaluated every updateInterval
+    // frames and blended in between, an interval of 0 freezes the pose. The
+    // deepest droppedBoneLevels levels of the skeleton keep their bind pose.
+    void setLOD(uint updateInterval, uint droppedBoneLevels);
+
     void startAnimation() { this->animating = true; this->paused = false; }
     void pauseAnimation() { this->paused = true; }
     void resumeAnimation() { this->paused = false; }
@@ -113,14 +267,31 @@ namespace Strontium
     std::vector<glm::mat4>& getFinalBoneTransforms() { return this->finalBoneTransforms; }
     Animation* getStoredAnimation() { return this->storedAnimation; }
     float& getAnimationTime() { return this->currentAniTime; }
+    uint getSampleIndex() const;
+    uint getUpdateInterval() const { return this->updateInterval; }
+    uint getDroppedBoneLevels() const { return this->droppedBoneLevels; }
     bool isAnimating() { return this->animating; }
     bool isPaused() { return this->paused; }
     bool animationRenderable() { return this->storedAnimation != nullptr && this->animating; }
   private:
     float currentAniTime;
+    float sampleAniTime;
     AssetHandle storedModel;
     Animation* storedAnimation;
     std::vector<glm::mat4> finalBoneTransforms;
+    AnimationPlayback playback;
+
+    // The animation and sample the current pose was evaluated at.
+    const Animation* evaluatedAnimation;
+    uint evaluatedSample;
+
+    // Level of detail. Reduced rate animators sample a pose ahead of time
+    // and blend towards it until the next evaluation.
+    uint updateInterval;
+    uint droppedBoneLevels;
+    uint framesSinceEvaluation;
+    std::vector<glm::mat4> sampledBoneTransforms;
+    std::vector<glm::mat4> blendStartTransforms;
 
     bool animating;
     bool paused;
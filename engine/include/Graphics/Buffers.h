@@ -7,6 +7,9 @@
 // Project includes.
 #include "Core/ApplicationBase.h"
 
+// Number of frames the CPU can write ahead of the GPU in a ring buffer.
+#define NUM_RING_BUFFER_FRAMES 3
+
 namespace Strontium
 {
   // Draw types.
@@ -192,9 +195,15 @@ namespace Strontium
     void bindToPoint(const uint bindPoint);
     void unbind();
 
+    // Reallocate the buffer, the previous contents are discarded.
+    void resize(uint bufferSize, BufferType bufferType);
+
     // Set the data in a region of the buffer.
     void setData(uint start, uint newDataSize, const void* newData);
 
+    // Read a region of the buffer back. Waits for pending writes to finish.
+    void getData(uint start, uint readSize, void* outData);
+
     uint getID() { return this->bufferID; }
     bool hasData() { return this->filled; }
     uint size() const { return this->dataSize; }
@@ -211,4 +220,66 @@ namespace Strontium
     // The size of the data currently in the buffer.
     uint dataSize;
   };
+
+  //----------------------------------------------------------------------------
+  // Persistently mapped ring buffer here.
+  //----------------------------------------------------------------------------
+  // A buffer which stays mapped for its whole lifetime, split into one region
+  // per frame in flight. Per-frame and per-draw data is written linearly into
+  // the current region and bound by range as uniform or shader storage data.
+  // Each region is fenced so it is only overwritten once the GPU is done
+  // reading it. Must only be used from the thread which owns the context.
+  class RingBuffer
+  {
+  public:
+    RingBuffer(uint frameSize);
+    ~RingBuffer();
+
+    // Delete the copy constructor and the assignment operator. Prevents
+    // issues related to the underlying API.
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    // Fence the region of the previous frame and move to the next region,
+    // waiting on the GPU if it is still reading it. Call once per frame,
+    // before any allocations.
+    void beginFrame();
+
+    // Copy data into the current region and return the offset of the copy.
+    // Offsets are aligned for both uniform and storage bindings. The buffer
+    // is replaced with a larger one if the region is full, so bind ranges
+    // right after allocating them. A null data pointer reserves space for
+    // the GPU to write into.
+    uint allocate(uint dataSize, const void* data);
+
+    // Bind a range of the buffer to an indexed binding point.
+    void bindUniformRange(const uint bindPoint, uint offset, uint rangeSize);
+    void bindStorageRange(const uint bindPoint, uint offset, uint rangeSize);
+
+    // Bind the whole buffer as the source of indirect draw commands.
+    void bindDrawIndirect();
+
+    uint getID() { return this->bufferID; }
+    uint getFrameSize() const { return this->frameSize; }
+  protected:
+    void createStorage(uint newFrameSize);
+
+    // OpenGL buffer ID and the persistent mapping.
+    uint bufferID;
+    char* mappedData;
+
+    uint frameSize;
+    uint alignment;
+
+    // The region being written and the write position in the buffer.
+    uint currentFrame;
+    uint head;
+    bool frameStarted;
+
+    // Fence sync objects (GLsync) for each region.
+    void* fences[NUM_RING_BUFFER_FRAMES];
+
+    // Buffers replaced by a resize, deleted once the GPU is done with them.
+    std::vector<std::pair<uint, void*>> retiredBuffers;
+  };
 }
@@ -0,0 +1,41 @@
+// Include guard.
+#pragma once
+
+// Macro include file.
+#include "StrontiumPCH.h"
+
+// Project includes.
+#include "Core/ApplicationBase.h"
+#include "Graphics/Buffers.h"
+
+namespace Strontium
+{
+  // Measures the GPU time of a section of a frame with timer queries. Each
+  // frame gets its own query so reading a result doesn't wait on the GPU. The
+  // query of a frame is read back when it's reused, NUM_RING_BUFFER_FRAMES
+  // frames later.
+  class GPUTimer
+  {
+  public:
+    GPUTimer();
+    ~GPUTimer();
+
+    // Delete the copy constructor and the assignment operator. Prevents
+    // issues related to the underlying API.
+    GPUTimer(const GPUTimer&) = delete;
+    GPUTimer& operator=(const GPUTimer&) = delete;
+
+    // Only one timer can be running at a time.
+    void begin();
+    void end();
+
+    // The latest available result in milliseconds.
+    float getElapsed() const { return this->elapsed; }
+  protected:
+    uint queries[NUM_RING_BUFFER_FRAMES];
+    bool issued[NUM_RING_BUFFER_FRAMES];
+    uint currentQuery;
+
+    float elapsed;
+  };
+}
@@ -0,0 +1,176 @@
+// Include guard.
+#pragma once
+
+// Macro include file.
+#include "StrontiumPCH.h"
+
+// Project includes.
+#include "Core/ApplicationBase.h"
+#include "Graphics/Shaders.h"
+#include "Graphics/RendererCommands.h"
+
+// STL includes.
+#include <mutex>
+
+namespace Strontium
+{
+  class GeometryArena;
+
+  // A vertex attribute of the arena's vertex format.
+  struct VertexAttribute
+  {
+    uint location;
+    AttribType type;
+    bool normalized;
+    uint offset;
+  };
+
+  // First fit allocator over a range of elements. Adjacent free ranges are
+  // merged when released.
+  class RangeAllocator
+  {
+  public:
+    RangeAllocator(uint capacity);
+
+    // Returns false if there isn't a free range large enough.
+    bool allocate(uint count, uint &outOffset);
+    void release(uint offset, uint count);
+
+    // Add the space between the old and the new capacity to the free ranges.
+    void grow(uint newCapacity);
+
+    uint getCapacity() const { return this->capacity; }
+  protected:
+    // Free ranges, offset -> count.
+    std::map<uint, uint> freeRanges;
+    uint capacity;
+  };
+
+  // The range of the arena buffers used by a mesh. The range is returned to
+  // the arena when the allocation is destroyed. Indices are in the 16 or 32
+  // bit index buffer depending on the index type. Skinned meshes also have a
+  // range of the skin stream.
+  class GeometryAllocation
+  {
+  public:
+    GeometryAllocation();
+    GeometryAllocation(std::weak_ptr<GeometryArena> arena, uint baseVertex,
+                       uint numVertices, uint firstIndex, uint numIndices,
+                       IndexType indexType, uint firstSkinVertex, uint numSkinVertices);
+    ~GeometryAllocation();
+
+    GeometryAllocation(GeometryAllocation &&other);
+    GeometryAllocation& operator=(GeometryAllocation &&other);
+    GeometryAllocation(const GeometryAllocation&) = delete;
+    GeometryAllocation& operator=(const GeometryAllocation&) = delete;
+
+    void release();
+
+    bool isValid() const { return this->valid; }
+    uint getBaseVertex() const { return this->baseVertex; }
+    uint getNumVertices() const { return this->numVertices; }
+    uint getFirstIndex() const { return this->firstIndex; }
+    uint getNumIndices() const { return this->numIndices; }
+    IndexType getIndexType() const { return this->indexType; }
+    uint getFirstSkinVertex() const { return this->firstSkinVertex; }
+    bool hasSkin() const { return this->numSkinVertices > 0; }
+  protected:
+    std::weak_ptr<GeometryArena> arena;
+    uint baseVertex;
+    uint numVertices;
+    uint firstIndex;
+    uint numIndices;
+    IndexType indexType;
+    uint firstSkinVertex;
+    uint numSkinVertices;
+    bool valid;
+
+    friend class GeometryArena;
+  };
+
+  // Large shared vertex and index buffers for a single vertex format, with a
+  // single VAO. Meshes are sub-allocated from the buffers so draws of
+  // different meshes don't need to rebind anything, and can be merged into
+  // multi-draw indirect calls. The VAO also has a per-instance ID stream at
+  // instanceIDLocation, so instanced draws can find their data through the
+  // base instance of the draw.
+  //
+  // Meshes with few enough vertices get 16 bit indices. Those live in their
+  // own index buffer, a multi-draw can only use one index type so draws need
+  // to be grouped by type. The skin stream of skinned meshes is a separate
+  // buffer which isn't part of the VAO, skinning shaders read it as storage.
+  class GeometryArena : public std::enable_shared_from_this<GeometryArena>
+  {
+  public:
+    GeometryArena(uint vertexSize, uint skinVertexSize,
+                  const std::vector<VertexAttribute> &attributes,
+                  uint instanceIDLocation, uint vertexCapacity, uint indexCapacity);
+    ~GeometryArena();
+
+    // Delete the copy constructor and the assignment operator. Prevents
+    // issues related to the underlying API.
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // Copy vertex and index data into the arena, growing the buffers if
+    // needed. Indices are relative to the first vertex of the allocation.
+    // Skinned meshes pass numVertices entries of skin data.
+    GeometryAllocation allocate(const void* vertexData, uint numVertices,
+                                const uint* indexData, uint numIndices,
+                                const void* skinData = nullptr);
+
+    // Reserve a range of vertices without any data or indices, for vertices
+    // written on the GPU.
+    GeometryAllocation allocateVertices(uint numVertices);
+
+    // Make sure the instance ID stream covers numInstances instances.
+    void reserveInstanceIDs(uint numInstances);
+
+    void bind();
+    void unbind();
+
+    // Switch the index buffer of the VAO. Expects the arena to be bound.
+    void bindIndexBuffer(IndexType indexType);
+
+    // Bind the vertex buffer or the skin stream as a shader storage buffer.
+    // The buffers are replaced when the arena grows, so bind them after
+    // allocating.
+    void bindVertexStorage(uint bindPoint);
+    void bindSkinStorage(uint bindPoint);
+
+    uint getVertexCapacity() const { return this->vertices.getCapacity(); }
+    uint getIndexCapacity() const { return this->indices.getCapacity(); }
+
+    // 16 bit indices can address the whole mesh.
+    static IndexType getIndexType(uint numVertices);
+  protected:
+    void release(const GeometryAllocation &allocation);
+    void growBuffer(uint &bufferID, uint oldSize, uint newSize);
+    void growVertexBuffer(uint newCapacity);
+    void growIndexBuffer(IndexType indexType, uint newCapacity);
+    void growSkinBuffer(uint newCapacity);
+    void setupAttributes();
+
+    uint arrayID;
+    uint vertexBufferID;
+    uint indexBufferID;
+    uint shortIndexBufferID;
+    uint skinBufferID;
+    uint instanceBufferID;
+
+    uint vertexSize;
+    uint skinVertexSize;
+    std::vector<VertexAttribute> attributes;
+    uint instanceIDLocation;
+    uint instanceCapacity;
+    IndexType boundIndexType;
+
+    RangeAllocator vertices;
+    RangeAllocator indices;
+    RangeAllocator shortIndices;
+    RangeAllocator skinVertices;
+    std::mutex allocatorMutex;
+
+    friend class GeometryAllocation;
+  };
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+// Entries of the simulated post-transform vertex cache.
+#define MESH_OPTIMIZER_CACHE_SIZE 16
+// A cluster is split once its own ACMR drops below this fraction of the
+// mesh's ACMR, trading a little vertex cache efficiency for more clusters to
+// sort for overdraw.
+#define MESH_OPTIMIZER_OVERDRAW_THRESHOLD 1.05f
+// LODs stop once a LOD would have fewer triangles than this, or simplifying
+// can't get a LOD below this fraction of the previous LOD's triangles.
+#define MESH_LOD_MIN_TRIANGLES 64
+#define MESH_LOD_MIN_REDUCTION 0.8f
+// Meshes with fewer triangles than this aren't split into meshlets, culling
+// them costs more than drawing them whole.
+#define MESHLET_MIN_MESH_TRIANGLES 512
+
+// Macro include file.
+#include "StrontiumPCH.h"
+
+// Project includes.
+#include "Core/ApplicationBase.h"
+
+namespace Strontium
+{
+  class Mesh;
+  struct Vertex;
+  struct VertexSkin;
+
+  // Vertex cache efficiency of an index buffer, from a simulated FIFO cache.
+  struct VertexCacheStats
+  {
+    uint numTransformed;
+    uint numTriangles;
+    uint numVertices;
+
+    VertexCacheStats()
+      : numTransformed(0)
+      , numTriangles(0)
+      , numVertices(0)
+    { }
+
+    // Average cache miss ratio, transformed vertices per triangle.
+    float getACMR() const { return this->numTriangles > 0 ? static_cast<float>(this->numTransformed) / this->numTriangles : 0.0f; }
+    // Average transform to vertex ratio, 1.0 is optimal.
+    float getATVR() const { return this->numVertices > 0 ? static_cast<float>(this->numTransformed) / this->numVertices : 0.0f; }
+
+    VertexCacheStats& operator+=(const VertexCacheStats &other)
+    {
+      this->numTransformed += other.numTransformed;
+      this->numTriangles += other.numTriangles;
+      this->numVertices += other.numVertices;
+      return *this;
+    }
+  };
+
+  // Import time reordering of mesh data, so the GPU transforms and shades
+  // less. Everything works on triangle lists.
+  namespace MeshOptimizer
+  {
+    VertexCacheStats analyzeVertexCache(const std::vector<uint> &indices, uint numVertices,
+                                        uint cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+    // Reorder the triangles for the post-transform vertex cache with
+    // Tipsify (Sander et al. 2007). The first triangle of each cluster, split
+    // where the cache had to be flushed, is written to outClusters.
+    void optimizeVertexCache(std::vector<uint> &indices, uint numVertices,
+                             std::vector<uint> &outClusters,
+                             uint cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+    // Reorder the clusters of a vertex cache optimized mesh so that the ones
+    // facing out from the center of the mesh are drawn first, and occlude
+    // the rest more often.
+    void optimizeOverdraw(std::vector<uint> &indices, const std::vector<Vertex> &vertices,
+                          const std::vector<uint> &clusters,
+                          float threshold = MESH_OPTIMIZER_OVERDRAW_THRESHOLD,
+                          uint cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+    // Reorder the vertices in the order the indices first reference them.
+    // The skin stream is reordered along with the vertices if there is one.
+    void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<VertexSkin> &skinData,
+                             std::vector<uint> &indices);
+
+    // Run the three passes above on a mesh.
+    void optimizeMesh(Mesh &mesh, VertexCacheStats &outBefore, VertexCacheStats &outAfter);
+
+    // Simplify a triangle list with quadric error metric edge collapses
+    // (Garland and Heckbert 1997) until it has at most targetIndexCount
+    // indices, or the next collapse would exceed maxError. Vertices collapse
+    // onto a neighbour, so the result indexes the same vertices. Vertices on
+    // open borders and attribute seams are locked. Returns the error of the
+    // result, the RMS distance to the planes of the collapsed triangles in
+    // model units.
+    float simplify(std::vector<uint> &indices, const std::vector<Vertex> &vertices,
+                   uint targetIndexCount, float maxError);
+
+    // Build the LOD chain of an optimized mesh, each LOD with about half the
+    // triangles of the previous one. The LODs are appended to the mesh's
+    // indices.
+    void buildLODs(Mesh &mesh);
+
+    // Split the full detail mesh into meshlets of at most
+    // MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles. The
+    // meshlets are cut from the vertex cache order, which is already
+    // spatially coherent, so each meshlet stays a contiguous index range.
+    // Normal cones are only kept for closed meshes, nothing else hides the
+    // back faces of an open mesh.
+    void buildMeshlets(Mesh &mesh);
+  }
+}
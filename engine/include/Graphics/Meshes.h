@@ -1,5 +1,11 @@
 #pragma once
 
+// Maximum levels of detail of a mesh, including the full detail mesh.
+#define MAX_MESH_LODS 5
+// Limits of a meshlet.
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
 // Macro include file.
 #include "StrontiumPCH.h"
 
@@ -7,31 +13,91 @@
 #include "Core/ApplicationBase.h"
 #include "Graphics/VertexArray.h"
 #include "Graphics/Shaders.h"
+#include "Graphics/GeometryArena.h"
+
+// GLM includes.
+#include "glm/gtc/type_precision.hpp"
 
 namespace Strontium
 {
   class Model;
 
-  // Vertex datatypes to store vertex attributes.
+  // Vertex datatypes to store vertex attributes. 24 bytes a vertex. The
+  // normal (x, y) and tangent (z, w) are octahedral encoded as 16 bit snorms.
+  // The lowest bit of w holds the sign of the bitangent, which is rebuilt as
+  // cross(normal, tangent). UVs are a pair of half floats.
   struct Vertex
   {
-    glm::vec4 position;
-    glm::vec3 normal;
-    glm::vec2 uv;
-    glm::vec3 tangent;
-    glm::vec3 bitangent;
-    glm::ivec4 boneIDs;
-    glm::vec4 boneWeights;
+    glm::vec3 position;
+    glm::i16vec4 frame;
+    glm::uint uv;
 
     Vertex()
-      : position(0.0f, 0.0f, 0.0f, 1.0f)
-      , normal(0.0f)
-      , uv(0.0f)
-      , tangent(0.0f)
-      , bitangent(0.0f)
-      , boneIDs(-1)
-      , boneWeights(0.0f)
+      : position(0.0f)
+      , frame(0)
+      , uv(0)
+    { }
+
+    void setFrame(const glm::vec3 &normal, const glm::vec3 &tangent,
+                  const glm::vec3 &bitangent);
+    void setUV(const glm::vec2 &texCoords);
+
+    glm::vec3 getNormal() const;
+    glm::vec3 getTangent() const;
+    float getBitangentSign() const { return (this->frame.w & 1) ? -1.0f : 1.0f; }
+    glm::vec2 getUV() const;
+  };
+
+  // The bone influences of a skinned vertex, 12 bytes a vertex. Only skinned
+  // meshes have this stream. Unused influences have a weight of zero. Bone
+  // IDs index the model's bones, which can exceed 256, so they're 16 bits.
+  // Weights are unorm8 and sum to 255.
+  struct VertexSkin
+  {
+    glm::u16vec4 boneIDs;
+    glm::u8vec4 boneWeights;
+
+    VertexSkin()
+      : boneIDs(0)
+      , boneWeights(0)
     { }
+
+    // Quantize up to MAX_BONES_PER_VERTEX influences, negative IDs are
+    // unused.
+    void setInfluences(const glm::ivec4 &ids, const glm::vec4 &weights);
+  };
+
+  // Bind pose bounds of the vertices influenced by a bone. Vertices without
+  // any weights are bounded by an entry with an unskinnedBone index.
+  struct BoneBounds
+  {
+    static constexpr uint unskinnedBone = std::numeric_limits<uint>::max();
+
+    uint bone;
+    glm::vec3 min;
+    glm::vec3 max;
+  };
+
+  // A level of detail of a mesh, a range of the mesh's indices. Every LOD
+  // indexes the vertices of the full detail mesh. The error is the geometric
+  // deviation from the full detail mesh, in model units.
+  struct MeshLOD
+  {
+    uint firstIndex;
+    uint numIndices;
+    float error;
+  };
+
+  // A cluster of up to MESHLET_MAX_TRIANGLES triangles of the full detail
+  // mesh, a range of its indices. The bounds are in model space: a bounding
+  // sphere (center, radius) and a normal cone (axis, cutoff). The cone
+  // cutoff is the sine of the cone's half angle, a cutoff of 1 never culls.
+  struct Meshlet
+  {
+    glm::vec4 sphere;
+    glm::vec4 cone;
+    uint firstIndex;
+    uint numIndices;
   };
 
   // Material info from assimp.
@@ -69,30 +135,65 @@ namespace Strontium
     void generateVAO();
     void deleteVAO();
 
+    // Copy the mesh data into a geometry arena, for drawing with the arena's
+    // shared buffers.
+    void uploadToArena(GeometryArena &arena);
+
+    // Bound the vertices of each bone from the bone weights, so the skinned
+    // bounds can be rebuilt from the bone matrices of the current pose.
+    void computeBoneBounds();
+
+    // The attribute layout of Vertex. The skin stream isn't an attribute, the
+    // skinning shaders read it from storage.
+    static std::vector<VertexAttribute> getVertexAttributes();
+
+    // The indices of every LOD, the full detail mesh is always LOD 0. Meshes
+    // without a LOD chain only have LOD 0.
+    uint getNumLODs() { return std::max<uint>(this->lods.size(), 1); }
+    MeshLOD getLOD(uint lod);
+
+    // Meshlets of the full detail mesh, in index order. Consecutive meshlets
+    // cover consecutive index ranges. Small and skinned meshes don't have any.
+    bool hasMeshlets() { return !this->meshlets.empty(); }
+
+    // 16 bit indices are used in the geometry arena if the mesh allows it.
+    IndexType getIndexType() const { return GeometryArena::getIndexType(this->data.size()); }
+
     // Set the loaded state.
     void setLoaded(bool isLoaded) { this->loaded = isLoaded; }
 
     // Getters.
     std::vector<Vertex>& getData() { return this->data; }
+    std::vector<VertexSkin>& getSkinData() { return this->skinData; }
     std::vector<uint>& getIndices() { return this->indices; }
+    std::vector<MeshLOD>& getLODs() { return this->lods; }
+    std::vector<Meshlet>& getMeshlets() { return this->meshlets; }
     glm::vec3& getMinPos() { return this->minPos; }
     glm::vec3& getMaxPos() { return this->maxPos; }
+    std::vector<BoneBounds>& getBoneBounds() { return this->boneBounds; }
     VertexArray*  getVAO() { return this->vArray.get(); }
+    GeometryAllocation& getArenaAllocation() { return this->arenaAllocation; }
     std::string& getFilepath() { return this->filepath; }
     std::string& getName() { return this->name; }
     UnloadedMaterialInfo& getMaterialInfo() { return this->materialInfo; }
 
     // Check for states.
     bool hasVAO() { return this->vArray != nullptr; }
+    bool isInArena() { return this->arenaAllocation.isValid(); }
+    bool isSkinned() { return !this->skinData.empty(); }
     bool isLoaded() { return this->loaded; }
   protected:
     // Mesh properties.
     bool loaded;
     std::vector<Vertex> data;
+    std::vector<VertexSkin> skinData;
     std::vector<uint> indices;
+    std::vector<MeshLOD> lods;
+    std::vector<Meshlet> meshlets;
 
     glm::vec3 minPos;
     glm::vec3 maxPos;
+    std::vector<BoneBounds> boneBounds;
 
     std::string filepath;
     std::string name;
@@ -103,5 +204,8 @@ namespace Strontium
 
     // Vertex array object for the mesh data.
     Unique<VertexArray> vArray;
+
+    // Range of the geometry arena holding the mesh data.
+    GeometryAllocation arenaAllocation;
   };
 }
@@ -0,0 +1,57 @@
+#pragma once
+
+// Most frustums a set of meshlets is tested against at once, one per shadow
+// cascade.
+#define MESHLET_CULL_MAX_FRUSTUMS 4
+
+// Macro include file.
+#include "StrontiumPCH.h"
+
+// Project includes.
+#include "Core/ApplicationBase.h"
+#include "Core/Math.h"
+#include "Graphics/Meshes.h"
+
+namespace Strontium
+{
+  // A view moved into the model space of a mesh, so the meshlets can be
+  // tested without transforming their bounds. Planes stay planes under an
+  // affine transform and points stay on the same side of them, so the tests
+  // give the same results as they would in world space.
+  struct MeshletCullView
+  {
+    // Normalized frustum planes, the normal in xyz and the distance in w. A
+    // meshlet is visible if it's inside any of the frustums. Nothing is
+    // frustum culled without frustums.
+    glm::vec4 planes[MESHLET_CULL_MAX_FRUSTUMS * 6];
+    uint numFrustums;
+
+    // A meshlet is back facing if dot(d, axis) > cutoff * length(d) + radius * w,
+    // with d = center * w - viewpoint.xyz. That's the perspective test for a
+    // camera position (w = 1) and the orthographic test for the negated view
+    // direction (w = 0).
+    glm::vec4 viewpoint;
+    bool coneCulling;
+  };
+
+  // A run of consecutive visible meshlets, a range of the mesh's indices.
+  struct MeshletRun
+  {
+    uint firstIndex;
+    uint numIndices;
+  };
+
+  // Build the view of a mesh drawn with transform. The viewpoint is the
+  // worldspace camera position (w = 1) or view direction (w = 0).
+  MeshletCullView buildMeshletCullView(const glm::mat4 &transform, const Frustum* frustums,
+                                       uint numFrustums, const glm::vec4 &viewpoint,
+                                       bool coneCulling);
+
+  // Test the meshlets of a mesh against a view, four at a time with SSE when
+  // available. The visible meshlets are written to outRuns, merged into
+  // runs. The meshlets rejected by each test are added to the counters, the
+  // frustum test goes first.
+  void cullMeshlets(const std::vector<Meshlet> &meshlets, const MeshletCullView &view,
+                    std::vector<MeshletRun> &outRuns, uint &outFrustumCulled,
+                    uint &outConeCulled);
+}
@@ -40,17 +40,23 @@ namespace Strontium
     std::vector<VertexBone>& getBones() { return this->storedBones; }
     glm::mat4& getGlobalInverseTransform() { return this->globalInverseTransform; }
     SceneNode& getRootNode() { return this->rootNode; }
+    Skeleton& getSkeleton() { return this->skeleton; }
     std::string& getFilepath() { return this->filepath; }
   private:
-    void processNode(aiNode* node, const aiScene* scene, const std::string &directory);
-    void processMesh(aiMesh* mesh, const aiScene* scene, const std::string &directory);
+    void processNode(aiNode* node, const aiScene* scene, std::vector<aiMesh*> &outMeshes);
+    void processMeshes(const std::vector<aiMesh*> &meshes, const aiScene* scene,
+                       const std::string &directory);
+    void processMesh(aiMesh* mesh, const aiScene* scene, const std::string &directory,
+                     Mesh &outMesh);
 
-    void addBoneData(unsigned int boneIndex, float boneWeight, Vertex &toMod);
+    void addBoneData(unsigned int boneIndex, float boneWeight, glm::ivec4 &boneIDs,
+                     glm::vec4 &boneWeights);
 
     // Scene information for this model.
     glm::mat4 globalInverseTransform;
     SceneNode rootNode;
     std::unordered_map<std::string, SceneNode> sceneNodes;
+    Skeleton skeleton;
 
     // Submeshes of this model.
     std::vector<Mesh> subMeshes;
@@ -0,0 +1,38 @@
+#pragma once
+
+// Version of the cooked model layout. Bump whenever the cooked structs, the
+// vertex layout, the keyframe encoding or the import time processing of
+// meshes change, older cooked models are then imported again.
+#define MODEL_CACHE_VERSION 7
+// Extension appended to the path of a source model for its cooked model.
+#define MODEL_CACHE_EXTENSION ".srmesh"
+
+// Macro include file.
+#include "StrontiumPCH.h"
+
+// Project includes.
+#include "Core/ApplicationBase.h"
+
+namespace Strontium
+{
+  class Model;
+
+  // Reads and writes cooked models. A cooked model is a flat file holding
+  // everything Model::load extracts from Assimp: vertices, indices, LODs,
+  // meshlets, submesh ranges, bounds, bones, the node hierarchy and the
+  // compiled animations. Sections are aligned so they can be read straight out
+  // of a memory mapping. The size, timestamp and hash of the source file are
+  // stored so the cooked model is ignored once the source changes.
+  class ModelCache
+  {
+  public:
+    // Load the cooked model of the source file at filepath. Returns false if
+    // there is no cooked model, or it's out of date or invalid.
+    static bool load(Model &model, const std::string &filepath);
+
+    // Cook a model freshly imported from the source file at filepath.
+    static bool save(Model &model, const std::string &filepath);
+
+    static std::string getCachePath(const std::string &filepath);
+  };
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Largest side of the hierarchical depth level read back for occlusion
+// culling. The GPU reduces the depth buffer down to the first level which
+// fits, the coarser levels are built on the CPU.
+#define HIZ_READBACK_MAX_SIZE 256
+// Boxes this much nearer than the farthest depth they cover are still
+// visible, so surfaces lying on their own bounds aren't culled by the depth
+// they wrote themselves.
+#define HIZ_DEPTH_BIAS 1e-5f
+
+// Macro include file.
+#include "StrontiumPCH.h"
+
+// Project includes.
+#include "Core/ApplicationBase.h"
+#include "Core/Math.h"
+
+namespace Strontium
+{
+  // A max depth pyramid of an earlier frame. Level 0 is the level read back
+  // from the GPU and each following level halves the previous one down to a
+  // single texel. Texels hold the farthest window space depth of the pixels
+  // they cover, rows go from the bottom of the screen up.
+  struct DepthPyramid
+  {
+    std::vector<std::vector<float>> levels;
+    std::vector<glm::uvec2> sizes;
+
+    // The view the depth was rendered from.
+    glm::mat4 viewProjection;
+    glm::vec3 viewpoint;
+
+    bool valid;
+
+    DepthPyramid()
+      : viewProjection(1.0f)
+      , viewpoint(0.0f)
+      , valid(false)
+    { }
+  };
+
+  // Build the pyramid from the depths of its first level.
+  void buildDepthPyramid(const float* depths, uint width, uint height,
+                         const glm::mat4 &viewProjection, const glm::vec3 &viewpoint,
+                         DepthPyramid &outPyramid);
+
+  // Clear the depth under the boxes to the far plane, at every level. For
+  // boxes which changed since the depth was rendered, nothing behind where
+  // they are or were is culled. A box reaching behind the old near plane
+  // could be anywhere on the old screen, the pyramid is dropped instead.
+  void clearDepthPyramid(DepthPyramid &pyramid, const std::vector<BoundingBox> &boxes);
+
+  // Test the boxes set in testMask against the pyramid, seen from viewpoint.
+  // Occluded boxes are cleared in outMask, every other bit is set. Boxes
+  // reaching behind the old near plane or off the old screen are kept, since
+  // nothing is known about what they'd be behind. The number of tested and
+  // culled boxes are added to the counters.
+  void occlusionCullBoxes(const BoundingBoxArray &boxes, const DepthPyramid &pyramid,
+                          const glm::vec3 &viewpoint, const VisibilityMask &testMask,
+                          VisibilityMask &outMask, uint &outTested, uint &outCulled,
+                          bool multithreaded = true);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+// Macro include file.
+#include "StrontiumPCH.h"
+
+// Project includes.
+#include "Core/ApplicationBase.h"
+#include "Graphics/Meshes.h"
+#include "Graphics/Model.h"
+#include "Graphics/Animations.h"
+#include "Graphics/Material.h"
+
+// STL includes.
+#include <cstdint>
+
+namespace Strontium
+{
+  // A model submitted to the renderer for the current frame. Static models
+  // don't have an animator.
+  struct Renderable
+  {
+    Model* model;
+    Animator* animator;
+    ModelMaterial* materials;
+    glm::mat4 transform;
+    float id;
+    bool drawSelectionMask;
+
+    // If the model is submitted more than once this frame. Set when the
+    // bounds are computed.
+    bool repeated;
+
+    // If the transform changed since the last frame, and the one it had then.
+    bool moved;
+    glm::mat4 previousTransform;
+
+    Renderable(Model* model, Animator* animator, ModelMaterial* materials,
+               const glm::mat4 &transform, float id, bool drawSelectionMask,
+               const glm::mat4* previousTransform)
+      : model(model)
+      , animator(animator)
+      , materials(materials)
+      , transform(transform)
+      , id(id)
+      , drawSelectionMask(drawSelectionMask)
+      , repeated(false)
+      , moved(previousTransform != nullptr)
+      , previousTransform(previousTransform ? *previousTransform : transform)
+    { }
+  };
+
+  // Shader slots of the sort key.
+  enum class DrawShader
+  {
+    Static = 0,
+    Dynamic = 1
+  };
+
+  // A single submesh draw. Draw items are sorted by their key so that draws
+  // sharing a pass, shader, material, mesh and LOD end up next to each other.
+  // The key is packed as follows (from the most significant bit):
+  // pass (4 bits) | shader (8 bits) | material (16 bits) | index type (1 bit) |
+  // mesh (16 bits) | LOD (3 bits) | depth (16 bits)
+  // The index type keeps meshes with 16 bit indices ahead of those with 32
+  // bit indices within a material, a multi-draw can't mix them.
+  struct DrawItem
+  {
+    uint64_t sortKey;
+    Mesh* mesh;
+    Material* material;
+    uint renderable;
+
+    // The LOD of the mesh to draw, and the range of the mesh's indices
+    // drawn. That's the whole LOD, or a run of visible meshlets of LOD 0.
+    uint lod;
+    uint firstIndex;
+    uint numIndices;
+
+    // First vertex of the compute skinned copy of the mesh, relative to the
+    // skinned range of the geometry arena. -1 if the mesh isn't skinned.
+    int skinnedVertex;
+  };
+
+  // Per-instance data of instanced draws, matches InstanceBlock in the
+  // instanced shaders.
+  struct InstanceData
+  {
+    glm::mat4 transform;
+    glm::vec4 maskColourID;
+  };
+
+  // A run of sorted draw items issued as a single draw. Consecutive static
+  // items with the same pass, mesh, index range and material are instanced,
+  // their instance data starts at firstInstance. Compute skinned items are static
+  // but only instanced with themselves. Dynamic items are never instanced.
+  struct DrawBatch
+  {
+    uint firstItem;
+    uint numItems;
+    uint firstInstance;
+    bool instanced;
+  };
+
+  // Build a sort key. The material and mesh IDs are folded down to fit, so
+  // two different materials or meshes can share an ID. That only affects the
+  // ordering, state changes are tracked with the actual objects.
+  uint64_t buildSortKey(uint pass, DrawShader shader, const Material* material,
+                        const Mesh* mesh, uint lod, uint depthBucket);
+
+  // Quantize a view depth in [near, far] to 16 bits, front to back.
+  uint computeDepthBucket(float depth, float near, float far);
+
+  inline uint
+  getSortKeyPass(uint64_t sortKey)
+  {
+    return static_cast<uint>(sortKey >> 60);
+  }
+
+  inline DrawShader
+  getSortKeyShader(uint64_t sortKey)
+  {
+    return static_cast<DrawShader>((sortKey >> 52) & 0xFF);
+  }
+
+  // LSD radix sort of the draw items by key, 8 bits a pass. Passes where every
+  // key has the same digit are skipped. The scratch vector is reused between
+  // frames to avoid reallocating.
+  void sortDrawItems(std::vector<DrawItem> &items, std::vector<DrawItem> &scratch);
+
+  // Group sorted draw items into batches and gather the instance data of the
+  // instanced batches.
+  void buildDrawBatches(const std::vector<DrawItem> &items,
+                        const std::vector<Renderable> &renderables,
+                        std::vector<DrawBatch> &batches,
+                        std::vector<InstanceData> &instances);
+}
@@ -4,27 +4,38 @@
 #define NUM_CASCADES 4
 #define MAX_NUM_BLOOM_MIPS 7
 
+// Light clusters, the screen is split into CLUSTER_GRID_X by CLUSTER_GRID_Y
+// tiles and CLUSTER_GRID_Z depth slices.
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define NUM_CLUSTERS (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+#define MAX_LIGHTS_PER_CLUSTER 128
+
 // Macro include file.
 #include "StrontiumPCH.h"
 
 // Project includes.
 #include "Core/ApplicationBase.h"
 #include "Core/Math.h"
+#include "Core/TaskGraph.h"
 #include "Graphics/RendererCommands.h"
 #include "Graphics/VertexArray.h"
 #include "Graphics/Shaders.h"
 #include "Graphics/FrameBuffer.h"
 #include "Graphics/GeometryBuffer.h"
+#include "Graphics/GPUTimer.h"
 
 #include "Graphics/EnvironmentMap.h"
 #include "Graphics/Meshes.h"
+#include "Graphics/GeometryArena.h"
 #include "Graphics/Model.h"
 #include "Graphics/Animations.h"
 #include "Graphics/Material.h"
 #include "Graphics/ShadingPrimatives.h"
-
-// STL includes.
-#include <tuple>
+#include "Graphics/RenderQueue.h"
+#include "Graphics/MeshletCulling.h"
+#include "Graphics/OcclusionCulling.h"
 
 namespace Strontium
 {
@@ -40,6 +51,24 @@ namespace Strontium
   // The 3D renderer!
   namespace Renderer3D
   {
+    // A hierarchical depth level copied for the CPU and the view it was
+    // rendered from. Invalid if nothing was written to it.
+    struct HiZReadback
+    {
+      Unique<ShaderStorageBuffer> buffer;
+      glm::mat4 viewProjection;
+      glm::vec3 viewpoint;
+      glm::uvec2 size;
+      bool valid;
+
+      HiZReadback()
+        : viewProjection(1.0f)
+        , viewpoint(0.0f)
+        , size(0)
+        , valid(false)
+      { }
+    };
+
     // The renderer storage.
     struct RendererStorage
     {
@@ -60,18 +89,47 @@ namespace Strontium
       FrameBuffer lightingPass;
 
       // Uniform buffers.
-      UniformBuffer camBuffer;
-      UniformBuffer transformBuffer;
-      UniformBuffer editorBuffer;
       UniformBuffer ambientPassBuffer;
       UniformBuffer directionalPassBuffer;
-      UniformBuffer pointPassBuffer; // TEMP until tiled deferred is implemented.
-      UniformBuffer cascadeShadowBuffer;
-      UniformBuffer cascadeShadowPassBuffer;
-      UniformBuffer postProcessSettings;
 
-      // SSBO for bones.
-      ShaderStorageBuffer boneBuffer;
+      // Clustered point and spot lights. The AABBs are only rebuilt when the
+      // projection changes. Light culling statistics are read back once the
+      // GPU is done with them, one buffer per frame in flight.
+      ShaderStorageBuffer clusterAABBs;
+      ShaderStorageBuffer lightGrid;
+      ShaderStorageBuffer lightIndices;
+      Unique<ShaderStorageBuffer> clusterStats[NUM_RING_BUFFER_FRAMES];
+      uint currentClusterStats;
+      GPUTimer clusteredLightTimer;
+      glm::mat4 clusterProjection;
+      glm::vec2 clusterScreenSize;
+
+      // Persistently mapped ring for per-frame constants (camera, cascades,
+      // post processing) and per-draw data (transforms, IDs, bones, instances).
+      RingBuffer frameData;
+
+      // Shared vertex and index buffers of all the meshes drawn by the
+      // renderer, and the indirect commands of the instanced draws.
+      Shared<GeometryArena> geometryArena;
+      std::vector<DrawElementsIndirectCommand> indirectCommands;
+
+      // Final bone matrices of all the animated renderables, packed once per
+      // frame as the rows of 3x4 affine matrices. The bones of renderable i
+      // start at boneOffsets[i], in bones.
+      std::vector<glm::vec4> bonePalette;
+      std::vector<uint> boneOffsets;
+
+      // Compute skinned vertices of the animated submeshes, drawn as static
+      // geometry. The skinned copy of submesh box i starts at
+      // skinnedVertexOffsets[i] within the range, -1 if it isn't skinned.
+      GeometryAllocation skinnedVertices;
+      std::vector<int> skinnedVertexOffsets;
+      uint numSkinnedVertices;
+
+      // Inputs of the GPU instance culling pass. The batch of each instance
+      // and the local bounds (min, max) of the mesh of each batch.
+      std::vector<uint> instanceBatches;
+      std::vector<glm::vec4> batchBounds;
 
       // Required objects for bloom.
       Texture2D downscaleBloomTex[MAX_NUM_BLOOM_MIPS];
@@ -84,17 +142,74 @@ namespace Strontium
       Texture2D halfResBuffer1;
       ShaderStorageBuffer lightShaftSettingsBuffer;
 
-      // Items for the geometry pass.
-      std::vector<std::tuple<Model*, ModelMaterial*, glm::mat4, uint, bool>> staticRenderQueue;
-      std::vector<std::tuple<Model*, Animator*, ModelMaterial*, glm::mat4, uint, bool>> dynamicRenderQueue;
+      // Hierarchical depth for occlusion culling. The depth of the geometry
+      // pass is reduced on the GPU down to the level that gets read back,
+      // once per frame in flight so the copy is only read when the GPU is
+      // done with it. The rest of the pyramid is built on the CPU.
+      Texture2D hiZBuffer;
+      HiZReadback hiZReadbacks[NUM_RING_BUFFER_FRAMES];
+      uint currentHiZReadback;
+      std::vector<float> hiZReadbackData;
+      DepthPyramid depthPyramid;
+
+      // Worldspace boxes of the submeshes which moved in each frame, where
+      // they were and where they are. Indexed like the readbacks, so the
+      // boxes of every frame since the read back depth was rendered are
+      // kept. The depth under them is cleared before culling.
+      std::vector<BoundingBox> movedBounds[NUM_RING_BUFFER_FRAMES];
+
+      // Models submitted this frame, and how many times each was submitted.
+      std::vector<Renderable> renderables;
+      std::unordered_map<Model*, uint> modelSubmissions;
 
-      // Items for the shadow pass.
-      std::vector<std::pair<Model*, glm::mat4>> staticShadowQueue;
-      std::vector<std::tuple<Model*, Animator*, glm::mat4>> dynamicShadowQueue;
       glm::mat4 cascades[NUM_CASCADES];
       float cascadeSplits[NUM_CASCADES];
       bool hasCascades;
 
+      Frustum cascadeFrustums[NUM_CASCADES];
+
+      // The direction the cascades look along, towards the ground.
+      glm::vec3 cascadeDirection;
+
+      // Worldspace bounds of every submitted submesh. The submeshes of
+      // renderable i start at boundsOffsets[i].
+      BoundingBoxArray renderableBounds;
+      std::vector<uint> boundsOffsets;
+
+      // Local bounds (min, max) of the animated submeshes in their current
+      // pose, rebuilt from the bone bounds. Indexed like the bounds above.
+      std::vector<glm::vec4> posedBounds;
+
+      // Visibility of the submeshes for the camera and each of the cascades.
+      VisibilityMask cameraVisibility;
+      VisibilityMask cascadeVisibility[NUM_CASCADES];
+
+      // Submeshes hidden behind the depth pyramid are cleared, every other
+      // bit is set.
+      VisibilityMask occlusionVisibility;
+
+      // Visible submesh draws, sorted by key. The shadow items of all the
+      // cascades share a list, the cascade is the pass of the key.
+      std::vector<DrawItem> geometryItems;
+      std::vector<DrawItem> shadowItems;
+      std::vector<DrawItem> geometrySortScratch;
+      std::vector<DrawItem> shadowSortScratch;
+
+      // Visible meshlet runs of the submesh being turned into draw items. The
+      // camera and the cascades are culled at the same time, each gets its own.
+      std::vector<MeshletRun> geometryMeshletRuns;
+      std::vector<MeshletRun> shadowMeshletRuns;
+
+      // The sorted items grouped into (possibly instanced) draws.
+      std::vector<DrawBatch> geometryBatches;
+      std::vector<DrawBatch> shadowBatches;
+      std::vector<InstanceData> geometryInstances;
+      std::vector<InstanceData> shadowInstances;
+
+      bool boundsComputed;
+      bool drawablesCulled;
+      bool shadowCastersCulled;
+
       Unique<EnvironmentMap> currentEnvironment;
 
       Camera sceneCam;
@@ -107,23 +222,34 @@ namespace Strontium
 
       RendererStorage()
         : blankVAO()
-        , camBuffer(2 * sizeof(glm::mat4) + sizeof(glm::vec3), BufferType::Dynamic)
-        , transformBuffer(sizeof(glm::mat4), BufferType::Dynamic)
-        , editorBuffer(sizeof(glm::vec4), BufferType::Dynamic)
         , ambientPassBuffer(sizeof(glm::vec4), BufferType::Dynamic)
         , directionalPassBuffer(2 * sizeof(glm::vec4) + sizeof(glm::ivec4), BufferType::Dynamic)
-        , pointPassBuffer(sizeof(PointLight), BufferType::Dynamic)
-        , cascadeShadowPassBuffer(sizeof(glm::mat4), BufferType::Dynamic)
-        , cascadeShadowBuffer(NUM_CASCADES * sizeof(glm::mat4)
-                              + NUM_CASCADES * sizeof(glm::vec4) + sizeof(glm::vec4),
-                              BufferType::Dynamic)
-        , postProcessSettings(2 * sizeof(glm::mat4) + 2 * sizeof(glm::vec4)
-                              + sizeof(glm::ivec4), BufferType::Dynamic)
-        , boneBuffer(MAX_BONES_PER_MODEL * sizeof(glm::mat4), BufferType::Dynamic)
+        , clusterAABBs(NUM_CLUSTERS * 2 * sizeof(glm::vec4), BufferType::Dynamic)
+        , lightGrid(NUM_CLUSTERS * sizeof(glm::uvec4), BufferType::Dynamic)
+        , lightIndices(NUM_CLUSTERS * MAX_LIGHTS_PER_CLUSTER * sizeof(uint), BufferType::Dynamic)
+        , currentClusterStats(0)
+        , clusterProjection(0.0f)
+        , clusterScreenSize(0.0f)
+        , currentHiZReadback(0)
+        , frameData(4 * 1024 * 1024)
+        , numSkinnedVertices(0)
         , lightShaftSettingsBuffer(2 * sizeof(glm::vec4), BufferType::Dynamic)
         , bloomSettingsBuffer(sizeof(glm::vec4) + sizeof(float), BufferType::Dynamic)
+        , boundsComputed(false)
+        , drawablesCulled(false)
+        , shadowCastersCulled(false)
       {
         currentEnvironment = createUnique<EnvironmentMap>();
+
+        for (uint i = 0; i < NUM_RING_BUFFER_FRAMES; i++)
+          clusterStats[i] = createUnique<ShaderStorageBuffer>(sizeof(glm::uvec4), BufferType::Dynamic);
+        for (uint i = 0; i < NUM_RING_BUFFER_FRAMES; i++)
+          hiZReadbacks[i].buffer = createUnique<ShaderStorageBuffer>(sizeof(float), BufferType::Dynamic);
+
+        // The instance IDs are streamed after the mesh vertex attributes.
+        geometryArena = createShared<GeometryArena>(sizeof(Vertex), sizeof(VertexSkin),
+                                                    Mesh::getVertexAttributes(), 7,
+                                                    256 * 1024, 1024 * 1024);
       }
     };
 
@@ -136,6 +262,37 @@ namespace Strontium
       // Settings for rendering.
       bool isForward;
       bool frustumCull;
+      bool gpuCulling;
+      bool computeSkinning;
+
+      // Animation LOD settings. Sizes are the fraction of the screen height
+      // covered by the bounding sphere of an animated model. Models above the
+      // full rate size update every frame, above the half rate size every
+      // other frame and every fourth frame otherwise. Models below the reduced
+      // bones size leave the deepest bone levels in their bind pose.
+      bool animationLOD;
+      float aniLODFullRateSize;
+      float aniLODHalfRateSize;
+      float aniLODReducedBonesSize;
+      uint aniLODDroppedBoneLevels;
+      bool aniLODFreezeOffscreen;
+
+      // Mesh LOD settings. Each submesh draws its coarsest LOD whose error
+      // projects to at most the threshold in pixels. Shadows allow the
+      // shadow bias times more error.
+      bool meshLOD;
+      float meshLODThreshold;
+      float meshLODShadowBias;
+
+      // Meshlet culling settings. Full detail static submeshes with meshlets
+      // only draw the meshlets inside the frustum, and which aren't back
+      // facing if cone culling is enabled.
+      bool meshletCulling;
+      bool meshletConeCulling;
+
+      // Occlusion culling of the camera's submeshes against the depth of the
+      // frame rendered NUM_RING_BUFFER_FRAMES frames earlier.
+      bool occlusionCulling;
 
       // Environment map settings.
       uint skyboxWidth;
@@ -176,6 +333,20 @@ namespace Strontium
         : currentFrame(0)
         , isForward(false)
         , frustumCull(false)
+        , gpuCulling(true)
+        , computeSkinning(true)
+        , animationLOD(true)
+        , aniLODFullRateSize(0.25f)
+        , aniLODHalfRateSize(0.1f)
+        , aniLODReducedBonesSize(0.05f)
+        , aniLODDroppedBoneLevels(2)
+        , aniLODFreezeOffscreen(true)
+        , meshLOD(true)
+        , meshLODThreshold(1.0f)
+        , meshLODShadowBias(4.0f)
+        , meshletCulling(true)
+        , meshletConeCulling(true)
+        , occlusionCulling(true)
         , skyboxWidth(512)
         , irradianceWidth(128)
         , prefilterWidth(512)
@@ -202,28 +373,90 @@ namespace Strontium
     struct RendererStats
     {
       uint drawCalls;
+      uint drawCommands;
+      uint numInstances;
       uint numVertices;
       uint numTriangles;
       uint numDirLights;
       uint numPointLights;
       uint numSpotLights;
 
+      float cullFrametime;
       float geoFrametime;
       float shadowFrametime;
       float lightFrametime;
       float postFramtime;
 
+      // Clustered lighting, read back a few frames late.
+      uint numActiveClusters;
+      uint maxLightsPerCluster;
+      float avgLightsPerCluster;
+      uint numOverflowedClusters;
+      float clusteredLightGPUTime;
+
+      // State changes skipped thanks to the sorted draw items.
+      uint skippedShaderBinds;
+      uint skippedMaterialBinds;
+
+      // Animation LOD picked for the submitted animators.
+      uint numAnimators;
+      uint numReducedRateAnimators;
+      uint numFrozenAnimators;
+
+      // Vertices skinned by the compute pre-pass.
+      uint numSkinnedVertices;
+
+      // Triangles submitted at each mesh LOD, before GPU culling.
+      uint numLODTriangles[MAX_MESH_LODS];
+      uint numShadowLODTriangles[MAX_MESH_LODS];
+
+      // Meshlets tested by the meshlet culling and the ones it rejected.
+      uint numMeshlets;
+      uint numFrustumCulledMeshlets;
+      uint numConeCulledMeshlets;
+      uint numShadowMeshlets;
+      uint numShadowFrustumCulledMeshlets;
+      uint numShadowConeCulledMeshlets;
+
+      // Submeshes tested against the depth pyramid and the ones it culled.
+      uint numOcclusionTested;
+      uint numOcclusionCulled;
+
       RendererStats()
         : drawCalls(0)
+        , drawCommands(0)
+        , numInstances(0)
         , numVertices(0)
         , numTriangles(0)
         , numDirLights(0)
         , numPointLights(0)
         , numSpotLights(0)
+        , cullFrametime(0.0f)
         , geoFrametime(0.0f)
         , shadowFrametime(0.0f)
         , lightFrametime(0.0f)
         , postFramtime(0.0f)
+        , numActiveClusters(0)
+        , maxLightsPerCluster(0)
+        , avgLightsPerCluster(0.0f)
+        , numOverflowedClusters(0)
+        , clusteredLightGPUTime(0.0f)
+        , skippedShaderBinds(0)
+        , skippedMaterialBinds(0)
+        , numAnimators(0)
+        , numReducedRateAnimators(0)
+        , numFrozenAnimators(0)
+        , numSkinnedVertices(0)
+        , numLODTriangles()
+        , numShadowLODTriangles()
+        , numMeshlets(0)
+        , numFrustumCulledMeshlets(0)
+        , numConeCulledMeshlets(0)
+        , numShadowMeshlets(0)
+        , numShadowFrustumCulledMeshlets(0)
+        , numShadowConeCulledMeshlets(0)
+        , numOcclusionTested(0)
+        , numOcclusionCulled(0)
       { }
     };
 
@@ -243,12 +476,37 @@ namespace Strontium
     void begin(uint width, uint height, const Camera &sceneCamera);
     void end(Shared<FrameBuffer> frontBuffer);
 
-    // Deferred rendering setup.
+    // Register begin, culling and the passes as stages of a frame task graph.
+    void registerFrameTasks(TaskGraph &graph, uint width, uint height,
+                            const Camera &sceneCamera, Shared<FrameBuffer> frontBuffer);
+
+    // Batch culling of the submitted renderables. Bounds are computed once all
+    // the renderables are submitted, then culled against the camera and the
+    // shadow cascades. The visible submeshes are turned into sorted draw items
+    // for the passes. Runs as part of end() if it wasn't done earlier.
+    void computeSubmeshBounds();
+    void cullDrawables();
+    void cullShadowCasters();
+
+    // Skin the animated submeshes into the geometry arena once for all the
+    // passes, and upload the bone palette they share. Runs after the bounds
+    // are computed, on the thread which owns the context.
+    void skinningPass();
+
+    // Deferred rendering setup. Renderables which moved since the last frame
+    // pass the transform they had then, so the occlusion culling doesn't
+    // trust the depth where they were.
     void submit(Model* data, ModelMaterial &materials, const glm::mat4 &model,
-                float id = 0.0f, bool drawSelectionMask = false);
+                float id = 0.0f, bool drawSelectionMask = false,
+                const glm::mat4* previousModel = nullptr);
     void submit(Model* data, Animator* animation, ModelMaterial &materials,
                 const glm::mat4 &model, float id = 0.0f,
-                bool drawSelectionMask = false);
+                bool drawSelectionMask = false, const glm::mat4* previousModel = nullptr);
+
+    // Occluders changed in ways the submitted transforms don't show, like
+    // deleted renderables. The depth of the frames in flight is no longer
+    // used for occlusion culling. Call between begin() and the culling.
+    void invalidateOcclusion();
     void submit(DirectionalLight light, const glm::mat4 &model);
     void submit(PointLight light, const glm::mat4 &model);
     void submit(SpotLight light, const glm::mat4 &model);
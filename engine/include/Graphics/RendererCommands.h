@@ -38,6 +38,22 @@ namespace Strontium
     Triangle = 0x0004 // GL_TRIANGLES
   };
 
+  enum class IndexType
+  {
+    UnsignedShort = 0x1403, // GL_UNSIGNED_SHORT
+    UnsignedInt = 0x1405 // GL_UNSIGNED_INT
+  };
+
+  // Layout of the commands read by glMultiDrawElementsIndirect.
+  struct DrawElementsIndirectCommand
+  {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+  };
+
   namespace RendererCommands
   {
     void enable(const RendererFunction &toEnable);
@@ -53,6 +69,15 @@ namespace Strontium
     void setViewport(const glm::ivec2 topRight, const glm::ivec2 bottomLeft = glm::ivec2(0));
 
     void drawElements(PrimativeType primative, uint count, const void* indices = nullptr);
+    void drawElementsInstanced(PrimativeType primative, uint count, uint instanceCount,
+                               const void* indices = nullptr);
+    void drawElementsBaseVertex(PrimativeType primative, uint count, uint firstIndex,
+                                int baseVertex, IndexType indexType = IndexType::UnsignedInt);
+
+    // Draws drawCount commands from the bound draw indirect buffer, starting
+    // at offset bytes into the buffer.
+    void multiDrawElementsIndirect(PrimativeType primative, uint offset, uint drawCount,
+                                   IndexType indexType = IndexType::UnsignedInt);
     void drawArrays(PrimativeType primative, uint start, uint count);
   };
 }
@@ -18,7 +18,8 @@ namespace Strontium
     Unknown
   };
 
-  enum class AttribType { Vec4, Vec3, Vec2, IVec4, IVec3, IVec2 };
+  // Vec2Half is a pair of half floats and IVec4Short four 16 bit integers.
+  enum class AttribType { Vec4, Vec3, Vec2, IVec4, IVec3, IVec2, Vec2Half, IVec4Short };
   enum class UniformType
   {
     Float = 0x1406, // GL_FLOAT
@@ -36,7 +37,11 @@ namespace Strontium
 
   enum class MemoryBarrierType
   {
-    ShaderImageAccess = 0x00000020 // GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+    VertexAttribArray = 0x00000001, // GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+    ShaderImageAccess = 0x00000020, // GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+    Command = 0x00000040, // GL_COMMAND_BARRIER_BIT
+    BufferUpdate = 0x00000200, // GL_BUFFER_UPDATE_BARRIER_BIT
+    ShaderStorage = 0x00002000 // GL_SHADER_STORAGE_BARRIER_BIT
   };
 
   // Shader abstraction which supports multiple shader stages.
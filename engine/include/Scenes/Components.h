@@ -121,6 +121,41 @@ namespace Strontium
     }
   };
 
+  // Cached world transform, maintained by the scene. The local transform the
+  // matrices were built from is kept to detect changes. The dirty flag is set
+  // if the world matrix changed during the last update.
+  struct WorldTransformComponent
+  {
+    glm::mat4 localMatrix;
+    glm::mat4 worldMatrix;
+
+    glm::vec3 localTranslation;
+    glm::vec3 localRotation;
+    glm::vec3 localScale;
+
+    bool dirty;
+
+    // The world matrix before the last update, and if the update moved it
+    // from there. A world matrix computed for the first time didn't move.
+    glm::mat4 previousWorldMatrix;
+    bool moved;
+    bool computed;
+
+    WorldTransformComponent(const WorldTransformComponent&) = default;
+
+    WorldTransformComponent()
+      : localMatrix(1.0f)
+      , worldMatrix(1.0f)
+      , localTranslation(0.0f)
+      , localRotation(0.0f)
+      , localScale(1.0f)
+      , dirty(true)
+      , previousWorldMatrix(1.0f)
+      , moved(false)
+      , computed(false)
+    { }
+  };
+
   // Renderable component. This is the component which is passed to the renderer
   // alongside the transform component.
   struct RenderableComponent
@@ -5,7 +5,9 @@
 
 // Project includes.
 #include "Core/ApplicationBase.h"
+#include "Core/TaskGraph.h"
 #include "Graphics/ShadingPrimatives.h"
+#include "Scenes/StaticBatcher.h"
 
 // Entity component system include.
 #include "entt.hpp"
@@ -13,6 +15,8 @@
 namespace Strontium
 {
   class Entity;
+  class Animator;
+  class Animation;
 
   class Scene
   {
@@ -30,17 +34,74 @@ namespace Strontium
     void onRenderEditor(Entity selectedEntity);
     void onRenderRuntime();
 
+    // Register the update and render stages of the scene in a frame task graph.
+    // The stages submit to the renderer, so the renderer stages must be
+    // registered in the same graph.
+    void registerEditorTasks(TaskGraph &graph, float dt, Entity selectedEntity);
+    void registerRuntimeTasks(TaskGraph &graph, float dt);
+
     Entity getPrimaryCameraEntity();
 
+    // Bring the cached world transforms up to date. Only entities whose local
+    // transform or ancestors changed get recomputed.
+    void updateWorldTransforms();
+
     entt::registry& getRegistry() { return this->sceneECS; }
+    StaticBatcher& getStaticBatcher() { return this->staticBatcher; }
     std::string& getSaveFilepath() { return this->saveFilepath; }
   protected:
-    glm::mat4 computeGlobalTransform(Entity parent);
+    void rebuildTransformHierarchy();
+    void onHierarchyChanged(entt::registry &registry, entt::entity entity);
+    void onRenderableRemoved(entt::registry &registry, entt::entity entity);
 
     void updateAnimations(float dt);
+    void animateAmbient(float dt);
+
+    // Stages of the scene render.
+    void prepareComponentPools();
+    void prepareEnvironment();
+    void submitLights();
+    void computeDrawableTransforms();
+    void updateStaticBatches(Entity selectedEntity);
+    void submitDrawables(Entity selectedEntity);
+    void registerRenderTasks(TaskGraph &graph, Entity selectedEntity);
 
     entt::registry sceneECS;
 
+    // Global transforms of the drawables for the current frame.
+    std::vector<std::pair<entt::entity, glm::mat4>> drawableTransforms;
+
+    // Entities with world transforms, sorted so parents come before their
+    // children, and the index of each entity's parent (-1 for roots).
+    std::vector<entt::entity> transformHierarchy;
+    std::vector<int> transformParents;
+    bool hierarchyChanged;
+
+    // Set when renderables were removed since the last submission. Starts out
+    // set, whatever was drawn before this scene could still be in the depth
+    // the renderer culls against.
+    bool occludersRemoved;
+
+    // Opt-in merged geometry of the static renderables. Batched entities
+    // aren't submitted on their own.
+    StaticBatcher staticBatcher;
+
+    // Animators which need a new pose this frame. Sorted so animators playing
+    // the same animation at the same sample and bone LOD are adjacent, each
+    // group is evaluated once and the pose is copied to the rest of the group.
+    struct AnimationUpdate
+    {
+      Animator* animator;
+      const Animation* animation;
+      uint sample;
+      uint droppedBoneLevels;
+    };
+    std::vector<AnimationUpdate> animationUpdates;
+    std::vector<uint> animationGroups;
+
+    // Reduced rate animators which blend between poses.
+    std::vector<Animator*> animationBlends;
+
     std::string saveFilepath;
 
     friend class Entity;
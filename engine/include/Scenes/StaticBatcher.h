@@ -0,0 +1,129 @@
+#pragma once
+
+// Side length of the world space grid cells static batches are split by.
+// Entities are only merged with entities in the same cell, which keeps the
+// batches small enough to cull and limits how much gets rebuilt on an edit.
+#define STATIC_BATCH_CELL_SIZE 32.0f
+// Vertices of a batch submesh, batches stay on 16 bit indices.
+#define STATIC_BATCH_MAX_VERTICES 65536
+// Models with more vertices than this aren't batched, they're already large
+// enough to be worth their own draws.
+#define STATIC_BATCH_MAX_SOURCE_VERTICES 16384
+
+// Macro include file.
+#include "StrontiumPCH.h"
+
+// Project includes.
+#include "Core/ApplicationBase.h"
+#include "Graphics/Model.h"
+#include "Graphics/Material.h"
+
+// Entity component system include.
+#include "entt.hpp"
+
+namespace Strontium
+{
+  // Statistics of the static batches, for the editor.
+  struct StaticBatchStats
+  {
+    uint numBatches;
+    uint numSourceEntities;
+    uint numVertices;
+    uint numRebuiltBatches;
+
+    StaticBatchStats()
+      : numBatches(0)
+      , numSourceEntities(0)
+      , numVertices(0)
+      , numRebuiltBatches(0)
+    { }
+  };
+
+  // Merges the static renderables of a scene which share a material into
+  // world space batches, so props drawn with the same material cost one draw
+  // instead of one per entity. Entities are static if they're unparented,
+  // not animated and have no skinned submeshes. The batches are rebuilt
+  // lazily: an entity whose transform, model or materials change only dirties
+  // the batches it went into.
+  //
+  // Each source submesh is a run of meshlets in the batch, its own meshlets
+  // moved into world space when it has them, so the batch is still culled
+  // per source by the renderer's meshlet culling.
+  class StaticBatcher
+  {
+  public:
+    StaticBatcher();
+    ~StaticBatcher();
+
+    // Bring the batches up to date with the registry. Nothing is batched
+    // while models are still loading, so a scene that was just deserialized
+    // is batched once. The selected entity is kept out of the batches so it
+    // can be edited without rebuilding anything.
+    void update(entt::registry &registry, entt::entity selectedEntity);
+
+    // Submit the batches to the renderer.
+    void submit();
+
+    // Release every batch and forget the source entities.
+    void clear();
+
+    // If the entity is drawn by a batch instead of on its own.
+    bool isBatched(entt::entity entity) const;
+
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return this->enabled; }
+
+    const StaticBatchStats& getStats() const { return this->stats; }
+  protected:
+    // Batches are keyed by material and grid cell.
+    struct BatchKey
+    {
+      AssetHandle material;
+      glm::ivec3 cell;
+
+      bool operator<(const BatchKey &other) const
+      {
+        if (this->material != other.material)
+          return this->material < other.material;
+        if (this->cell.x != other.cell.x)
+          return this->cell.x < other.cell.x;
+        if (this->cell.y != other.cell.y)
+          return this->cell.y < other.cell.y;
+        return this->cell.z < other.cell.z;
+      }
+    };
+
+    // The merged geometry of the submeshes using a material in a cell. The
+    // model has a submesh per STATIC_BATCH_MAX_VERTICES vertices.
+    struct Batch
+    {
+      BatchKey key;
+      std::vector<entt::entity> sources;
+      Unique<Model> model;
+      ModelMaterial materials;
+      bool dirty;
+    };
+
+    // What an entity looked like when it was batched, to detect edits.
+    struct Source
+    {
+      Model* model;
+      glm::mat4 transform;
+      std::vector<AssetHandle> materials;
+      std::vector<Batch*> batches;
+      bool seen;
+    };
+
+    void addSource(entt::entity entity, Source &source);
+    void removeSource(entt::entity entity, Source &source);
+    void rebuildBatch(Batch &batch);
+
+    bool enabled;
+
+    // Map nodes don't move, so the sources can point at their batches.
+    std::map<BatchKey, Batch> batches;
+    std::unordered_map<entt::entity, Source> sources;
+
+    StaticBatchStats stats;
+  };
+}
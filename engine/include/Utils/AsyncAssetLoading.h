@@ -17,6 +17,8 @@ namespace Strontium
     void bulkGenerateMaterials();
     void asyncLoadModel(const std::string &filepath, const std::string &name,
                         uint entityID, Scene* activeScene);
+    // If any model is still loading or waiting for its materials.
+    bool hasPendingModels();
 
     // Async load an image.
     void bulkGenerateTextures();
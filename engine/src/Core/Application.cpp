@@ -35,7 +35,7 @@ namespace Strontium
     this->appWindow = Window::getNewInstance(this->name);
 
     // Initialize the thread pool.
-    workerGroup = Unique<ThreadPool>(ThreadPool::getInstance(4));
+    workerGroup = Unique<ThreadPool>(ThreadPool::getInstance());
 
     // Init the shader cache.
     ShaderCache::init("./assets/shaders/shaderManifest.yaml");
@@ -1,5 +1,24 @@
 #include "Core/Math.h"
 
+// Project includes.
+#include "Core/ThreadPool.h"
+
+// SIMD includes. SSE2 is the baseline on x64, AVX needs to be enabled by the
+// compiler (/arch:AVX or -mavx).
+#if defined(__AVX__)
+  #define CULLING_USE_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define CULLING_USE_SSE
+#endif
+
+#if defined(CULLING_USE_AVX) || defined(CULLING_USE_SSE)
+  #include <immintrin.h>
+#endif
+
+// Number of mask words (32 boxes each) per culling job.
+#define CULLING_WORDS_PER_JOB 16
+
 namespace Strontium
 {
   BoundingBox
@@ -45,6 +64,89 @@ namespace Strontium
     return outBox;
   }
 
+  void
+  expandTransformedBounds(const glm::vec3 &min, const glm::vec3 &max,
+                          const glm::mat4 &transform, glm::vec3 &outMin,
+                          glm::vec3 &outMax)
+  {
+    glm::vec3 localCenter = (min + max) * 0.5f;
+    glm::vec3 localExtents = (max - min) * 0.5f;
+
+  #if defined(CULLING_USE_SSE)
+    // The transformed center is the matrix columns weighted by the center,
+    // the extents are the absolute columns weighted by the extents.
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 column0 = _mm_loadu_ps(&transform[0][0]);
+    __m128 column1 = _mm_loadu_ps(&transform[1][0]);
+    __m128 column2 = _mm_loadu_ps(&transform[2][0]);
+    __m128 column3 = _mm_loadu_ps(&transform[3][0]);
+
+    __m128 center = _mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(localCenter.x)),
+                               _mm_mul_ps(column1, _mm_set1_ps(localCenter.y)));
+    center = _mm_add_ps(center, _mm_mul_ps(column2, _mm_set1_ps(localCenter.z)));
+    center = _mm_add_ps(center, column3);
+
+    __m128 extents = _mm_mul_ps(_mm_andnot_ps(signMask, column0), _mm_set1_ps(localExtents.x));
+    extents = _mm_add_ps(extents, _mm_mul_ps(_mm_andnot_ps(signMask, column1),
+                                             _mm_set1_ps(localExtents.y)));
+    extents = _mm_add_ps(extents, _mm_mul_ps(_mm_andnot_ps(signMask, column2),
+                                             _mm_set1_ps(localExtents.z)));
+
+    float boxMin[4], boxMax[4];
+    _mm_storeu_ps(boxMin, _mm_sub_ps(center, extents));
+    _mm_storeu_ps(boxMax, _mm_add_ps(center, extents));
+
+    outMin = glm::min(outMin, glm::vec3(boxMin[0], boxMin[1], boxMin[2]));
+    outMax = glm::max(outMax, glm::vec3(boxMax[0], boxMax[1], boxMax[2]));
+  #else
+    glm::vec3 center = glm::vec3(transform * glm::vec4(localCenter, 1.0f));
+    glm::vec3 extents = glm::abs(glm::vec3(transform[0])) * localExtents.x
+                        + glm::abs(glm::vec3(transform[1])) * localExtents.y
+                        + glm::abs(glm::vec3(transform[2])) * localExtents.z;
+
+    outMin = glm::min(outMin, center - extents);
+    outMax = glm::max(outMax, center + extents);
+  #endif
+  }
+
+  // Sign which treats zero as positive, so folded vectors on the axes don't
+  // collapse to zero.
+  static inline glm::vec2
+  signNotZero(const glm::vec2 &value)
+  {
+    return glm::vec2(value.x >= 0.0f ? 1.0f : -1.0f, value.y >= 0.0f ? 1.0f : -1.0f);
+  }
+
+  glm::vec2
+  encodeOctahedral(const glm::vec3 &vector)
+  {
+    float l1Norm = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+    if (l1Norm == 0.0f)
+      return glm::vec2(0.0f);
+
+    // Project onto the octahedron, then fold the lower hemisphere over the
+    // upper one.
+    glm::vec2 encoded = glm::vec2(vector.x, vector.y) / l1Norm;
+    if (vector.z < 0.0f)
+      encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * signNotZero(encoded);
+
+    return encoded;
+  }
+
+  glm::vec3
+  decodeOctahedral(const glm::vec2 &encoded)
+  {
+    glm::vec3 vector = glm::vec3(encoded, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    if (vector.z < 0.0f)
+    {
+      glm::vec2 unfolded = (1.0f - glm::abs(glm::vec2(vector.y, vector.x))) * signNotZero(glm::vec2(vector));
+      vector.x = unfolded.x;
+      vector.y = unfolded.y;
+    }
+
+    return glm::normalize(vector);
+  }
+
   Frustum
   buildCameraFrustum(const Camera &camera)
   {
@@ -271,4 +373,172 @@ namespace Strontium
 
     return inFrustum;
   }
+
+  //----------------------------------------------------------------------------
+  // Batch culling.
+  //----------------------------------------------------------------------------
+  void
+  BoundingBoxArray::resize(uint numBoxes)
+  {
+    uint paddedBoxes = (numBoxes + 31) & ~31u;
+
+    this->centerX.assign(paddedBoxes, 0.0f);
+    this->centerY.assign(paddedBoxes, 0.0f);
+    this->centerZ.assign(paddedBoxes, 0.0f);
+    this->extentX.assign(paddedBoxes, 0.0f);
+    this->extentY.assign(paddedBoxes, 0.0f);
+    this->extentZ.assign(paddedBoxes, 0.0f);
+
+    this->count = numBoxes;
+  }
+
+  void
+  BoundingBoxArray::set(uint index, const BoundingBox &box)
+  {
+    this->centerX[index] = box.center.x;
+    this->centerY[index] = box.center.y;
+    this->centerZ[index] = box.center.z;
+    this->extentX[index] = box.extents.x;
+    this->extentY[index] = box.extents.y;
+    this->extentZ[index] = box.extents.z;
+  }
+
+  // Test the boxes in [start, end) against a single frustum. Same test as
+  // boundingBoxOnPlane, a box is visible if -r <= d for all six planes. The
+  // range must start on a mask word and the mask words must be zeroed.
+  static void
+  cullBoxRange(const BoundingBoxArray &boxes, const Frustum &frustum,
+               uint start, uint end, uint* outMask)
+  {
+    uint i = start;
+
+  #if defined(CULLING_USE_AVX)
+    __m256 avxNormalX[6], avxNormalY[6], avxNormalZ[6];
+    __m256 avxAbsNormalX[6], avxAbsNormalY[6], avxAbsNormalZ[6], avxPlaneD[6];
+    for (uint p = 0; p < 6; p++)
+    {
+      const Plane &plane = frustum.sides[p];
+      avxNormalX[p] = _mm256_set1_ps(plane.normal.x);
+      avxNormalY[p] = _mm256_set1_ps(plane.normal.y);
+      avxNormalZ[p] = _mm256_set1_ps(plane.normal.z);
+      avxAbsNormalX[p] = _mm256_set1_ps(std::abs(plane.normal.x));
+      avxAbsNormalY[p] = _mm256_set1_ps(std::abs(plane.normal.y));
+      avxAbsNormalZ[p] = _mm256_set1_ps(std::abs(plane.normal.z));
+      avxPlaneD[p] = _mm256_set1_ps(plane.d);
+    }
+
+    for (; i + 8 <= end; i += 8)
+    {
+      __m256 cx = _mm256_loadu_ps(&boxes.centerX[i]);
+      __m256 cy = _mm256_loadu_ps(&boxes.centerY[i]);
+      __m256 cz = _mm256_loadu_ps(&boxes.centerZ[i]);
+      __m256 ex = _mm256_loadu_ps(&boxes.extentX[i]);
+      __m256 ey = _mm256_loadu_ps(&boxes.extentY[i]);
+      __m256 ez = _mm256_loadu_ps(&boxes.extentZ[i]);
+
+      __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+      for (uint p = 0; p < 6; p++)
+      {
+        __m256 distance = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(
+                                        _mm256_mul_ps(avxNormalX[p], cx),
+                                        _mm256_mul_ps(avxNormalY[p], cy)),
+                                        _mm256_mul_ps(avxNormalZ[p], cz)),
+                                        avxPlaneD[p]);
+        __m256 radius = _mm256_add_ps(_mm256_add_ps(
+                                      _mm256_mul_ps(avxAbsNormalX[p], ex),
+                                      _mm256_mul_ps(avxAbsNormalY[p], ey)),
+                                      _mm256_mul_ps(avxAbsNormalZ[p], ez));
+        __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), radius);
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+      }
+
+      uint bits = static_cast<uint>(_mm256_movemask_ps(inside));
+      outMask[i >> 5] |= bits << (i & 31);
+    }
+  #endif
+
+  #if defined(CULLING_USE_SSE)
+    __m128 sseNormalX[6], sseNormalY[6], sseNormalZ[6];
+    __m128 sseAbsNormalX[6], sseAbsNormalY[6], sseAbsNormalZ[6], ssePlaneD[6];
+    for (uint p = 0; p < 6; p++)
+    {
+      const Plane &plane = frustum.sides[p];
+      sseNormalX[p] = _mm_set1_ps(plane.normal.x);
+      sseNormalY[p] = _mm_set1_ps(plane.normal.y);
+      sseNormalZ[p] = _mm_set1_ps(plane.normal.z);
+      sseAbsNormalX[p] = _mm_set1_ps(std::abs(plane.normal.x));
+      sseAbsNormalY[p] = _mm_set1_ps(std::abs(plane.normal.y));
+      sseAbsNormalZ[p] = _mm_set1_ps(std::abs(plane.normal.z));
+      ssePlaneD[p] = _mm_set1_ps(plane.d);
+    }
+
+    for (; i + 4 <= end; i += 4)
+    {
+      __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+      __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+      __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+      __m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+      __m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+      __m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (uint p = 0; p < 6; p++)
+      {
+        __m128 distance = _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+                                     _mm_mul_ps(sseNormalX[p], cx),
+                                     _mm_mul_ps(sseNormalY[p], cy)),
+                                     _mm_mul_ps(sseNormalZ[p], cz)),
+                                     ssePlaneD[p]);
+        __m128 radius = _mm_add_ps(_mm_add_ps(
+                                   _mm_mul_ps(sseAbsNormalX[p], ex),
+                                   _mm_mul_ps(sseAbsNormalY[p], ey)),
+                                   _mm_mul_ps(sseAbsNormalZ[p], ez));
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+      }
+
+      uint bits = static_cast<uint>(_mm_movemask_ps(inside));
+      outMask[i >> 5] |= bits << (i & 31);
+    }
+  #endif
+
+    // Scalar path for the remaining boxes (or everything, without SIMD).
+    for (; i < end; i++)
+    {
+      BoundingBox box;
+      box.center = glm::vec3(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+      box.extents = glm::vec3(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+
+      bool inFrustum = true;
+      for (uint p = 0; p < 6; p++)
+        inFrustum = inFrustum && boundingBoxOnPlane(frustum.sides[p], box);
+
+      if (inFrustum)
+        outMask[i >> 5] |= 1u << (i & 31);
+    }
+  }
+
+  void
+  boundingBoxesInFrustums(const BoundingBoxArray &boxes, const Frustum* frustums,
+                          uint numFrustums, VisibilityMask* outMasks,
+                          bool multithreaded)
+  {
+    uint numWords = boxes.paddedCount() / 32;
+    for (uint f = 0; f < numFrustums; f++)
+      outMasks[f].assign(numWords, 0u);
+
+    if (numWords == 0)
+      return;
+
+    auto cullWords = [&boxes, frustums, numFrustums, outMasks](uint startWord, uint endWord)
+    {
+      for (uint f = 0; f < numFrustums; f++)
+        cullBoxRange(boxes, frustums[f], startWord * 32, endWord * 32, outMasks[f].data());
+    };
+
+    if (multithreaded && numWords > CULLING_WORDS_PER_JOB)
+      ThreadPool::getInstance()->parallelFor(numWords, CULLING_WORDS_PER_JOB, cullWords);
+    else
+      cullWords(0, numWords);
+  }
 }
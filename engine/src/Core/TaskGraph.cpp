@@ -0,0 +1,243 @@
+#include "Core/TaskGraph.h"
+
+// Project includes.
+#include "Core/Logs.h"
+
+namespace Strontium
+{
+  TaskGraph::TaskGraph()
+    : remainingTasks(0)
+    , criticalPathTime(0.0f)
+    , totalTime(0.0f)
+  { }
+
+  TaskGraph::~TaskGraph()
+  { }
+
+  void
+  TaskGraph::addTask(const std::string &name, const std::function<void()> &task,
+                     TaskAffinity affinity)
+  {
+    assert(("Task names must be unique.", !this->hasTask(name)));
+
+    this->taskIndices.emplace(name, this->tasks.size());
+    this->tasks.emplace_back(name, task, affinity);
+  }
+
+  void
+  TaskGraph::addDependency(const std::string &before, const std::string &after)
+  {
+    this->dependencies.emplace_back(before, after);
+  }
+
+  void
+  TaskGraph::clear()
+  {
+    this->tasks.clear();
+    this->taskIndices.clear();
+    this->dependencies.clear();
+    this->topologicalOrder.clear();
+  }
+
+  bool
+  TaskGraph::compile()
+  {
+    for (auto& node : this->tasks)
+    {
+      node.successors.clear();
+      node.numDependencies = 0;
+    }
+
+    // Resolve the named edges. Edges to or from tasks which weren't added
+    // this frame are skipped.
+    for (auto& [before, after] : this->dependencies)
+    {
+      auto beforeLoc = this->taskIndices.find(before);
+      auto afterLoc = this->taskIndices.find(after);
+      if (beforeLoc == this->taskIndices.end() || afterLoc == this->taskIndices.end())
+        continue;
+
+      auto& successors = this->tasks[beforeLoc->second].successors;
+      if (std::find(successors.begin(), successors.end(), afterLoc->second) != successors.end())
+        continue;
+
+      successors.push_back(afterLoc->second);
+      this->tasks[afterLoc->second].numDependencies++;
+    }
+
+    // Kahn's algorithm for the topological ordering, used to find cycles and
+    // the critical path.
+    std::vector<uint> inDegrees(this->tasks.size());
+    std::queue<uint> readyTasks;
+    for (uint i = 0; i < this->tasks.size(); i++)
+    {
+      inDegrees[i] = this->tasks[i].numDependencies;
+      if (inDegrees[i] == 0)
+        readyTasks.push(i);
+    }
+
+    this->topologicalOrder.clear();
+    this->topologicalOrder.reserve(this->tasks.size());
+    while (!readyTasks.empty())
+    {
+      uint current = readyTasks.front();
+      readyTasks.pop();
+      this->topologicalOrder.push_back(current);
+
+      for (auto successor : this->tasks[current].successors)
+      {
+        inDegrees[successor]--;
+        if (inDegrees[successor] == 0)
+          readyTasks.push(successor);
+      }
+    }
+
+    return this->topologicalOrder.size() == this->tasks.size();
+  }
+
+  void
+  TaskGraph::execute()
+  {
+    if (!this->compile())
+    {
+      Logger::getInstance()->logMessage(LogMessage("Frame task graph contains a "
+                                                   "cycle, skipping execution.",
+                                                   true, true));
+      return;
+    }
+
+    auto workerGroup = ThreadPool::getInstance();
+
+    this->timings.clear();
+    this->timings.resize(this->tasks.size());
+    for (uint i = 0; i < this->tasks.size(); i++)
+      this->timings[i].name = this->tasks[i].name;
+
+    this->pendingDependencies.reset(new std::atomic<uint>[this->tasks.size()]);
+    for (uint i = 0; i < this->tasks.size(); i++)
+      this->pendingDependencies[i].store(this->tasks[i].numDependencies);
+    this->remainingTasks.store(this->tasks.size());
+
+    this->executionStart = std::chrono::steady_clock::now();
+
+    // Launch the root tasks.
+    for (uint i = 0; i < this->tasks.size(); i++)
+    {
+      if (this->tasks[i].numDependencies == 0)
+        this->schedule(i);
+    }
+
+    // Execute the main thread tasks as they become available, help the workers
+    // out with this graph's tasks otherwise. Jobs pushed by anyone else could
+    // run for longer than the frame, the main thread only yields to those.
+    while (this->remainingTasks.load() > 0)
+    {
+      uint taskIndex = 0;
+      bool hasMainTask = false;
+      {
+        std::lock_guard<std::mutex> mainLock(this->mainThreadMutex);
+        if (!this->mainThreadTasks.empty())
+        {
+          taskIndex = this->mainThreadTasks.front();
+          this->mainThreadTasks.pop();
+          hasMainTask = true;
+        }
+      }
+
+      if (hasMainTask)
+        this->runTask(taskIndex);
+      else if (!workerGroup->tryExecuteJob(this->workerTasks))
+        std::this_thread::yield();
+    }
+
+    // Make sure the jobs have fully released before the next execution. Every
+    // task has run by now, so there's nothing of ours left to help with.
+    while (!this->workerTasks.isDone())
+      std::this_thread::yield();
+
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - this->executionStart;
+    this->totalTime = elapsed.count() * 1000.0f;
+
+    this->computeCriticalPath();
+  }
+
+  void
+  TaskGraph::schedule(uint taskIndex)
+  {
+    if (this->tasks[taskIndex].affinity == TaskAffinity::MainThread)
+    {
+      std::lock_guard<std::mutex> mainLock(this->mainThreadMutex);
+      this->mainThreadTasks.push(taskIndex);
+    }
+    else
+    {
+      ThreadPool::getInstance()->push(this->workerTasks, [this, taskIndex]()
+      {
+        this->runTask(taskIndex);
+      });
+    }
+  }
+
+  void
+  TaskGraph::runTask(uint taskIndex)
+  {
+    auto& node = this->tasks[taskIndex];
+
+    auto start = std::chrono::steady_clock::now();
+    node.task();
+    auto end = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> startTime = start - this->executionStart;
+    std::chrono::duration<double> duration = end - start;
+    this->timings[taskIndex].startTime = startTime.count() * 1000.0f;
+    this->timings[taskIndex].duration = duration.count() * 1000.0f;
+
+    // Release the successors which are now ready.
+    for (auto successor : node.successors)
+    {
+      if (this->pendingDependencies[successor].fetch_sub(1) == 1)
+        this->schedule(successor);
+    }
+
+    this->remainingTasks.fetch_sub(1);
+  }
+
+  // The critical path is the longest chain of dependent tasks, weighted by the
+  // time each task took to execute.
+  void
+  TaskGraph::computeCriticalPath()
+  {
+    this->criticalPath.clear();
+    this->criticalPathTime = 0.0f;
+
+    if (this->tasks.empty())
+      return;
+
+    std::vector<float> finishTimes(this->tasks.size(), 0.0f);
+    std::vector<int> previous(this->tasks.size(), -1);
+    for (auto current : this->topologicalOrder)
+    {
+      finishTimes[current] += this->timings[current].duration;
+
+      for (auto successor : this->tasks[current].successors)
+      {
+        if (finishTimes[current] > finishTimes[successor])
+        {
+          finishTimes[successor] = finishTimes[current];
+          previous[successor] = current;
+        }
+      }
+    }
+
+    int last = std::max_element(finishTimes.begin(), finishTimes.end()) - finishTimes.begin();
+    this->criticalPathTime = finishTimes[last];
+
+    for (int current = last; current >= 0; current = previous[current])
+    {
+      this->timings[current].onCriticalPath = true;
+      this->criticalPath.push_back(this->tasks[current].name);
+    }
+    std::reverse(this->criticalPath.begin(), this->criticalPath.end());
+  }
+}
@@ -2,46 +2,110 @@
 
 namespace Strontium
 {
+  // Index of the pool worker running on this thread, -1 for threads outside of
+  // the pool (the main thread).
+  static thread_local int localWorkerIndex = -1;
+
+  //----------------------------------------------------------------------------
+  // Type erased jobs.
+  //----------------------------------------------------------------------------
+  Job::Job(Job&& other)
+    : invokeFunc(other.invokeFunc)
+    , manageFunc(other.manageFunc)
+    , counter(other.counter)
+  {
+    if (this->manageFunc)
+      this->manageFunc(ManageOp::Move, this->storage, other.storage);
+
+    other.invokeFunc = nullptr;
+    other.manageFunc = nullptr;
+    other.counter = nullptr;
+  }
+
+  Job&
+  Job::operator=(Job&& other)
+  {
+    if (this == &other)
+      return *this;
+
+    this->release();
+
+    this->invokeFunc = other.invokeFunc;
+    this->manageFunc = other.manageFunc;
+    this->counter = other.counter;
+    if (this->manageFunc)
+      this->manageFunc(ManageOp::Move, this->storage, other.storage);
+
+    other.invokeFunc = nullptr;
+    other.manageFunc = nullptr;
+    other.counter = nullptr;
+
+    return *this;
+  }
+
+  Job::~Job()
+  {
+    this->release();
+  }
+
+  void
+  Job::operator()()
+  {
+    if (!this->invokeFunc)
+      return;
+
+    this->invokeFunc(this->storage);
+
+    // Release the callable before signaling, anything it captured by reference
+    // may go out of scope as soon as the counter hits zero.
+    JobCounter* jobCounter = this->counter;
+    this->release();
+
+    if (jobCounter)
+      jobCounter->decrement();
+  }
+
+  void
+  Job::release()
+  {
+    if (this->manageFunc)
+      this->manageFunc(ManageOp::Destroy, this->storage, nullptr);
+
+    this->invokeFunc = nullptr;
+    this->manageFunc = nullptr;
+    this->counter = nullptr;
+  }
+
   //----------------------------------------------------------------------------
   // Singleton thread pool.
   //----------------------------------------------------------------------------
   ThreadPool* ThreadPool::instance = nullptr;
 
   ThreadPool::ThreadPool(unsigned int numThreads)
+    : nextQueue(0)
+    , pendingBackgroundJobs(0)
+    , runningBackgroundJobs(0)
+    , maxBackgroundJobs(numThreads > 1 ? numThreads - 1 : 1)
+    , pendingJobs(0)
+    , sleepingWorkers(0)
   {
     this->isActive.store(true);
 
-    auto workerFunction = [](ThreadPool* parentPool)
-    {
-      while (true)
-      {
-        std::unique_lock<std::mutex> taskLock(parentPool->taskMutex);
-        parentPool->signal.wait(taskLock, [parentPool]()
-        {
-          return !parentPool->tasks.empty() || !parentPool->isActive.load(std::memory_order_relaxed);
-        });
-
-        if (!parentPool->isActive.load(std::memory_order_relaxed))
-          break;
-
-        (*parentPool->tasks.front()).execute();
-        parentPool->tasks.pop();
-      }
-    };
+    this->queues.reserve(numThreads);
+    for (unsigned int i = 0; i < numThreads; i++)
+      this->queues.emplace_back(createUnique<WorkQueue>());
 
     this->workers.reserve(numThreads);
-
     for (unsigned int i = 0; i < numThreads; i++)
-    {
-      this->workers.emplace_back(workerFunction, this);
-      this->workers.back().detach();
-    }
+      this->workers.emplace_back(&ThreadPool::workerLoop, this, i);
   }
 
   ThreadPool::~ThreadPool()
   {
-    this->isActive.store(false, std::memory_order_relaxed);
-
+    {
+      std::lock_guard<std::mutex> sleepLock(this->sleepMutex);
+      this->isActive.store(false);
+    }
     this->signal.notify_all();
 
     for (auto& worker : this->workers)
@@ -50,7 +114,8 @@ namespace Strontium
         worker.join();
     }
 
-    std::unique_lock<std::mutex> taskLock(this->taskMutex);
+    if (instance == this)
+      instance = nullptr;
   }
 
   ThreadPool*
@@ -58,10 +123,250 @@ namespace Strontium
   {
     if (instance == nullptr)
     {
+      if (numThreads == 0)
+      {
+        // Leave a core free for the main thread.
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        numThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+      }
+
       instance = new ThreadPool(numThreads);
       return instance;
     }
     else
       return instance;
   }
+
+  bool
+  ThreadPool::isWorkerThread() const
+  {
+    return localWorkerIndex >= 0;
+  }
+
+  void
+  ThreadPool::wait(const JobCounter &counter)
+  {
+    while (!counter.isDone())
+    {
+      Job job;
+      if (this->tryGetJob(localWorkerIndex, job))
+        job();
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  void
+  ThreadPool::wait(const JobFence &fence)
+  {
+    while (!fence.isSignaled())
+    {
+      Job job;
+      if (this->tryGetJob(localWorkerIndex, job))
+        job();
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  bool
+  ThreadPool::tryExecuteJob(const JobCounter &counter)
+  {
+    Job job;
+    for (auto& queue : this->queues)
+    {
+      if (this->tryTakeCounted(*queue, counter, job))
+      {
+        job();
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void
+  ThreadPool::submit(Job &&job)
+  {
+    // Workers push onto their own queue, other threads round robin the jobs
+    // across the workers.
+    uint numQueues = this->queues.size();
+    uint startQueue = localWorkerIndex >= 0
+      ? static_cast<uint>(localWorkerIndex)
+      : this->nextQueue.fetch_add(1, std::memory_order_relaxed) % numQueues;
+
+    for (uint i = 0; i < numQueues; i++)
+    {
+      WorkQueue &queue = *this->queues[(startQueue + i) % numQueues];
+
+      std::unique_lock<std::mutex> queueLock(queue.queueMutex);
+      if (queue.bottom - queue.top >= MAX_JOBS_PER_WORKER)
+        continue;
+
+      queue.jobs[queue.bottom % MAX_JOBS_PER_WORKER] = std::move(job);
+      queue.bottom++;
+      this->pendingJobs.fetch_add(1);
+      queueLock.unlock();
+
+      // Only take the sleep lock when there's someone to wake up.
+      if (this->sleepingWorkers.load() > 0)
+      {
+        std::lock_guard<std::mutex> sleepLock(this->sleepMutex);
+        this->signal.notify_one();
+      }
+      return;
+    }
+
+    // Every queue is full, execute the job here rather than blocking.
+    job();
+  }
+
+  void
+  ThreadPool::submitBackground(Job &&job)
+  {
+    {
+      std::lock_guard<std::mutex> backgroundLock(this->backgroundMutex);
+      this->backgroundJobs.push(std::move(job));
+      this->pendingBackgroundJobs.fetch_add(1);
+    }
+
+    if (this->sleepingWorkers.load() > 0)
+    {
+      std::lock_guard<std::mutex> sleepLock(this->sleepMutex);
+      this->signal.notify_one();
+    }
+  }
+
+  bool
+  ThreadPool::tryGetJob(int workerIndex, Job &outJob)
+  {
+    uint numQueues = this->queues.size();
+
+    if (workerIndex >= 0 && this->tryPopBottom(*this->queues[workerIndex], outJob))
+      return true;
+
+    // Nothing local, steal from the other workers starting with the next one
+    // over to spread out the contention.
+    uint startQueue = workerIndex >= 0 ? static_cast<uint>(workerIndex) + 1 : 0;
+    for (uint i = 0; i < numQueues; i++)
+    {
+      uint victim = (startQueue + i) % numQueues;
+      if (static_cast<int>(victim) == workerIndex)
+        continue;
+
+      if (this->tryStealTop(*this->queues[victim], outJob))
+        return true;
+    }
+
+    return false;
+  }
+
+  bool
+  ThreadPool::tryGetBackgroundJob(Job &outJob)
+  {
+    std::lock_guard<std::mutex> backgroundLock(this->backgroundMutex);
+    if (this->backgroundJobs.empty() || this->runningBackgroundJobs.load() >= this->maxBackgroundJobs)
+      return false;
+
+    outJob = std::move(this->backgroundJobs.front());
+    this->backgroundJobs.pop();
+    this->pendingBackgroundJobs.fetch_sub(1);
+    this->runningBackgroundJobs.fetch_add(1);
+
+    return true;
+  }
+
+  bool
+  ThreadPool::tryPopBottom(WorkQueue &queue, Job &outJob)
+  {
+    std::lock_guard<std::mutex> queueLock(queue.queueMutex);
+    if (queue.bottom == queue.top)
+      return false;
+
+    queue.bottom--;
+    outJob = std::move(queue.jobs[queue.bottom % MAX_JOBS_PER_WORKER]);
+    this->pendingJobs.fetch_sub(1);
+
+    return true;
+  }
+
+  bool
+  ThreadPool::tryStealTop(WorkQueue &queue, Job &outJob)
+  {
+    std::lock_guard<std::mutex> queueLock(queue.queueMutex);
+    if (queue.bottom == queue.top)
+      return false;
+
+    outJob = std::move(queue.jobs[queue.top % MAX_JOBS_PER_WORKER]);
+    queue.top++;
+    this->pendingJobs.fetch_sub(1);
+
+    return true;
+  }
+
+  bool
+  ThreadPool::tryTakeCounted(WorkQueue &queue, const JobCounter &counter, Job &outJob)
+  {
+    std::lock_guard<std::mutex> queueLock(queue.queueMutex);
+    if (queue.bottom == queue.top)
+      return false;
+
+    // Only the ends can be taken without leaving a hole in the queue.
+    if (queue.jobs[queue.top % MAX_JOBS_PER_WORKER].belongsTo(counter))
+    {
+      outJob = std::move(queue.jobs[queue.top % MAX_JOBS_PER_WORKER]);
+      queue.top++;
+    }
+    else if (queue.jobs[(queue.bottom - 1) % MAX_JOBS_PER_WORKER].belongsTo(counter))
+    {
+      queue.bottom--;
+      outJob = std::move(queue.jobs[queue.bottom % MAX_JOBS_PER_WORKER]);
+    }
+    else
+      return false;
+
+    this->pendingJobs.fetch_sub(1);
+    return true;
+  }
+
+  void
+  ThreadPool::workerLoop(uint workerIndex)
+  {
+    localWorkerIndex = static_cast<int>(workerIndex);
+
+    while (true)
+    {
+      Job job;
+      if (this->tryGetJob(localWorkerIndex, job))
+      {
+        job();
+        continue;
+      }
+
+      // Frame jobs come first, background jobs only run on idle workers.
+      if (this->tryGetBackgroundJob(job))
+      {
+        job();
+
+        std::lock_guard<std::mutex> backgroundLock(this->backgroundMutex);
+        this->runningBackgroundJobs.fetch_sub(1);
+        continue;
+      }
+
+      // Nothing to do, sleep until a job gets pushed. Background jobs held
+      // back by the limit are picked up by the workers finishing one.
+      std::unique_lock<std::mutex> sleepLock(this->sleepMutex);
+      this->sleepingWorkers.fetch_add(1);
+      this->signal.wait(sleepLock, [this]()
+      {
+        return this->pendingJobs.load() > 0 || !this->isActive.load()
+               || (this->pendingBackgroundJobs.load() > 0
+                   && this->runningBackgroundJobs.load() < this->maxBackgroundJobs);
+      });
+      this->sleepingWorkers.fetch_sub(1);
+
+      if (!this->isActive.load())
+        break;
+    }
+  }
 }
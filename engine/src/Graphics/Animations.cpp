@@ -9,19 +9,88 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+// SIMD includes. SSE2 is the baseline on x64.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define ANIMATION_USE_SSE
+  #include <immintrin.h>
+#endif
+
 namespace Strontium
 {
+  //----------------------------------------------------------------------------
+  // Skeleton here.
+  //----------------------------------------------------------------------------
+  void
+  Skeleton::build(Model &model)
+  {
+    this->nodeNames.clear();
+    this->parents.clear();
+    this->depths.clear();
+    this->bindTransforms.clear();
+    this->boneSlots.clear();
+    this->nodeIndices.clear();
+
+    this->globalInverseTransform = model.getGlobalInverseTransform();
+
+    auto& bones = model.getBones();
+    auto& boneMap = model.getBoneMap();
+    auto& sceneNodes = model.getSceneNodes();
+
+    this->numBones = bones.size();
+    this->maxDepth = 0;
+    this->boneOffsets.resize(this->numBones);
+    for (uint i = 0; i < this->numBones; i++)
+      this->boneOffsets[i] = bones[i].offsetMatrix;
+
+    // Depth first traversal, which visits parents before their children.
+    std::stack<std::pair<std::string, int>> toVisit;
+    toVisit.emplace(model.getRootNode().name, -1);
+    while (!toVisit.empty())
+    {
+      auto [nodeName, parent] = toVisit.top();
+      toVisit.pop();
+
+      auto sceneNode = sceneNodes.find(nodeName);
+      if (sceneNode == sceneNodes.end() || this->nodeIndices.count(nodeName) > 0)
+        continue;
+
+      uint index = this->parents.size();
+      this->nodeIndices.emplace(nodeName, index);
+      this->nodeNames.emplace_back(nodeName);
+      this->parents.emplace_back(parent);
+      this->depths.emplace_back(parent >= 0 ? this->depths[parent] + 1 : 0);
+      this->maxDepth = std::max(this->maxDepth, this->depths.back());
+      this->bindTransforms.emplace_back(sceneNode->second.localTransform);
+
+      auto bone = boneMap.find(nodeName);
+      this->boneSlots.emplace_back(bone != boneMap.end() ? static_cast<int>(bone->second) : -1);
+
+      auto& children = sceneNode->second.childNames;
+      for (auto child = children.rbegin(); child != children.rend(); child++)
+        toVisit.emplace(*child, index);
+    }
+  }
+
+  int
+  Skeleton::findNode(const std::string &nodeName) const
+  {
+    auto node = this->nodeIndices.find(nodeName);
+    return node != this->nodeIndices.end() ? static_cast<int>(node->second) : -1;
+  }
+
   //----------------------------------------------------------------------------
   // Animation class.
   //----------------------------------------------------------------------------
   Animation::Animation(const aiAnimation* animation, Model* parentModel)
     : parentModel(parentModel)
+    , rawKeyframeMemory(0)
   {
     this->loadAnimation(animation);
   }
 
   Animation::Animation(Model* parentModel)
     : parentModel(parentModel)
+    , rawKeyframeMemory(0)
   { }
 
   Animation::~Animation()
@@ -68,124 +137,542 @@ namespace Strontium
         }
       }
     }
+
+    this->compileTracks();
   }
 
-  void
-  Animation::computeBoneTransforms(float aniTime, std::vector<glm::mat4>& outBones)
+  //----------------------------------------------------------------------------
+  // Keyframe compression here.
+  //----------------------------------------------------------------------------
+  // Range of the three smallest components of a unit quaternion.
+  static constexpr float smallestThreeRange = 0.70710678f;
+
+  static QuantizedVec3
+  quantizeVec3(const glm::vec3 &value, const glm::vec3 &min, const glm::vec3 &extent)
   {
-    outBones.clear();
-    outBones.resize(this->parentModel->getBones().size(), glm::mat4(1.0f));
-    this->readNodeHierarchy(aniTime, this->parentModel->getRootNode(), glm::mat4(1.0f), outBones);
+    auto quantize = [](float v, float lower, float range) -> uint16_t
+    {
+      if (range <= 0.0f)
+        return 0;
+      return static_cast<uint16_t>(std::round(glm::clamp((v - lower) / range, 0.0f, 1.0f) * 65535.0f));
+    };
+
+    return { quantize(value.x, min.x, extent.x), quantize(value.y, min.y, extent.y),
+             quantize(value.z, min.z, extent.z) };
   }
 
-  void
-  Animation::readNodeHierarchy(float aniTime, const SceneNode &node,
-                               const glm::mat4 parentTransform,
-                               std::vector<glm::mat4> &outBones)
+  static inline glm::vec3
+  dequantizeVec3(const QuantizedVec3 &value, const glm::vec3 &min, const glm::vec3 &extent)
   {
-    auto nodeName = node.name;
-    auto nodeTransform = node.localTransform;
+    return min + extent * (glm::vec3(value.x, value.y, value.z) / 65535.0f);
+  }
+
+  static QuantizedQuat
+  quantizeQuat(const glm::quat &rotation)
+  {
+    glm::quat q = glm::normalize(rotation);
+    float components[4] = { q.x, q.y, q.z, q.w };
+
+    uint largest = 0;
+    for (uint i = 1; i < 4; i++)
+      if (std::abs(components[i]) > std::abs(components[largest]))
+        largest = i;
+
+    // q and -q are the same rotation, flip so the dropped component is
+    // positive.
+    float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
 
-    if (this->animationNodes.find(nodeName) != this->animationNodes.end())
+    uint64_t bits = static_cast<uint64_t>(largest) << 45;
+    uint shift = 30;
+    for (uint i = 0; i < 4; i++)
     {
-      auto aniNode = this->animationNodes[nodeName];
-      glm::mat4 translation = this->interpolateTranslation(aniTime, aniNode);
-      glm::mat4 rotation = this->interpolateRotation(aniTime, aniNode);
-      glm::mat4 scale = this->interpolateScale(aniTime, aniNode);
+      if (i == largest)
+        continue;
 
-      nodeTransform = translation * rotation * scale;
+      float normalized = (sign * components[i] + smallestThreeRange) / (2.0f * smallestThreeRange);
+      uint64_t quantized = static_cast<uint64_t>(std::round(glm::clamp(normalized, 0.0f, 1.0f) * 32767.0f));
+      bits |= quantized << shift;
+      shift -= 15;
     }
 
-    auto globalTransform = parentTransform * nodeTransform;
+    QuantizedQuat outQuat;
+    outQuat.data[0] = static_cast<uint16_t>(bits >> 32);
+    outQuat.data[1] = static_cast<uint16_t>(bits >> 16);
+    outQuat.data[2] = static_cast<uint16_t>(bits);
+    return outQuat;
+  }
 
-    auto& boneMap = this->parentModel->getBoneMap();
-    if (boneMap.find(nodeName) != boneMap.end())
+  static inline glm::quat
+  dequantizeQuat(const QuantizedQuat &rotation)
+  {
+    uint64_t bits = (static_cast<uint64_t>(rotation.data[0]) << 32)
+                    | (static_cast<uint64_t>(rotation.data[1]) << 16)
+                    | static_cast<uint64_t>(rotation.data[2]);
+    uint largest = static_cast<uint>(bits >> 45) & 3u;
+
+    float components[4];
+    float sumSquares = 0.0f;
+    uint shift = 30;
+    for (uint i = 0; i < 4; i++)
     {
-      auto& modelBones = this->parentModel->getBones();
-      unsigned int index = boneMap[nodeName];
-      auto boneOffset = this->parentModel->getBones()[index].offsetMatrix;
-      outBones[index] = this->parentModel->getGlobalInverseTransform() * globalTransform * boneOffset;
+      if (i == largest)
+        continue;
+
+      float normalized = static_cast<float>((bits >> shift) & 0x7FFFu) / 32767.0f;
+      components[i] = normalized * 2.0f * smallestThreeRange - smallestThreeRange;
+      sumSquares += components[i] * components[i];
+      shift -= 15;
     }
+    components[largest] = std::sqrt(std::max(1.0f - sumSquares, 0.0f));
 
-    auto& sceneNodes = this->parentModel->getSceneNodes();
-    for (auto& childNodeName : node.childNames)
-      this->readNodeHierarchy(aniTime, sceneNodes[childNodeName], globalTransform, outBones);
+    return glm::quat(components[3], components[0], components[1], components[2]);
   }
 
-  glm::mat4
-  Animation::interpolateTranslation(float aniTime, const AnimationNode &node)
+  // Greedily remove keys which can be rebuilt within maxError by
+  // interpolating the keys around them. The stored values are the keys as
+  // they decode once stored, the rebuilt values are interpolated from those
+  // and compared to the source keys. That only bounds the removed keys, the
+  // kept keys are off by the storage error alone, which the caller has to
+  // keep within maxError. Returns the indices of the kept keys.
+  template <typename Value, typename InterpolateFunc, typename ErrorFunc>
+  static std::vector<uint>
+  reduceKeys(const std::vector<std::pair<float, Value>> &keys,
+             const std::vector<Value> &stored, float maxError,
+             InterpolateFunc interpolate, ErrorFunc error)
   {
-    if (node.keyTranslations.size() == 1)
-      return glm::translate(glm::mat4(1.0f), node.keyTranslations[0].second);
-
-    unsigned int currentIndex = 0;
-    for (unsigned int i = 0; i < node.keyTranslations.size() - 1; i++)
+    std::vector<uint> kept;
+    kept.emplace_back(0);
+
+    uint numKeys = keys.size();
+    if (numKeys == 1)
+      return kept;
+
+    // Constant channels collapse to a single key.
+    bool constant = true;
+    for (uint i = 1; i < numKeys && constant; i++)
+      constant = error(stored[0], keys[i].second) <= maxError;
+    if (constant)
+      return kept;
+
+    uint anchor = 0;
+    for (uint end = 2; end < numKeys; end++)
     {
-    bool animating;
-      if (aniTime < node.keyTranslations[i + 1].first)
+      bool removable = end - anchor <= ANIMATION_MAX_KEY_SPAN;
+      float span = keys[end].first - keys[anchor].first;
+      for (uint i = anchor + 1; i < end && removable; i++)
       {
-        currentIndex = i;
-        break;
+        float factor = span > 0.0f ? (keys[i].first - keys[anchor].first) / span : 0.0f;
+        Value rebuilt = interpolate(stored[anchor], stored[end], factor);
+        removable = error(rebuilt, keys[i].second) <= maxError;
       }
+
+      // The key before the end is needed to rebuild the run.
+      if (!removable)
+      {
+        anchor = end - 1;
+        kept.emplace_back(anchor);
+      }
+    }
+    kept.emplace_back(numKeys - 1);
+
+    return kept;
+  }
+
+  // The range is taken over every key, the kept keys don't change it and the
+  // keys can be quantized before deciding which to keep.
+  static void
+  computeRange(const std::vector<std::pair<float, glm::vec3>> &keys,
+               glm::vec3 &outMin, glm::vec3 &outExtent)
+  {
+    glm::vec3 max = keys[0].second;
+    outMin = max;
+    for (auto& key : keys)
+    {
+      outMin = glm::min(outMin, key.second);
+      max = glm::max(max, key.second);
+    }
+    outExtent = max - outMin;
+  }
+
+  // Quantizing rounds each component by up to half a step of its range, a
+  // channel is only quantized if that leaves at least half of maxError for
+  // the keys removed by interpolation. Wider channels, long root motion for
+  // one, keep full precision keys.
+  static bool
+  fitsQuantization(const glm::vec3 &extent, float maxError)
+  {
+    return glm::length(extent) / 131070.0f <= 0.5f * maxError;
+  }
+
+  // The values the keys decode to once stored.
+  static void
+  storedValues(const std::vector<std::pair<float, glm::vec3>> &keys, const glm::vec3 &min,
+               const glm::vec3 &extent, bool quantized, std::vector<glm::vec3> &outValues)
+  {
+    outValues.clear();
+    for (auto& key : keys)
+    {
+      outValues.emplace_back(quantized ? dequantizeVec3(quantizeVec3(key.second, min, extent), min, extent)
+                                       : key.second);
     }
-    unsigned int nextIndex = currentIndex + 1;
+  }
 
-    float dt = node.keyTranslations[nextIndex].first - node.keyTranslations[currentIndex].first;
-    float normalized = (aniTime - node.keyTranslations[currentIndex].first) / dt;
-    auto translation = glm::mix(node.keyTranslations[currentIndex].second,
-                                node.keyTranslations[nextIndex].second,
-                                normalized);
-    return glm::translate(glm::mat4(1.0f), translation);
+  // The smallest three step is far below the rotation error bound, rotations
+  // are always quantized.
+  static void
+  storedValues(const std::vector<std::pair<float, glm::quat>> &keys,
+               std::vector<glm::quat> &outValues)
+  {
+    outValues.clear();
+    for (auto& key : keys)
+      outValues.emplace_back(dequantizeQuat(quantizeQuat(key.second)));
   }
 
-  glm::mat4
-  Animation::interpolateRotation(float aniTime, const AnimationNode &node)
+  void
+  Animation::compileTracks()
   {
-    if (node.keyRotations.size() == 1)
-      return glm::toMat4(node.keyRotations[0].second);
+    auto& skeleton = this->parentModel->getSkeleton();
+
+    this->tracks.clear();
+    this->translationTimes.clear();
+    this->translationKeys.clear();
+    this->rotationTimes.clear();
+    this->rotationKeys.clear();
+    this->scaleTimes.clear();
+    this->scaleKeys.clear();
+    this->fullTranslationKeys.clear();
+    this->fullScaleKeys.clear();
+    this->nodeTracks.assign(skeleton.getNumNodes(), -1);
+
+    auto lerpVec3 = [](const glm::vec3 &a, const glm::vec3 &b, float factor)
+    {
+      return glm::mix(a, b, factor);
+    };
+    auto vec3Error = [](const glm::vec3 &a, const glm::vec3 &b)
+    {
+      return glm::length(a - b);
+    };
+    auto slerpQuat = [](const glm::quat &a, const glm::quat &b, float factor)
+    {
+      return glm::normalize(glm::slerp(a, b, factor));
+    };
+    auto quatError = [](const glm::quat &a, const glm::quat &b)
+    {
+      float cosHalfAngle = glm::min(std::abs(glm::dot(glm::normalize(a), glm::normalize(b))), 1.0f);
+      return 2.0f * std::acos(cosHalfAngle);
+    };
+
+    std::vector<glm::vec3> storedVec3s;
+    std::vector<glm::quat> storedQuats;
 
-    unsigned int currentIndex = 0;
-    for (unsigned int i = 0; i < node.keyRotations.size() - 1; i++)
+    this->rawKeyframeMemory = 0;
+    for (auto& [nodeName, node] : this->animationNodes)
     {
-      if (aniTime < node.keyRotations[i + 1].first)
+      this->rawKeyframeMemory += node.keyTranslations.size() * sizeof(std::pair<float, glm::vec3>)
+                                 + node.keyRotations.size() * sizeof(std::pair<float, glm::quat>)
+                                 + node.keyScales.size() * sizeof(std::pair<float, glm::vec3>);
+    }
+
+    // Walk the skeleton so tracks end up in the same parent-first order as the
+    // nodes they animate.
+    for (uint i = 0; i < skeleton.getNumNodes(); i++)
+    {
+      auto aniNode = this->animationNodes.find(skeleton.nodeNames[i]);
+      if (aniNode == this->animationNodes.end())
+        continue;
+
+      auto& node = aniNode->second;
+      if (node.keyTranslations.empty() || node.keyRotations.empty() || node.keyScales.empty())
+        continue;
+
+      AnimationTrack track;
+      track.node = i;
+
+      computeRange(node.keyTranslations, track.translationMin, track.translationExtent);
+      track.quantizedTranslations = fitsQuantization(track.translationExtent,
+                                                     ANIMATION_TRANSLATION_ERROR);
+      storedValues(node.keyTranslations, track.translationMin, track.translationExtent,
+                   track.quantizedTranslations, storedVec3s);
+      auto keptTranslations = reduceKeys(node.keyTranslations, storedVec3s,
+                                         ANIMATION_TRANSLATION_ERROR, lerpVec3, vec3Error);
+      track.translationStart = this->translationTimes.size();
+      track.numTranslations = keptTranslations.size();
+      track.translationKeyStart = track.quantizedTranslations ? this->translationKeys.size()
+                                                              : this->fullTranslationKeys.size();
+      for (uint index : keptTranslations)
       {
-        currentIndex = i;
-        break;
+        this->translationTimes.emplace_back(node.keyTranslations[index].first);
+        if (track.quantizedTranslations)
+        {
+          this->translationKeys.emplace_back(quantizeVec3(node.keyTranslations[index].second,
+                                                          track.translationMin,
+                                                          track.translationExtent));
+        }
+        else
+          this->fullTranslationKeys.emplace_back(node.keyTranslations[index].second);
       }
+
+      storedValues(node.keyRotations, storedQuats);
+      auto keptRotations = reduceKeys(node.keyRotations, storedQuats,
+                                      ANIMATION_ROTATION_ERROR, slerpQuat, quatError);
+      track.rotationStart = this->rotationTimes.size();
+      track.numRotations = keptRotations.size();
+      for (uint index : keptRotations)
+      {
+        this->rotationTimes.emplace_back(node.keyRotations[index].first);
+        this->rotationKeys.emplace_back(quantizeQuat(node.keyRotations[index].second));
+      }
+
+      computeRange(node.keyScales, track.scaleMin, track.scaleExtent);
+      track.quantizedScales = fitsQuantization(track.scaleExtent, ANIMATION_SCALE_ERROR);
+      storedValues(node.keyScales, track.scaleMin, track.scaleExtent, track.quantizedScales,
+                   storedVec3s);
+      auto keptScales = reduceKeys(node.keyScales, storedVec3s, ANIMATION_SCALE_ERROR,
+                                   lerpVec3, vec3Error);
+      track.scaleStart = this->scaleTimes.size();
+      track.numScales = keptScales.size();
+      track.scaleKeyStart = track.quantizedScales ? this->scaleKeys.size()
+                                                  : this->fullScaleKeys.size();
+      for (uint index : keptScales)
+      {
+        this->scaleTimes.emplace_back(node.keyScales[index].first);
+        if (track.quantizedScales)
+        {
+          this->scaleKeys.emplace_back(quantizeVec3(node.keyScales[index].second,
+                                                    track.scaleMin, track.scaleExtent));
+        }
+        else
+          this->fullScaleKeys.emplace_back(node.keyScales[index].second);
+      }
+
+      this->nodeTracks[i] = this->tracks.size();
+      this->tracks.emplace_back(track);
+    }
+
+    // Release the raw keys, they can be decoded on demand for inspection.
+    for (auto& [nodeName, node] : this->animationNodes)
+    {
+      std::vector<std::pair<float, glm::vec3>>().swap(node.keyTranslations);
+      std::vector<std::pair<float, glm::quat>>().swap(node.keyRotations);
+      std::vector<std::pair<float, glm::vec3>>().swap(node.keyScales);
+    }
+
+    this->translationTimes.shrink_to_fit();
+    this->translationKeys.shrink_to_fit();
+    this->rotationTimes.shrink_to_fit();
+    this->rotationKeys.shrink_to_fit();
+    this->scaleTimes.shrink_to_fit();
+    this->scaleKeys.shrink_to_fit();
+    this->fullTranslationKeys.shrink_to_fit();
+    this->fullScaleKeys.shrink_to_fit();
+  }
+
+  // Key i of a translation or scale channel, from whichever keys the channel
+  // is stored in.
+  static inline glm::vec3
+  vec3Key(const std::vector<QuantizedVec3> &keys, const std::vector<glm::vec3> &fullKeys,
+          bool quantized, uint keyStart, uint i, const glm::vec3 &min, const glm::vec3 &extent)
+  {
+    return quantized ? dequantizeVec3(keys[keyStart + i], min, extent) : fullKeys[keyStart + i];
+  }
+
+  void
+  Animation::decodeNodeKeys(AnimationNode &node) const
+  {
+    if (!node.keyTranslations.empty())
+      return;
+
+    auto& skeleton = this->parentModel->getSkeleton();
+    int nodeIndex = skeleton.findNode(node.name);
+    if (nodeIndex < 0 || nodeIndex >= static_cast<int>(this->nodeTracks.size())
+        || this->nodeTracks[nodeIndex] < 0)
+      return;
+
+    auto& track = this->tracks[this->nodeTracks[nodeIndex]];
+    for (uint i = 0; i < track.numTranslations; i++)
+    {
+      node.keyTranslations.emplace_back(this->translationTimes[track.translationStart + i],
+                                        vec3Key(this->translationKeys, this->fullTranslationKeys,
+                                                track.quantizedTranslations, track.translationKeyStart,
+                                                i, track.translationMin, track.translationExtent));
     }
-    unsigned int nextIndex = currentIndex + 1;
+    for (uint i = 0; i < track.numRotations; i++)
+    {
+      uint key = track.rotationStart + i;
+      node.keyRotations.emplace_back(this->rotationTimes[key], dequantizeQuat(this->rotationKeys[key]));
+    }
+    for (uint i = 0; i < track.numScales; i++)
+    {
+      node.keyScales.emplace_back(this->scaleTimes[track.scaleStart + i],
+                                  vec3Key(this->scaleKeys, this->fullScaleKeys, track.quantizedScales,
+                                          track.scaleKeyStart, i, track.scaleMin, track.scaleExtent));
+    }
+  }
 
-    float dt = node.keyRotations[nextIndex].first - node.keyRotations[currentIndex].first;
-    float normalized = (aniTime - node.keyRotations[currentIndex].first) / dt;
-    auto rotation = glm::normalize(glm::slerp(node.keyRotations[currentIndex].second,
-                                              node.keyRotations[nextIndex].second,
-                                              normalized));
-    return glm::toMat4(rotation);
+  uint
+  Animation::getKeyframeMemory() const
+  {
+    return this->tracks.size() * sizeof(AnimationTrack)
+           + (this->translationTimes.size() + this->rotationTimes.size()
+              + this->scaleTimes.size()) * sizeof(float)
+           + (this->translationKeys.size() + this->scaleKeys.size()) * sizeof(QuantizedVec3)
+           + (this->fullTranslationKeys.size() + this->fullScaleKeys.size()) * sizeof(glm::vec3)
+           + this->rotationKeys.size() * sizeof(QuantizedQuat);
+  }
+
+  // Move a key cursor so it points at the last key at or before aniTime.
+  // Cursors only move forward, unless the time wrapped around.
+  static inline uint
+  advanceCursor(const float* times, uint numKeys, float aniTime, uint cursor)
+  {
+    if (cursor >= numKeys || aniTime < times[cursor])
+      cursor = 0;
+
+    while (cursor + 1 < numKeys && aniTime >= times[cursor + 1])
+      cursor++;
+
+    return cursor;
   }
 
-  glm::mat4
-  Animation::interpolateScale(float aniTime, const AnimationNode &node)
+  // Interpolation factor between the key at the cursor and the next one.
+  // Clamps to the first and last keys.
+  static inline float
+  keyFactor(const float* times, uint numKeys, float aniTime, uint cursor)
   {
-    if (node.keyScales.size() == 1)
-      return glm::scale(glm::mat4(1.0f), node.keyScales[0].second);
+    if (cursor + 1 >= numKeys)
+      return 0.0f;
+
+    float dt = times[cursor + 1] - times[cursor];
+    if (dt <= 0.0f)
+      return 0.0f;
 
-    unsigned int currentIndex = 0;
-    for (unsigned int i = 0; i < node.keyScales.size() - 1; i++)
+    return glm::clamp((aniTime - times[cursor]) / dt, 0.0f, 1.0f);
+  }
+
+  // out = lhs * rhs. Each column of the result is a linear combination of the
+  // columns of lhs, which maps directly onto four wide multiply-adds. Safe if
+  // out aliases either of the inputs.
+  static inline void
+  multiplyTransforms(const glm::mat4 &lhs, const glm::mat4 &rhs, glm::mat4 &out)
+  {
+  #if defined(ANIMATION_USE_SSE)
+    __m128 lhs0 = _mm_loadu_ps(&lhs[0][0]);
+    __m128 lhs1 = _mm_loadu_ps(&lhs[1][0]);
+    __m128 lhs2 = _mm_loadu_ps(&lhs[2][0]);
+    __m128 lhs3 = _mm_loadu_ps(&lhs[3][0]);
+
+    __m128 columns[4];
+    for (uint c = 0; c < 4; c++)
     {
-      if (aniTime < node.keyScales[i + 1].first)
+      columns[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lhs0, _mm_set1_ps(rhs[c][0])),
+                                         _mm_mul_ps(lhs1, _mm_set1_ps(rhs[c][1]))),
+                              _mm_add_ps(_mm_mul_ps(lhs2, _mm_set1_ps(rhs[c][2])),
+                                         _mm_mul_ps(lhs3, _mm_set1_ps(rhs[c][3]))));
+    }
+
+    for (uint c = 0; c < 4; c++)
+      _mm_storeu_ps(&out[c][0], columns[c]);
+  #else
+    out = lhs * rhs;
+  #endif
+  }
+
+  const Skeleton&
+  Animation::getSkeleton() const
+  {
+    return this->parentModel->getSkeleton();
+  }
+
+  void
+  Animation::computeBoneTransforms(float aniTime, AnimationPlayback &playback,
+                                   std::vector<glm::mat4> &outBones, uint maxDepth) const
+  {
+    auto& skeleton = this->parentModel->getSkeleton();
+    uint numNodes = skeleton.getNumNodes();
+
+    // Reset the playback state if it was last used with another animation.
+    if (playback.animation != this)
+    {
+      playback.animation = this;
+      playback.translationCursors.assign(this->tracks.size(), 0);
+      playback.rotationCursors.assign(this->tracks.size(), 0);
+      playback.scaleCursors.assign(this->tracks.size(), 0);
+      playback.globalTransforms.resize(numNodes);
+    }
+    if (outBones.size() != skeleton.numBones)
+      outBones.assign(skeleton.numBones, glm::mat4(1.0f));
+
+    // Tracks haven't been compiled against this skeleton.
+    if (this->nodeTracks.size() != numNodes)
+      return;
+
+    // The nodes are sorted parent-first, so the global transform of the parent
+    // is always ready. The global inverse is folded into the root node.
+    for (uint i = 0; i < numNodes; i++)
+    {
+      glm::mat4 local;
+
+      int trackIndex = this->nodeTracks[i];
+      if (trackIndex >= 0 && skeleton.depths[i] <= maxDepth)
       {
-        currentIndex = i;
-        break;
+        auto& track = this->tracks[trackIndex];
+
+        const float* tTimes = &this->translationTimes[track.translationStart];
+        uint tCursor = advanceCursor(tTimes, track.numTranslations, aniTime,
+                                     playback.translationCursors[trackIndex]);
+        playback.translationCursors[trackIndex] = tCursor;
+        float tFactor = keyFactor(tTimes, track.numTranslations, aniTime, tCursor);
+        uint tNext = glm::min(tCursor + 1, track.numTranslations - 1);
+        glm::vec3 translation = glm::mix(vec3Key(this->translationKeys, this->fullTranslationKeys,
+                                                 track.quantizedTranslations, track.translationKeyStart,
+                                                 tCursor, track.translationMin, track.translationExtent),
+                                         vec3Key(this->translationKeys, this->fullTranslationKeys,
+                                                 track.quantizedTranslations, track.translationKeyStart,
+                                                 tNext, track.translationMin, track.translationExtent),
+                                         tFactor);
+
+        const float* rTimes = &this->rotationTimes[track.rotationStart];
+        uint rCursor = advanceCursor(rTimes, track.numRotations, aniTime,
+                                     playback.rotationCursors[trackIndex]);
+        playback.rotationCursors[trackIndex] = rCursor;
+        float rFactor = keyFactor(rTimes, track.numRotations, aniTime, rCursor);
+        uint rNext = glm::min(rCursor + 1, track.numRotations - 1);
+        glm::quat rotation = glm::normalize(glm::slerp(dequantizeQuat(this->rotationKeys[track.rotationStart + rCursor]),
+                                                       dequantizeQuat(this->rotationKeys[track.rotationStart + rNext]),
+                                                       rFactor));
+
+        const float* sTimes = &this->scaleTimes[track.scaleStart];
+        uint sCursor = advanceCursor(sTimes, track.numScales, aniTime,
+                                     playback.scaleCursors[trackIndex]);
+        playback.scaleCursors[trackIndex] = sCursor;
+        float sFactor = keyFactor(sTimes, track.numScales, aniTime, sCursor);
+        uint sNext = glm::min(sCursor + 1, track.numScales - 1);
+        glm::vec3 scale = glm::mix(vec3Key(this->scaleKeys, this->fullScaleKeys, track.quantizedScales,
+                                           track.scaleKeyStart, sCursor, track.scaleMin, track.scaleExtent),
+                                   vec3Key(this->scaleKeys, this->fullScaleKeys, track.quantizedScales,
+                                           track.scaleKeyStart, sNext, track.scaleMin, track.scaleExtent),
+                                   sFactor);
+
+        // Translation * rotation * scale without the full matrix products.
+        local = glm::toMat4(rotation);
+        local[0] *= scale.x;
+        local[1] *= scale.y;
+        local[2] *= scale.z;
+        local[3] = glm::vec4(translation, 1.0f);
       }
+      else
+        local = skeleton.bindTransforms[i];
+
+      int parent = skeleton.parents[i];
+      const glm::mat4 &parentTransform = parent >= 0 ? playback.globalTransforms[parent]
+                                                     : skeleton.globalInverseTransform;
+      multiplyTransforms(parentTransform, local, playback.globalTransforms[i]);
+
+      int boneSlot = skeleton.boneSlots[i];
+      if (boneSlot >= 0)
+        multiplyTransforms(playback.globalTransforms[i], skeleton.boneOffsets[boneSlot],
+                           outBones[boneSlot]);
     }
-    unsigned int nextIndex = currentIndex + 1;
-
-    float dt = node.keyScales[nextIndex].first - node.keyScales[currentIndex].first;
-    float normalized = (aniTime - node.keyScales[currentIndex].first) / dt;
-    auto scale = glm::mix(node.keyScales[currentIndex].second,
-                          node.keyScales[nextIndex].second,
-                          normalized);
-    return glm::scale(glm::mat4(1.0f), scale);
   }
 
   //----------------------------------------------------------------------------
@@ -195,6 +682,12 @@ namespace Strontium
     : storedModel("")
     , storedAnimation(nullptr)
     , currentAniTime(0.0f)
+    , sampleAniTime(0.0f)
+    , evaluatedAnimation(nullptr)
+    , evaluatedSample(0)
+    , updateInterval(1)
+    , droppedBoneLevels(0)
+    , framesSinceEvaluation(0)
     , animating(false)
     , paused(true)
   { }
@@ -209,20 +702,137 @@ namespace Strontium
       this->storedModel = modelHandle;
       this->storedAnimation = animation;
       this->currentAniTime = 0.0f;
+      this->sampleAniTime = 0.0f;
+      this->evaluatedAnimation = nullptr;
     }
   }
 
   void
   Animator::onUpdate(float dt)
   {
-    if (this->storedAnimation && this->animating && !this->paused)
+    if (this->advance(dt))
+      this->evaluate();
+    this->blendPose();
+  }
+
+  bool
+  Animator::advance(float dt)
+  {
+    if (!this->storedAnimation || !this->animating)
+      return false;
+
+    float duration = this->storedAnimation->getDuration();
+    float ticks = dt * this->storedAnimation->getTPS();
+    if (!this->paused)
+      this->currentAniTime = fmod(this->currentAniTime + ticks, duration);
+
+    // Reduced rate animators sample where the clock will be at their next
+    // evaluation, and blend towards that pose in the meantime.
+    this->sampleAniTime = this->currentAniTime;
+    if (!this->paused && this->updateInterval > 1)
+      this->sampleAniTime = fmod(this->currentAniTime + ticks * (this->updateInterval - 1), duration);
+
+    this->framesSinceEvaluation++;
+
+    // A new animation always needs a pose, even if it's frozen.
+    if (this->evaluatedAnimation != this->storedAnimation)
+      return true;
+
+    if (this->updateInterval == 0 || this->framesSinceEvaluation < this->updateInterval)
+      return false;
+
+    // The time can also be scrubbed while paused, so compare samples rather
+    // than checking the paused flag.
+    return this->evaluatedSample != this->getSampleIndex();
+  }
+
+  void
+  Animator::evaluate()
+  {
+    uint sample = this->getSampleIndex();
+    float sampleTime = static_cast<float>(sample) * this->storedAnimation->getTPS()
+                       / ANIMATION_SAMPLE_RATE;
+
+    auto& skeleton = this->storedAnimation->getSkeleton();
+    uint maxDepth = skeleton.maxDepth - std::min(this->droppedBoneLevels, skeleton.maxDepth);
+
+    bool blended = this->updateInterval > 1;
+    auto& outBones = blended ? this->sampledBoneTransforms : this->finalBoneTransforms;
+    this->storedAnimation->computeBoneTransforms(sampleTime, this->playback, outBones, maxDepth);
+
+    this->evaluatedAnimation = this->storedAnimation;
+    this->evaluatedSample = sample;
+    this->framesSinceEvaluation = 0;
+
+    if (blended)
     {
-      this->currentAniTime += dt * this->storedAnimation->getTPS();
-      this->currentAniTime = fmod(this->currentAniTime, this->storedAnimation->getDuration());
+      if (this->finalBoneTransforms.size() != outBones.size())
+        this->finalBoneTransforms = outBones;
+      this->blendStartTransforms = this->finalBoneTransforms;
+    }
+  }
+
+  void
+  Animator::copyPose(const Animator &other)
+  {
+    auto& sourceBones = other.updateInterval > 1 ? other.sampledBoneTransforms
+                                                 : other.finalBoneTransforms;
 
-      this->storedAnimation->computeBoneTransforms(this->currentAniTime, this->finalBoneTransforms);
+    // Assigning between equal sized vectors doesn't reallocate.
+    if (this->updateInterval > 1)
+    {
+      this->sampledBoneTransforms = sourceBones;
+      if (this->finalBoneTransforms.size() != sourceBones.size())
+        this->finalBoneTransforms = sourceBones;
+      this->blendStartTransforms = this->finalBoneTransforms;
+    }
+    else
+      this->finalBoneTransforms = sourceBones;
+
+    this->evaluatedAnimation = other.evaluatedAnimation;
+    this->evaluatedSample = other.evaluatedSample;
+    this->framesSinceEvaluation = 0;
+  }
+
+  void
+  Animator::blendPose()
+  {
+    if (this->updateInterval <= 1 || !this->animationRenderable()
+        || this->sampledBoneTransforms.size() != this->finalBoneTransforms.size()
+        || this->blendStartTransforms.size() != this->finalBoneTransforms.size())
+      return;
+
+    float factor = std::min(static_cast<float>(this->framesSinceEvaluation + 1)
+                            / static_cast<float>(this->updateInterval), 1.0f);
+    for (uint i = 0; i < this->finalBoneTransforms.size(); i++)
+    {
+      for (uint c = 0; c < 4; c++)
+      {
+        this->finalBoneTransforms[i][c] = glm::mix(this->blendStartTransforms[i][c],
+                                                   this->sampledBoneTransforms[i][c], factor);
+      }
     }
-    else if (this->storedAnimation && this->animating && this->paused)
-      this->storedAnimation->computeBoneTransforms(this->currentAniTime, this->finalBoneTransforms);
+  }
+
+  void
+  Animator::setLOD(uint updateInterval, uint droppedBoneLevels)
+  {
+    // Evaluate right away when coming back to full rate, so the pose doesn't
+    // keep blending towards a stale sample.
+    if (updateInterval == 1 && this->updateInterval != 1)
+      this->evaluatedAnimation = nullptr;
+
+    this->updateInterval = updateInterval;
+    this->droppedBoneLevels = droppedBoneLevels;
+  }
+
+  uint
+  Animator::getSampleIndex() const
+  {
+    if (!this->storedAnimation)
+      return 0;
+
+    return static_cast<uint>(std::floor(this->sampleAniTime * ANIMATION_SAMPLE_RATE
+                                        / this->storedAnimation->getTPS()));
   }
 }
@@ -249,6 +249,18 @@ namespace Strontium
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
   }
 
+  void
+  ShaderStorageBuffer::resize(uint bufferSize, BufferType bufferType)
+  {
+    this->dataSize = bufferSize;
+    this->type = bufferType;
+    this->filled = false;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->bufferID);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bufferSize, nullptr, static_cast<GLenum>(bufferType));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+
   void
   ShaderStorageBuffer::setData(uint start, uint newDataSize,
                                const void* newData)
@@ -261,4 +273,169 @@ namespace Strontium
 
     this->filled = true;
   }
+
+  void
+  ShaderStorageBuffer::getData(uint start, uint readSize, void* outData)
+  {
+    assert(("Read exceeds buffer size.", !(start + readSize > this->dataSize)));
+
+    this->bind();
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, start, readSize, outData);
+    this->unbind();
+  }
+
+  //----------------------------------------------------------------------------
+  // Persistently mapped ring buffer here.
+  //----------------------------------------------------------------------------
+  RingBuffer::RingBuffer(uint frameSize)
+    : bufferID(0)
+    , mappedData(nullptr)
+    , frameSize(0)
+    , currentFrame(NUM_RING_BUFFER_FRAMES - 1)
+    , head(0)
+    , frameStarted(false)
+  {
+    // Offsets need to satisfy both uniform and storage buffer alignments.
+    int uniformAlignment, storageAlignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    this->alignment = static_cast<uint>(std::max(std::max(uniformAlignment, storageAlignment), 16));
+
+    for (uint i = 0; i < NUM_RING_BUFFER_FRAMES; i++)
+      this->fences[i] = nullptr;
+
+    this->createStorage(frameSize);
+  }
+
+  RingBuffer::~RingBuffer()
+  {
+    for (uint i = 0; i < NUM_RING_BUFFER_FRAMES; i++)
+    {
+      if (this->fences[i])
+        glDeleteSync(static_cast<GLsync>(this->fences[i]));
+    }
+
+    for (auto& [retiredID, fence] : this->retiredBuffers)
+    {
+      glDeleteSync(static_cast<GLsync>(fence));
+      glDeleteBuffers(1, &retiredID);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->bufferID);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &this->bufferID);
+  }
+
+  void
+  RingBuffer::createStorage(uint newFrameSize)
+  {
+    this->frameSize = (newFrameSize + this->alignment - 1) / this->alignment * this->alignment;
+    uint totalSize = this->frameSize * NUM_RING_BUFFER_FRAMES;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &this->bufferID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->bufferID);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+    this->mappedData = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0,
+                                                           totalSize, flags));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+
+  void
+  RingBuffer::beginFrame()
+  {
+    // Everything using the previous region has been issued by now.
+    if (this->frameStarted)
+      this->fences[this->currentFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    this->frameStarted = true;
+
+    this->currentFrame = (this->currentFrame + 1) % NUM_RING_BUFFER_FRAMES;
+    this->head = this->currentFrame * this->frameSize;
+
+    // Wait for the GPU to finish reading the region from NUM_RING_BUFFER_FRAMES ago.
+    GLsync fence = static_cast<GLsync>(this->fences[this->currentFrame]);
+    if (fence)
+    {
+      GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+      while (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED
+             && result != GL_WAIT_FAILED)
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+      glDeleteSync(fence);
+      this->fences[this->currentFrame] = nullptr;
+    }
+
+    // Clean up buffers which were replaced by a resize.
+    auto retired = this->retiredBuffers.begin();
+    while (retired != this->retiredBuffers.end())
+    {
+      GLsync retiredFence = static_cast<GLsync>(retired->second);
+      if (glClientWaitSync(retiredFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+      {
+        retired++;
+        continue;
+      }
+
+      glDeleteSync(retiredFence);
+      glDeleteBuffers(1, &retired->first);
+      retired = this->retiredBuffers.erase(retired);
+    }
+  }
+
+  uint
+  RingBuffer::allocate(uint dataSize, const void* data)
+  {
+    uint alignedSize = (dataSize + this->alignment - 1) / this->alignment * this->alignment;
+    uint frameEnd = (this->currentFrame + 1) * this->frameSize;
+
+    if (this->head + alignedSize > frameEnd)
+    {
+      // Out of space. Replace the buffer with a larger one. The old buffer
+      // stays alive (and bound) until the GPU is done with this frame.
+      uint usedSize = this->head - this->currentFrame * this->frameSize;
+
+      glBindBuffer(GL_COPY_WRITE_BUFFER, this->bufferID);
+      glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+      for (uint i = 0; i < NUM_RING_BUFFER_FRAMES; i++)
+      {
+        if (this->fences[i])
+          glDeleteSync(static_cast<GLsync>(this->fences[i]));
+        this->fences[i] = nullptr;
+      }
+      this->retiredBuffers.emplace_back(this->bufferID,
+                                        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+      this->createStorage(std::max(2 * this->frameSize, usedSize + alignedSize));
+      this->head = this->currentFrame * this->frameSize;
+    }
+
+    uint offset = this->head;
+    if (data)
+      memcpy(this->mappedData + offset, data, dataSize);
+    this->head += alignedSize;
+
+    return offset;
+  }
+
+  void
+  RingBuffer::bindUniformRange(const uint bindPoint, uint offset, uint rangeSize)
+  {
+    glBindBufferRange(GL_UNIFORM_BUFFER, bindPoint, this->bufferID, offset, rangeSize);
+  }
+
+  void
+  RingBuffer::bindStorageRange(const uint bindPoint, uint offset, uint rangeSize)
+  {
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bindPoint, this->bufferID, offset, rangeSize);
+  }
+
+  void
+  RingBuffer::bindDrawIndirect()
+  {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->bufferID);
+  }
 }
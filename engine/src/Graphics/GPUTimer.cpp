@@ -0,0 +1,47 @@
+// Project includes.
+#include "Graphics/GPUTimer.h"
+
+// OpenGL includes.
+#include "glad/glad.h"
+
+namespace Strontium
+{
+  GPUTimer::GPUTimer()
+    : currentQuery(0)
+    , elapsed(0.0f)
+  {
+    glGenQueries(NUM_RING_BUFFER_FRAMES, this->queries);
+    for (uint i = 0; i < NUM_RING_BUFFER_FRAMES; i++)
+      this->issued[i] = false;
+  }
+
+  GPUTimer::~GPUTimer()
+  {
+    glDeleteQueries(NUM_RING_BUFFER_FRAMES, this->queries);
+  }
+
+  void
+  GPUTimer::begin()
+  {
+    uint query = this->queries[this->currentQuery];
+
+    // Collect the result of the last frame which used this query.
+    if (this->issued[this->currentQuery])
+    {
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+      this->elapsed = static_cast<float>(nanoseconds) / 1000000.0f;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+  }
+
+  void
+  GPUTimer::end()
+  {
+    glEndQuery(GL_TIME_ELAPSED);
+
+    this->issued[this->currentQuery] = true;
+    this->currentQuery = (this->currentQuery + 1) % NUM_RING_BUFFER_FRAMES;
+  }
+}
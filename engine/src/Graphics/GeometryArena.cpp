@@ -0,0 +1,468 @@
+// Project includes.
+#include "Graphics/GeometryArena.h"
+
+// OpenGL includes.
+#include "glad/glad.h"
+
+namespace Strontium
+{
+  //----------------------------------------------------------------------------
+  // Range allocator here.
+  //----------------------------------------------------------------------------
+  RangeAllocator::RangeAllocator(uint capacity)
+    : capacity(capacity)
+  {
+    if (capacity > 0)
+      this->freeRanges.emplace(0, capacity);
+  }
+
+  bool
+  RangeAllocator::allocate(uint count, uint &outOffset)
+  {
+    for (auto range = this->freeRanges.begin(); range != this->freeRanges.end(); range++)
+    {
+      if (range->second < count)
+        continue;
+
+      outOffset = range->first;
+      uint remaining = range->second - count;
+      this->freeRanges.erase(range);
+      if (remaining > 0)
+        this->freeRanges.emplace(outOffset + count, remaining);
+
+      return true;
+    }
+
+    return false;
+  }
+
+  void
+  RangeAllocator::release(uint offset, uint count)
+  {
+    if (count == 0)
+      return;
+
+    auto inserted = this->freeRanges.emplace(offset, count).first;
+
+    // Merge with the following range.
+    auto next = std::next(inserted);
+    if (next != this->freeRanges.end() && inserted->first + inserted->second == next->first)
+    {
+      inserted->second += next->second;
+      this->freeRanges.erase(next);
+    }
+
+    // Merge with the preceding range.
+    if (inserted != this->freeRanges.begin())
+    {
+      auto previous = std::prev(inserted);
+      if (previous->first + previous->second == inserted->first)
+      {
+        previous->second += inserted->second;
+        this->freeRanges.erase(inserted);
+      }
+    }
+  }
+
+  void
+  RangeAllocator::grow(uint newCapacity)
+  {
+    if (newCapacity <= this->capacity)
+      return;
+
+    uint oldCapacity = this->capacity;
+    this->capacity = newCapacity;
+    this->release(oldCapacity, newCapacity - oldCapacity);
+  }
+
+  //----------------------------------------------------------------------------
+  // Geometry allocation here.
+  //----------------------------------------------------------------------------
+  GeometryAllocation::GeometryAllocation()
+    : baseVertex(0)
+    , numVertices(0)
+    , firstIndex(0)
+    , numIndices(0)
+    , indexType(IndexType::UnsignedInt)
+    , firstSkinVertex(0)
+    , numSkinVertices(0)
+    , valid(false)
+  { }
+
+  GeometryAllocation::GeometryAllocation(std::weak_ptr<GeometryArena> arena,
+                                         uint baseVertex, uint numVertices,
+                                         uint firstIndex, uint numIndices,
+                                         IndexType indexType, uint firstSkinVertex,
+                                         uint numSkinVertices)
+    : arena(arena)
+    , baseVertex(baseVertex)
+    , numVertices(numVertices)
+    , firstIndex(firstIndex)
+    , numIndices(numIndices)
+    , indexType(indexType)
+    , firstSkinVertex(firstSkinVertex)
+    , numSkinVertices(numSkinVertices)
+    , valid(true)
+  { }
+
+  GeometryAllocation::~GeometryAllocation()
+  {
+    this->release();
+  }
+
+  GeometryAllocation::GeometryAllocation(GeometryAllocation &&other)
+    : arena(std::move(other.arena))
+    , baseVertex(other.baseVertex)
+    , numVertices(other.numVertices)
+    , firstIndex(other.firstIndex)
+    , numIndices(other.numIndices)
+    , indexType(other.indexType)
+    , firstSkinVertex(other.firstSkinVertex)
+    , numSkinVertices(other.numSkinVertices)
+    , valid(other.valid)
+  {
+    other.valid = false;
+  }
+
+  GeometryAllocation&
+  GeometryAllocation::operator=(GeometryAllocation &&other)
+  {
+    if (this != &other)
+    {
+      this->release();
+
+      this->arena = std::move(other.arena);
+      this->baseVertex = other.baseVertex;
+      this->numVertices = other.numVertices;
+      this->firstIndex = other.firstIndex;
+      this->numIndices = other.numIndices;
+      this->indexType = other.indexType;
+      this->firstSkinVertex = other.firstSkinVertex;
+      this->numSkinVertices = other.numSkinVertices;
+      this->valid = other.valid;
+
+      other.valid = false;
+    }
+
+    return *this;
+  }
+
+  void
+  GeometryAllocation::release()
+  {
+    if (!this->valid)
+      return;
+
+    // The arena might have been destroyed with the renderer already.
+    if (auto owner = this->arena.lock())
+      owner->release(*this);
+
+    this->valid = false;
+  }
+
+  //----------------------------------------------------------------------------
+  // Geometry arena here.
+  //----------------------------------------------------------------------------
+  static inline uint
+  getIndexSize(IndexType indexType)
+  {
+    return indexType == IndexType::UnsignedShort ? sizeof(uint16_t) : sizeof(uint);
+  }
+
+  GeometryArena::GeometryArena(uint vertexSize, uint skinVertexSize,
+                               const std::vector<VertexAttribute> &attributes,
+                               uint instanceIDLocation, uint vertexCapacity,
+                               uint indexCapacity)
+    : vertexSize(vertexSize)
+    , skinVertexSize(skinVertexSize)
+    , attributes(attributes)
+    , instanceIDLocation(instanceIDLocation)
+    , instanceCapacity(0)
+    , boundIndexType(IndexType::UnsignedInt)
+    , vertices(vertexCapacity)
+    , indices(indexCapacity / 4)
+    , shortIndices(indexCapacity)
+    , skinVertices(vertexCapacity / 4)
+  {
+    glGenVertexArrays(1, &this->arrayID);
+    glBindVertexArray(this->arrayID);
+
+    glGenBuffers(1, &this->vertexBufferID);
+    glBindBuffer(GL_ARRAY_BUFFER, this->vertexBufferID);
+    glBufferData(GL_ARRAY_BUFFER, vertexCapacity * vertexSize, nullptr, GL_DYNAMIC_DRAW);
+
+    // Most meshes fit 16 bit indices, so the 32 bit buffer starts smaller.
+    glGenBuffers(1, &this->shortIndexBufferID);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->shortIndexBufferID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->shortIndices.getCapacity() * sizeof(uint16_t),
+                 nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &this->indexBufferID);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBufferID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.getCapacity() * sizeof(uint),
+                 nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &this->skinBufferID);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->skinBufferID);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, this->skinVertices.getCapacity() * skinVertexSize,
+                 nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenBuffers(1, &this->instanceBufferID);
+
+    this->setupAttributes();
+    this->reserveInstanceIDs(1024);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  GeometryArena::~GeometryArena()
+  {
+    glDeleteBuffers(1, &this->vertexBufferID);
+    glDeleteBuffers(1, &this->indexBufferID);
+    glDeleteBuffers(1, &this->shortIndexBufferID);
+    glDeleteBuffers(1, &this->skinBufferID);
+    glDeleteBuffers(1, &this->instanceBufferID);
+    glDeleteVertexArrays(1, &this->arrayID);
+  }
+
+  IndexType
+  GeometryArena::getIndexType(uint numVertices)
+  {
+    return numVertices <= 65536 ? IndexType::UnsignedShort : IndexType::UnsignedInt;
+  }
+
+  // Point the VAO attributes at the current vertex buffer. Expects the VAO to
+  // be bound.
+  void
+  GeometryArena::setupAttributes()
+  {
+    glBindBuffer(GL_ARRAY_BUFFER, this->vertexBufferID);
+    for (auto& attribute : this->attributes)
+    {
+      void* offset = (void*) (unsigned long) attribute.offset;
+      GLboolean normalized = static_cast<GLboolean>(attribute.normalized);
+      switch (attribute.type)
+      {
+        case AttribType::Vec4: glVertexAttribPointer(attribute.location, 4, GL_FLOAT, normalized, this->vertexSize, offset); break;
+        case AttribType::Vec3: glVertexAttribPointer(attribute.location, 3, GL_FLOAT, normalized, this->vertexSize, offset); break;
+        case AttribType::Vec2: glVertexAttribPointer(attribute.location, 2, GL_FLOAT, normalized, this->vertexSize, offset); break;
+        case AttribType::IVec4: glVertexAttribIPointer(attribute.location, 4, GL_INT, this->vertexSize, offset); break;
+        case AttribType::IVec3: glVertexAttribIPointer(attribute.location, 3, GL_INT, this->vertexSize, offset); break;
+        case AttribType::IVec2: glVertexAttribIPointer(attribute.location, 2, GL_INT, this->vertexSize, offset); break;
+        case AttribType::Vec2Half: glVertexAttribPointer(attribute.location, 2, GL_HALF_FLOAT, normalized, this->vertexSize, offset); break;
+        case AttribType::IVec4Short: glVertexAttribIPointer(attribute.location, 4, GL_SHORT, this->vertexSize, offset); break;
+      }
+      glEnableVertexAttribArray(attribute.location);
+    }
+  }
+
+  GeometryAllocation
+  GeometryArena::allocate(const void* vertexData, uint numVertices,
+                          const uint* indexData, uint numIndices,
+                          const void* skinData)
+  {
+    std::lock_guard<std::mutex> allocatorGuard(this->allocatorMutex);
+
+    IndexType indexType = getIndexType(numVertices);
+    RangeAllocator &indexAllocator = indexType == IndexType::UnsignedShort
+                                     ? this->shortIndices : this->indices;
+
+    uint baseVertex, firstIndex, firstSkinVertex = 0;
+    if (!this->vertices.allocate(numVertices, baseVertex))
+    {
+      this->growVertexBuffer(std::max(2 * this->vertices.getCapacity(),
+                                      this->vertices.getCapacity() + numVertices));
+      this->vertices.allocate(numVertices, baseVertex);
+    }
+    if (!indexAllocator.allocate(numIndices, firstIndex))
+    {
+      this->growIndexBuffer(indexType, std::max(2 * indexAllocator.getCapacity(),
+                                                indexAllocator.getCapacity() + numIndices));
+      indexAllocator.allocate(numIndices, firstIndex);
+    }
+    if (skinData && !this->skinVertices.allocate(numVertices, firstSkinVertex))
+    {
+      this->growSkinBuffer(std::max(2 * this->skinVertices.getCapacity(),
+                                    this->skinVertices.getCapacity() + numVertices));
+      this->skinVertices.allocate(numVertices, firstSkinVertex);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->vertexBufferID);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, baseVertex * this->vertexSize,
+                    numVertices * this->vertexSize, vertexData);
+
+    if (indexType == IndexType::UnsignedShort)
+    {
+      std::vector<uint16_t> shortIndexData(indexData, indexData + numIndices);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, this->shortIndexBufferID);
+      glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(uint16_t),
+                      numIndices * sizeof(uint16_t), shortIndexData.data());
+    }
+    else
+    {
+      glBindBuffer(GL_COPY_WRITE_BUFFER, this->indexBufferID);
+      glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(uint),
+                      numIndices * sizeof(uint), indexData);
+    }
+
+    if (skinData)
+    {
+      glBindBuffer(GL_COPY_WRITE_BUFFER, this->skinBufferID);
+      glBufferSubData(GL_COPY_WRITE_BUFFER, firstSkinVertex * this->skinVertexSize,
+                      numVertices * this->skinVertexSize, skinData);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return GeometryAllocation(this->weak_from_this(), baseVertex, numVertices,
+                              firstIndex, numIndices, indexType, firstSkinVertex,
+                              skinData ? numVertices : 0);
+  }
+
+  GeometryAllocation
+  GeometryArena::allocateVertices(uint numVertices)
+  {
+    std::lock_guard<std::mutex> allocatorGuard(this->allocatorMutex);
+
+    uint baseVertex;
+    if (!this->vertices.allocate(numVertices, baseVertex))
+    {
+      this->growVertexBuffer(std::max(2 * this->vertices.getCapacity(),
+                                      this->vertices.getCapacity() + numVertices));
+      this->vertices.allocate(numVertices, baseVertex);
+    }
+
+    return GeometryAllocation(this->weak_from_this(), baseVertex, numVertices, 0, 0,
+                              IndexType::UnsignedInt, 0, 0);
+  }
+
+  void
+  GeometryArena::release(const GeometryAllocation &allocation)
+  {
+    std::lock_guard<std::mutex> allocatorGuard(this->allocatorMutex);
+
+    this->vertices.release(allocation.baseVertex, allocation.numVertices);
+    if (allocation.indexType == IndexType::UnsignedShort)
+      this->shortIndices.release(allocation.firstIndex, allocation.numIndices);
+    else
+      this->indices.release(allocation.firstIndex, allocation.numIndices);
+    this->skinVertices.release(allocation.firstSkinVertex, allocation.numSkinVertices);
+  }
+
+  // Replace a buffer with a larger copy of itself, sizes are in bytes.
+  void
+  GeometryArena::growBuffer(uint &bufferID, uint oldSize, uint newSize)
+  {
+    uint newBufferID;
+    glGenBuffers(1, &newBufferID);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBufferID);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, bufferID);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glDeleteBuffers(1, &bufferID);
+    bufferID = newBufferID;
+  }
+
+  void
+  GeometryArena::growVertexBuffer(uint newCapacity)
+  {
+    this->growBuffer(this->vertexBufferID, this->vertices.getCapacity() * this->vertexSize,
+                     newCapacity * this->vertexSize);
+    this->vertices.grow(newCapacity);
+
+    glBindVertexArray(this->arrayID);
+    this->setupAttributes();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  void
+  GeometryArena::growIndexBuffer(IndexType indexType, uint newCapacity)
+  {
+    bool shortIndices = indexType == IndexType::UnsignedShort;
+    RangeAllocator &allocator = shortIndices ? this->shortIndices : this->indices;
+    uint &bufferID = shortIndices ? this->shortIndexBufferID : this->indexBufferID;
+
+    this->growBuffer(bufferID, allocator.getCapacity() * getIndexSize(indexType),
+                     newCapacity * getIndexSize(indexType));
+    allocator.grow(newCapacity);
+
+    // The element buffer binding is VAO state.
+    if (indexType == this->boundIndexType)
+    {
+      glBindVertexArray(this->arrayID);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferID);
+      glBindVertexArray(0);
+    }
+  }
+
+  void
+  GeometryArena::growSkinBuffer(uint newCapacity)
+  {
+    this->growBuffer(this->skinBufferID, this->skinVertices.getCapacity() * this->skinVertexSize,
+                     newCapacity * this->skinVertexSize);
+    this->skinVertices.grow(newCapacity);
+  }
+
+  void
+  GeometryArena::reserveInstanceIDs(uint numInstances)
+  {
+    if (numInstances <= this->instanceCapacity)
+      return;
+
+    uint newCapacity = std::max(numInstances, 2 * this->instanceCapacity);
+    std::vector<uint> instanceIDs(newCapacity);
+    for (uint i = 0; i < newCapacity; i++)
+      instanceIDs[i] = i;
+
+    // Instanced attributes are offset by the base instance of the draw, so the
+    // stream ends up holding the index of the instance data.
+    glBindVertexArray(this->arrayID);
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceBufferID);
+    glBufferData(GL_ARRAY_BUFFER, newCapacity * sizeof(uint), instanceIDs.data(), GL_STATIC_DRAW);
+    glVertexAttribIPointer(this->instanceIDLocation, 1, GL_UNSIGNED_INT, sizeof(uint), nullptr);
+    glVertexAttribDivisor(this->instanceIDLocation, 1);
+    glEnableVertexAttribArray(this->instanceIDLocation);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->instanceCapacity = newCapacity;
+  }
+
+  void
+  GeometryArena::bind()
+  {
+    glBindVertexArray(this->arrayID);
+  }
+
+  void
+  GeometryArena::unbind()
+  {
+    glBindVertexArray(0);
+  }
+
+  void
+  GeometryArena::bindIndexBuffer(IndexType indexType)
+  {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexType == IndexType::UnsignedShort
+                                          ? this->shortIndexBufferID : this->indexBufferID);
+    this->boundIndexType = indexType;
+  }
+
+  void
+  GeometryArena::bindVertexStorage(uint bindPoint)
+  {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindPoint, this->vertexBufferID);
+  }
+
+  void
+  GeometryArena::bindSkinStorage(uint bindPoint)
+  {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindPoint, this->skinBufferID);
+  }
+}
@@ -0,0 +1,785 @@
+#include "Graphics/MeshOptimizer.h"
+
+// Project includes.
+#include "Graphics/Meshes.h"
+
+// STL includes.
+#include <numeric>
+#include <limits>
+#include <cstring>
+
+namespace Strontium
+{
+  namespace MeshOptimizer
+  {
+    //--------------------------------------------------------------------------
+    // Vertex cache analysis here.
+    //--------------------------------------------------------------------------
+    // A vertex is in a FIFO cache if fewer than cacheSize vertices were
+    // transformed since it was, so timestamps are enough to simulate one.
+    VertexCacheStats
+    analyzeVertexCache(const std::vector<uint> &indices, uint numVertices, uint cacheSize)
+    {
+      VertexCacheStats stats;
+      stats.numTriangles = indices.size() / 3;
+      stats.numVertices = numVertices;
+
+      std::vector<uint> cacheTimestamps(numVertices, 0);
+      uint time = cacheSize + 1;
+      for (auto index : indices)
+      {
+        if (time - cacheTimestamps[index] > cacheSize)
+        {
+          cacheTimestamps[index] = time++;
+          stats.numTransformed++;
+        }
+      }
+
+      return stats;
+    }
+
+    //--------------------------------------------------------------------------
+    // Tipsify vertex cache optimization here.
+    //--------------------------------------------------------------------------
+    void
+    optimizeVertexCache(std::vector<uint> &indices, uint numVertices,
+                        std::vector<uint> &outClusters, uint cacheSize)
+    {
+      outClusters.clear();
+
+      uint numTriangles = indices.size() / 3;
+      if (numTriangles == 0)
+        return;
+
+      // The triangles using each vertex, packed by vertex. The live triangle
+      // count of a vertex drops as its triangles are emitted.
+      std::vector<uint> liveTriangles(numVertices, 0);
+      for (auto index : indices)
+        liveTriangles[index]++;
+
+      std::vector<uint> adjacencyOffsets(numVertices + 1, 0);
+      for (uint v = 0; v < numVertices; v++)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+      std::vector<uint> adjacency(indices.size());
+      std::vector<uint> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+      for (uint t = 0; t < numTriangles; t++)
+      {
+        for (uint k = 0; k < 3; k++)
+          adjacency[fillOffsets[indices[3 * t + k]]++] = t;
+      }
+
+      std::vector<uint> cacheTimestamps(numVertices, 0);
+      std::vector<bool> emitted(numTriangles, false);
+      std::vector<uint> deadEnds;
+      std::vector<uint> candidates;
+      std::vector<uint> output;
+      output.reserve(indices.size());
+
+      uint time = cacheSize + 1;
+      uint cursor = 0;
+      while (true)
+      {
+        // Prefer the candidate which will still be in the cache after its
+        // remaining triangles are emitted, the one that entered the cache
+        // first.
+        int fanning = -1;
+        int bestPriority = -1;
+        for (auto vertex : candidates)
+        {
+          if (liveTriangles[vertex] == 0)
+            continue;
+
+          int priority = 0;
+          if (time - cacheTimestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+            priority = time - cacheTimestamps[vertex];
+
+          if (priority > bestPriority)
+          {
+            bestPriority = priority;
+            fanning = vertex;
+          }
+        }
+
+        // Dead end, fall back to a recently used vertex.
+        while (fanning < 0 && !deadEnds.empty())
+        {
+          uint vertex = deadEnds.back();
+          deadEnds.pop_back();
+          if (liveTriangles[vertex] > 0)
+            fanning = vertex;
+        }
+
+        // Nothing recent is left, jump to the next vertex in index order. The
+        // cache is effectively flushed, so this starts a new cluster.
+        if (fanning < 0)
+        {
+          while (cursor < numVertices && liveTriangles[cursor] == 0)
+            cursor++;
+          if (cursor == numVertices)
+            break;
+
+          fanning = cursor;
+          outClusters.push_back(output.size() / 3);
+        }
+
+        // Emit every remaining triangle around the fanning vertex.
+        candidates.clear();
+        for (uint a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+        {
+          uint triangle = adjacency[a];
+          if (emitted[triangle])
+            continue;
+
+          for (uint k = 0; k < 3; k++)
+          {
+            uint vertex = indices[3 * triangle + k];
+            output.push_back(vertex);
+            deadEnds.push_back(vertex);
+            candidates.push_back(vertex);
+            liveTriangles[vertex]--;
+
+            if (time - cacheTimestamps[vertex] > cacheSize)
+              cacheTimestamps[vertex] = time++;
+          }
+          emitted[triangle] = true;
+        }
+      }
+
+      indices.swap(output);
+    }
+
+    //--------------------------------------------------------------------------
+    // Overdraw optimization here.
+    //--------------------------------------------------------------------------
+    struct OverdrawCluster
+    {
+      uint firstTriangle;
+      uint numTriangles;
+      float sortKey;
+    };
+
+    void
+    optimizeOverdraw(std::vector<uint> &indices, const std::vector<Vertex> &vertices,
+                     const std::vector<uint> &clusters, float threshold, uint cacheSize)
+    {
+      uint numTriangles = indices.size() / 3;
+      if (numTriangles == 0 || clusters.empty())
+        return;
+
+      // Split the clusters further wherever the part of a cluster emitted so
+      // far is close enough to the ACMR of the whole mesh. The cache is
+      // flushed at each split, so the vertex cache cost is bounded by the
+      // threshold.
+      float targetACMR = analyzeVertexCache(indices, vertices.size(), cacheSize).getACMR() * threshold;
+
+      std::vector<OverdrawCluster> splitClusters;
+      std::vector<uint> cacheTimestamps(vertices.size(), 0);
+      uint time = cacheSize + 1;
+      for (uint c = 0; c < clusters.size(); c++)
+      {
+        uint end = c + 1 < clusters.size() ? clusters[c + 1] : numTriangles;
+        uint start = clusters[c];
+        uint numTransformed = 0;
+        time += cacheSize + 1;
+
+        for (uint t = clusters[c]; t < end; t++)
+        {
+          for (uint k = 0; k < 3; k++)
+          {
+            uint vertex = indices[3 * t + k];
+            if (time - cacheTimestamps[vertex] > cacheSize)
+            {
+              cacheTimestamps[vertex] = time++;
+              numTransformed++;
+            }
+          }
+
+          if (t + 1 < end && numTransformed <= targetACMR * (t + 1 - start))
+          {
+            splitClusters.push_back({ start, t + 1 - start, 0.0f });
+            start = t + 1;
+            numTransformed = 0;
+            time += cacheSize + 1;
+          }
+        }
+
+        splitClusters.push_back({ start, end - start, 0.0f });
+      }
+
+      // Area weighted centroids and normals of the clusters and the mesh.
+      std::vector<glm::vec3> centroids(splitClusters.size(), glm::vec3(0.0f));
+      std::vector<glm::vec3> normals(splitClusters.size(), glm::vec3(0.0f));
+      glm::vec3 meshCentroid = glm::vec3(0.0f);
+      float meshArea = 0.0f;
+      for (uint c = 0; c < splitClusters.size(); c++)
+      {
+        auto& cluster = splitClusters[c];
+
+        float clusterArea = 0.0f;
+        for (uint t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.numTriangles; t++)
+        {
+          const glm::vec3 &p0 = vertices[indices[3 * t]].position;
+          const glm::vec3 &p1 = vertices[indices[3 * t + 1]].position;
+          const glm::vec3 &p2 = vertices[indices[3 * t + 2]].position;
+
+          glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+          float area = glm::length(normal);
+          centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+          normals[c] += normal;
+          clusterArea += area;
+        }
+
+        meshCentroid += centroids[c];
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f)
+          centroids[c] /= clusterArea;
+      }
+      if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+      // Clusters facing away from the center are more likely to occlude the
+      // rest of the mesh.
+      for (uint c = 0; c < splitClusters.size(); c++)
+      {
+        float length = glm::length(normals[c]);
+        splitClusters[c].sortKey = length > 0.0f
+                                   ? glm::dot(centroids[c] - meshCentroid, normals[c] / length)
+                                   : 0.0f;
+      }
+
+      std::stable_sort(splitClusters.begin(), splitClusters.end(),
+                       [](const OverdrawCluster &a, const OverdrawCluster &b)
+      {
+        return a.sortKey > b.sortKey;
+      });
+
+      std::vector<uint> output;
+      output.reserve(indices.size());
+      for (auto& cluster : splitClusters)
+      {
+        output.insert(output.end(), indices.begin() + 3 * cluster.firstTriangle,
+                      indices.begin() + 3 * (cluster.firstTriangle + cluster.numTriangles));
+      }
+
+      indices.swap(output);
+    }
+
+    //--------------------------------------------------------------------------
+    // Vertex fetch optimization here.
+    //--------------------------------------------------------------------------
+    template <typename T>
+    static void
+    remapVertices(std::vector<T> &vertices, const std::vector<uint> &remap)
+    {
+      std::vector<T> reordered(vertices.size());
+      for (uint v = 0; v < vertices.size(); v++)
+        reordered[remap[v]] = vertices[v];
+
+      vertices.swap(reordered);
+    }
+
+    void
+    optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<VertexSkin> &skinData,
+                        std::vector<uint> &indices)
+    {
+      constexpr uint unmapped = std::numeric_limits<uint>::max();
+
+      std::vector<uint> remap(vertices.size(), unmapped);
+      uint nextVertex = 0;
+      for (auto index : indices)
+      {
+        if (remap[index] == unmapped)
+          remap[index] = nextVertex++;
+      }
+
+      // Unreferenced vertices keep their order at the end.
+      for (auto& index : remap)
+      {
+        if (index == unmapped)
+          index = nextVertex++;
+      }
+
+      remapVertices(vertices, remap);
+      if (skinData.size() == remap.size())
+        remapVertices(skinData, remap);
+
+      for (auto& index : indices)
+        index = remap[index];
+    }
+
+    //--------------------------------------------------------------------------
+    // Mesh optimization here.
+    //--------------------------------------------------------------------------
+    void
+    optimizeMesh(Mesh &mesh, VertexCacheStats &outBefore, VertexCacheStats &outAfter)
+    {
+      auto& vertices = mesh.getData();
+      auto& indices = mesh.getIndices();
+
+      outBefore = analyzeVertexCache(indices, vertices.size());
+      outAfter = outBefore;
+
+      // Only triangle lists can be reordered.
+      if (indices.empty() || indices.size() % 3 != 0)
+        return;
+
+      std::vector<uint> clusters;
+      optimizeVertexCache(indices, vertices.size(), clusters);
+      optimizeOverdraw(indices, vertices, clusters);
+      optimizeVertexFetch(vertices, mesh.getSkinData(), indices);
+
+      outAfter = analyzeVertexCache(indices, vertices.size());
+    }
+
+    //--------------------------------------------------------------------------
+    // Quadric simplification here.
+    //--------------------------------------------------------------------------
+    // Area weighted sum of plane quadrics, the symmetric matrix A, the vector
+    // b and the constant c of x^T A x + 2 b.x + c.
+    struct Quadric
+    {
+      double a00, a01, a02, a11, a12, a22;
+      double b0, b1, b2;
+      double c;
+      double weight;
+
+      Quadric()
+        : a00(0.0), a01(0.0), a02(0.0), a11(0.0), a12(0.0), a22(0.0)
+        , b0(0.0), b1(0.0), b2(0.0)
+        , c(0.0)
+        , weight(0.0)
+      { }
+
+      void addPlane(const glm::dvec3 &normal, double d, double planeWeight)
+      {
+        this->a00 += planeWeight * normal.x * normal.x;
+        this->a01 += planeWeight * normal.x * normal.y;
+        this->a02 += planeWeight * normal.x * normal.z;
+        this->a11 += planeWeight * normal.y * normal.y;
+        this->a12 += planeWeight * normal.y * normal.z;
+        this->a22 += planeWeight * normal.z * normal.z;
+        this->b0 += planeWeight * normal.x * d;
+        this->b1 += planeWeight * normal.y * d;
+        this->b2 += planeWeight * normal.z * d;
+        this->c += planeWeight * d * d;
+        this->weight += planeWeight;
+      }
+
+      Quadric& operator+=(const Quadric &other)
+      {
+        this->a00 += other.a00; this->a01 += other.a01; this->a02 += other.a02;
+        this->a11 += other.a11; this->a12 += other.a12; this->a22 += other.a22;
+        this->b0 += other.b0; this->b1 += other.b1; this->b2 += other.b2;
+        this->c += other.c;
+        this->weight += other.weight;
+        return *this;
+      }
+
+      // Weighted mean squared distance to the planes.
+      double getError(const glm::vec3 &point) const
+      {
+        double x = point.x, y = point.y, z = point.z;
+        double error = this->a00 * x * x + 2.0 * this->a01 * x * y + 2.0 * this->a02 * x * z
+                     + this->a11 * y * y + 2.0 * this->a12 * y * z + this->a22 * z * z
+                     + 2.0 * (this->b0 * x + this->b1 * y + this->b2 * z) + this->c;
+        return this->weight > 0.0 ? std::abs(error) / this->weight : 0.0;
+      }
+    };
+
+    struct PositionHash
+    {
+      std::size_t operator()(const glm::vec3 &position) const
+      {
+        // Adding zero turns -0 into +0, they compare equal.
+        glm::vec3 normalized = position + 0.0f;
+        uint bits[3];
+        std::memcpy(bits, &normalized, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+      }
+    };
+
+    struct EdgeCollapse
+    {
+      uint from;
+      uint to;
+      double error;
+    };
+
+    static inline uint64_t
+    getEdgeKey(uint a, uint b)
+    {
+      return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+    }
+
+    // Map every vertex to the first vertex sharing its position. Vertices
+    // sharing a position are the sides of an attribute seam.
+    static void
+    weldPositions(const std::vector<Vertex> &vertices, std::vector<uint> &outCanonical)
+    {
+      std::unordered_map<glm::vec3, uint, PositionHash> positions;
+      positions.reserve(vertices.size());
+
+      outCanonical.resize(vertices.size());
+      for (uint v = 0; v < vertices.size(); v++)
+        outCanonical[v] = positions.emplace(vertices[v].position, v).first->second;
+    }
+
+    // Count the triangles of each edge of the welded triangles in
+    // [0, numIndices).
+    static void
+    countEdgeTriangles(const std::vector<uint> &indices, uint numIndices,
+                       const std::vector<uint> &canonical,
+                       std::unordered_map<uint64_t, uint> &outEdgeTriangles)
+    {
+      outEdgeTriangles.clear();
+      outEdgeTriangles.reserve(numIndices);
+      for (uint i = 0; i < numIndices; i += 3)
+      {
+        for (uint k = 0; k < 3; k++)
+        {
+          uint a = canonical[indices[i + k]];
+          uint b = canonical[indices[i + (k + 1) % 3]];
+          outEdgeTriangles[getEdgeKey(a, b)]++;
+        }
+      }
+    }
+
+    float
+    simplify(std::vector<uint> &indices, const std::vector<Vertex> &vertices,
+             uint targetIndexCount, float maxError)
+    {
+      uint numVertices = vertices.size();
+      if (indices.size() <= targetIndexCount)
+        return 0.0f;
+
+      // The topology and the quadrics work on one canonical vertex per
+      // position.
+      std::vector<uint> canonical;
+      weldPositions(vertices, canonical);
+
+      std::vector<uint> numWedges(numVertices, 0);
+      for (uint v = 0; v < numVertices; v++)
+        numWedges[canonical[v]]++;
+
+      // Lock the seams, and the vertices of edges that don't have exactly
+      // two triangles. Moving those would open holes or shift the borders.
+      std::vector<bool> locked(numVertices, false);
+      for (uint v = 0; v < numVertices; v++)
+        locked[v] = numWedges[canonical[v]] > 1;
+
+      std::unordered_map<uint64_t, uint> edgeTriangles;
+      countEdgeTriangles(indices, indices.size(), canonical, edgeTriangles);
+      for (auto& [edge, count] : edgeTriangles)
+      {
+        if (count == 2)
+          continue;
+
+        locked[static_cast<uint>(edge >> 32)] = true;
+        locked[static_cast<uint>(edge & 0xFFFFFFFF)] = true;
+      }
+      for (uint v = 0; v < numVertices; v++)
+        locked[v] = locked[v] || locked[canonical[v]];
+
+      std::vector<Quadric> quadrics(numVertices);
+      for (uint i = 0; i < indices.size(); i += 3)
+      {
+        glm::dvec3 p0(vertices[indices[i]].position);
+        glm::dvec3 p1(vertices[indices[i + 1]].position);
+        glm::dvec3 p2(vertices[indices[i + 2]].position);
+
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length == 0.0)
+          continue;
+
+        normal /= length;
+        double d = -glm::dot(normal, p0);
+        for (uint k = 0; k < 3; k++)
+          quadrics[canonical[indices[i + k]]].addPlane(normal, d, 0.5 * length);
+      }
+
+      double maxSquaredError = static_cast<double>(maxError) * maxError;
+      double resultError = 0.0;
+
+      std::vector<uint> adjacencyOffsets(numVertices + 1);
+      std::vector<uint> adjacency;
+      std::vector<EdgeCollapse> collapses;
+      std::vector<uint> remap(numVertices);
+      std::vector<bool> touched(numVertices);
+      while (indices.size() > targetIndexCount)
+      {
+        uint numTriangles = indices.size() / 3;
+
+        // The triangles around each vertex.
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (auto index : indices)
+          adjacencyOffsets[index + 1]++;
+        for (uint v = 0; v < numVertices; v++)
+          adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+        adjacency.resize(indices.size());
+        std::vector<uint> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint t = 0; t < numTriangles; t++)
+        {
+          for (uint k = 0; k < 3; k++)
+            adjacency[fillOffsets[indices[3 * t + k]]++] = t;
+        }
+
+        // Every directed edge is a candidate to collapse its first vertex
+        // onto its second.
+        collapses.clear();
+        for (uint t = 0; t < numTriangles; t++)
+        {
+          for (uint k = 0; k < 3; k++)
+          {
+            uint from = indices[3 * t + k];
+            uint to = indices[3 * t + (k + 1) % 3];
+            if (locked[from])
+              continue;
+
+            Quadric quadric = quadrics[canonical[from]];
+            quadric += quadrics[canonical[to]];
+            collapses.push_back({ from, to, quadric.getError(vertices[to].position) });
+          }
+        }
+
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const EdgeCollapse &a, const EdgeCollapse &b)
+        {
+          return a.error < b.error;
+        });
+
+        // Apply the cheapest collapses that don't overlap. The triangles
+        // around a collapsed vertex are only changed once a pass, so the flip
+        // test stays valid.
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+        uint trianglesToRemove = (indices.size() - targetIndexCount + 2) / 3;
+        uint numRemoved = 0;
+        uint numCollapsed = 0;
+        for (auto& collapse : collapses)
+        {
+          if (collapse.error > maxSquaredError || numRemoved >= trianglesToRemove)
+            break;
+          if (touched[collapse.from] || touched[collapse.to])
+            continue;
+
+          // Reject the collapse if a triangle which survives it flips over.
+          bool flipped = false;
+          uint numDegenerate = 0;
+          const glm::vec3 &target = vertices[collapse.to].position;
+          for (uint a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flipped; a++)
+          {
+            const uint* triangle = &indices[3 * adjacency[a]];
+            if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+            {
+              numDegenerate++;
+              continue;
+            }
+
+            glm::vec3 p[3], q[3];
+            for (uint k = 0; k < 3; k++)
+            {
+              p[k] = vertices[triangle[k]].position;
+              q[k] = triangle[k] == collapse.from ? target : p[k];
+            }
+
+            glm::vec3 oldNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 newNormal = glm::cross(q[1] - q[0], q[2] - q[0]);
+            flipped = glm::dot(oldNormal, newNormal) <= 0.0f;
+          }
+          if (flipped)
+            continue;
+
+          remap[collapse.from] = collapse.to;
+          quadrics[canonical[collapse.to]] += quadrics[canonical[collapse.from]];
+          resultError = std::max(resultError, collapse.error);
+          numRemoved += numDegenerate;
+          numCollapsed++;
+
+          for (uint a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++)
+          {
+            const uint* triangle = &indices[3 * adjacency[a]];
+            touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+          }
+        }
+
+        if (numCollapsed == 0)
+          break;
+
+        // Drop the triangles which collapsed to a line or a point.
+        uint numIndices = 0;
+        for (uint i = 0; i < indices.size(); i += 3)
+        {
+          uint a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+          if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c])
+            continue;
+
+          indices[numIndices++] = a;
+          indices[numIndices++] = b;
+          indices[numIndices++] = c;
+        }
+        indices.resize(numIndices);
+      }
+
+      return static_cast<float>(std::sqrt(resultError));
+    }
+
+    //--------------------------------------------------------------------------
+    // LOD chains here.
+    //--------------------------------------------------------------------------
+    void
+    buildLODs(Mesh &mesh)
+    {
+      auto& vertices = mesh.getData();
+      auto& indices = mesh.getIndices();
+      auto& lods = mesh.getLODs();
+
+      lods.clear();
+      lods.push_back({ 0, static_cast<uint>(indices.size()), 0.0f });
+      if (indices.size() % 3 != 0)
+        return;
+
+      // Each LOD is simplified from the previous one, so the errors add up.
+      std::vector<uint> lodIndices(indices);
+      std::vector<uint> clusters;
+      float error = 0.0f;
+      while (lods.size() < MAX_MESH_LODS)
+      {
+        uint previousCount = lodIndices.size();
+        uint targetCount = (previousCount / 6) * 3;
+        if (targetCount < 3 * MESH_LOD_MIN_TRIANGLES)
+          break;
+
+        error += simplify(lodIndices, vertices, targetCount, std::numeric_limits<float>::max());
+        if (lodIndices.size() > previousCount * MESH_LOD_MIN_REDUCTION)
+          break;
+
+        optimizeVertexCache(lodIndices, vertices.size(), clusters);
+
+        lods.push_back({ static_cast<uint>(indices.size()), static_cast<uint>(lodIndices.size()), error });
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    // Meshlets here.
+    //--------------------------------------------------------------------------
+    // Bounding sphere and normal cone of the triangles in [firstIndex,
+    // firstIndex + numIndices). The cone test is the one from meshoptimizer,
+    // a meshlet is back facing if the whole sphere is behind every triangle.
+    static void
+    computeMeshletBounds(Meshlet &meshlet, const std::vector<uint> &indices,
+                         const std::vector<Vertex> &vertices, bool coneCulling)
+    {
+      glm::vec3 minPos = glm::vec3(std::numeric_limits<float>::max());
+      glm::vec3 maxPos = glm::vec3(std::numeric_limits<float>::lowest());
+      for (uint i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.numIndices; i++)
+      {
+        minPos = glm::min(minPos, vertices[indices[i]].position);
+        maxPos = glm::max(maxPos, vertices[indices[i]].position);
+      }
+
+      glm::vec3 center = 0.5f * (minPos + maxPos);
+      float radius = 0.0f;
+      for (uint i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.numIndices; i++)
+        radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+      meshlet.sphere = glm::vec4(center, radius);
+
+      meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+      if (!coneCulling)
+        return;
+
+      std::vector<glm::vec3> normals;
+      normals.reserve(meshlet.numIndices / 3);
+      glm::vec3 axis = glm::vec3(0.0f);
+      for (uint i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.numIndices; i += 3)
+      {
+        const glm::vec3 &p0 = vertices[indices[i]].position;
+        const glm::vec3 &p1 = vertices[indices[i + 1]].position;
+        const glm::vec3 &p2 = vertices[indices[i + 2]].position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+          continue;
+
+        normals.push_back(normal / length);
+        axis += normals.back();
+      }
+
+      float axisLength = glm::length(axis);
+      if (axisLength == 0.0f)
+        return;
+      axis /= axisLength;
+
+      float minDot = 1.0f;
+      for (auto& normal : normals)
+        minDot = std::min(minDot, glm::dot(normal, axis));
+
+      // Cones wider than about 84 degrees almost never cull anything.
+      if (minDot <= 0.1f)
+        return;
+
+      meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    }
+
+    void
+    buildMeshlets(Mesh &mesh)
+    {
+      auto& vertices = mesh.getData();
+      auto& indices = mesh.getIndices();
+      auto& meshlets = mesh.getMeshlets();
+
+      meshlets.clear();
+      uint numIndices = mesh.getLOD(0).numIndices;
+      if (mesh.isSkinned() || numIndices < 3 * MESHLET_MIN_MESH_TRIANGLES)
+        return;
+
+      // Back faces of an open mesh can be seen, keep the cones of closed
+      // meshes only.
+      std::vector<uint> canonical;
+      std::unordered_map<uint64_t, uint> edgeTriangles;
+      weldPositions(vertices, canonical);
+      countEdgeTriangles(indices, numIndices, canonical, edgeTriangles);
+
+      bool closed = true;
+      for (auto& [edge, count] : edgeTriangles)
+        closed = closed && count == 2;
+
+      // Last meshlet that used each vertex.
+      std::vector<uint> vertexMeshlet(vertices.size(), std::numeric_limits<uint>::max());
+      uint current = 0;
+      uint numMeshletVertices = 0;
+      meshlets.push_back({ glm::vec4(0.0f), glm::vec4(0.0f), 0, 0 });
+      for (uint i = 0; i < numIndices; i += 3)
+      {
+        uint newVertices = 0;
+        for (uint k = 0; k < 3; k++)
+          newVertices += vertexMeshlet[indices[i + k]] != current ? 1 : 0;
+
+        if (meshlets[current].numIndices == 3 * MESHLET_MAX_TRIANGLES
+            || numMeshletVertices + newVertices > MESHLET_MAX_VERTICES)
+        {
+          meshlets.push_back({ glm::vec4(0.0f), glm::vec4(0.0f), i, 0 });
+          current++;
+          numMeshletVertices = 0;
+        }
+
+        for (uint k = 0; k < 3; k++)
+        {
+          if (vertexMeshlet[indices[i + k]] == current)
+            continue;
+
+          vertexMeshlet[indices[i + k]] = current;
+          numMeshletVertices++;
+        }
+        meshlets[current].numIndices += 3;
+      }
+
+      for (auto& meshlet : meshlets)
+        computeMeshletBounds(meshlet, indices, vertices, closed);
+    }
+  }
+}
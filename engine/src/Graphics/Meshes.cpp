@@ -2,9 +2,105 @@
 
 // Project includes.
 #include "Core/Logs.h"
+#include "Core/Math.h"
+#include "Graphics/Animations.h"
+
+// GLM includes.
+#include "glm/gtc/packing.hpp"
 
 namespace Strontium
 {
+  //----------------------------------------------------------------------------
+  // Vertex packing here.
+  //----------------------------------------------------------------------------
+  static inline int16_t
+  packSnorm16(float value)
+  {
+    return static_cast<int16_t>(std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+  }
+
+  static inline float
+  unpackSnorm16(int value)
+  {
+    return glm::max(static_cast<float>(value) / 32767.0f, -1.0f);
+  }
+
+  void
+  Vertex::setFrame(const glm::vec3 &normal, const glm::vec3 &tangent,
+                   const glm::vec3 &bitangent)
+  {
+    glm::vec2 encodedNormal = encodeOctahedral(normal);
+    glm::vec2 encodedTangent = encodeOctahedral(tangent);
+    bool flipped = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f;
+
+    this->frame.x = packSnorm16(encodedNormal.x);
+    this->frame.y = packSnorm16(encodedNormal.y);
+    this->frame.z = packSnorm16(encodedTangent.x);
+    this->frame.w = static_cast<int16_t>((packSnorm16(encodedTangent.y) & ~1) | (flipped ? 1 : 0));
+  }
+
+  void
+  Vertex::setUV(const glm::vec2 &texCoords)
+  {
+    this->uv = glm::packHalf2x16(texCoords);
+  }
+
+  glm::vec3
+  Vertex::getNormal() const
+  {
+    return decodeOctahedral(glm::vec2(unpackSnorm16(this->frame.x), unpackSnorm16(this->frame.y)));
+  }
+
+  glm::vec3
+  Vertex::getTangent() const
+  {
+    return decodeOctahedral(glm::vec2(unpackSnorm16(this->frame.z),
+                                      unpackSnorm16(this->frame.w & ~1)));
+  }
+
+  glm::vec2
+  Vertex::getUV() const
+  {
+    return glm::unpackHalf2x16(this->uv);
+  }
+
+  void
+  VertexSkin::setInfluences(const glm::ivec4 &ids, const glm::vec4 &weights)
+  {
+    float totalWeight = 0.0f;
+    for (uint i = 0; i < MAX_BONES_PER_VERTEX; i++)
+      if (ids[i] >= 0 && weights[i] > 0.0f)
+        totalWeight += weights[i];
+
+    this->boneIDs = glm::u16vec4(0);
+    this->boneWeights = glm::u8vec4(0);
+    if (totalWeight <= 0.0f)
+      return;
+
+    int quantizedTotal = 0;
+    uint largest = 0;
+    for (uint i = 0; i < MAX_BONES_PER_VERTEX; i++)
+    {
+      if (ids[i] < 0 || weights[i] <= 0.0f)
+        continue;
+
+      int quantized = static_cast<int>(std::round(weights[i] / totalWeight * 255.0f));
+      this->boneIDs[i] = static_cast<uint16_t>(ids[i]);
+      this->boneWeights[i] = static_cast<uint8_t>(quantized);
+      quantizedTotal += quantized;
+
+      if (this->boneWeights[i] > this->boneWeights[largest])
+        largest = i;
+    }
+
+    // Give the rounding error to the largest influence so the weights still
+    // sum to one.
+    this->boneWeights[largest] = static_cast<uint8_t>(this->boneWeights[largest] + 255 - quantizedTotal);
+  }
+
+  //----------------------------------------------------------------------------
+  // Mesh here.
+  //----------------------------------------------------------------------------
   Mesh::Mesh(const std::string &name, Model* parent)
     : loaded(false)
     , name(name)
@@ -31,15 +127,90 @@ namespace Strontium
       return;
 
     this->vArray = createUnique<VertexArray>(this->data.data(), this->data.size() * sizeof(Vertex), BufferType::Dynamic);
-    this->vArray->addIndexBuffer(this->indices.data(), this->indices.size(), BufferType::Dynamic);
+    // Only the full detail mesh, the standalone VAO has no use for the LODs.
+    this->vArray->addIndexBuffer(this->indices.data(), this->getLOD(0).numIndices, BufferType::Dynamic);
+
+    for (auto& attribute : getVertexAttributes())
+    {
+      this->vArray->addAttribute(attribute.location, attribute.type, attribute.normalized,
+                                 sizeof(Vertex), attribute.offset);
+    }
+  }
 
-    this->vArray->addAttribute(0, AttribType::Vec4, false, sizeof(Vertex), 0);
-  	this->vArray->addAttribute(1, AttribType::Vec3, false, sizeof(Vertex), offsetof(Vertex, normal));
-    this->vArray->addAttribute(2, AttribType::Vec2, false, sizeof(Vertex), offsetof(Vertex, uv));
-    this->vArray->addAttribute(3, AttribType::Vec3, false, sizeof(Vertex), offsetof(Vertex, tangent));
-    this->vArray->addAttribute(4, AttribType::Vec3, false, sizeof(Vertex), offsetof(Vertex, bitangent));
+  MeshLOD
+  Mesh::getLOD(uint lod)
+  {
+    if (this->lods.empty())
+      return { 0, static_cast<uint>(this->indices.size()), 0.0f };
+
+    return this->lods[std::min<uint>(lod, this->lods.size() - 1)];
+  }
+
+  void
+  Mesh::uploadToArena(GeometryArena &arena)
+  {
+    if (!this->isLoaded())
+      return;
 
-    this->vArray->addAttribute(5, AttribType::Vec4, false, sizeof(Vertex), offsetof(Vertex, boneWeights));
-    this->vArray->addAttribute(6, AttribType::IVec4, false, sizeof(Vertex), offsetof(Vertex, boneIDs));
+    this->arenaAllocation = arena.allocate(this->data.data(), this->data.size(),
+                                           this->indices.data(), this->indices.size(),
+                                           this->skinData.empty() ? nullptr : this->skinData.data());
+  }
+
+  void
+  Mesh::computeBoneBounds()
+  {
+    this->boneBounds.clear();
+
+    // Index of the bounds of each bone, -1 if the bone has none yet.
+    std::vector<int> boundsIndices;
+    auto expandBounds = [this, &boundsIndices](uint bone, uint slot, const glm::vec3 &position)
+    {
+      if (slot >= boundsIndices.size())
+        boundsIndices.resize(slot + 1, -1);
+
+      if (boundsIndices[slot] < 0)
+      {
+        boundsIndices[slot] = this->boneBounds.size();
+        this->boneBounds.push_back({ bone, position, position });
+        return;
+      }
+
+      auto& bounds = this->boneBounds[boundsIndices[slot]];
+      bounds.min = glm::min(bounds.min, position);
+      bounds.max = glm::max(bounds.max, position);
+    };
+
+    for (uint v = 0; v < this->data.size(); v++)
+    {
+      const glm::vec3 &position = this->data[v].position;
+
+      bool skinned = false;
+      for (uint i = 0; i < MAX_BONES_PER_VERTEX && v < this->skinData.size(); i++)
+      {
+        auto& skin = this->skinData[v];
+        if (skin.boneWeights[i] == 0)
+          continue;
+
+        // Unskinned vertices use the first slot.
+        uint bone = skin.boneIDs[i];
+        expandBounds(bone, bone + 1, position);
+        skinned = true;
+      }
+
+      if (!skinned)
+        expandBounds(BoneBounds::unskinnedBone, 0, position);
+    }
+  }
+
+  std::vector<VertexAttribute>
+  Mesh::getVertexAttributes()
+  {
+    return
+    {
+      { 0, AttribType::Vec3, false, offsetof(Vertex, position) },
+      { 1, AttribType::IVec4Short, false, offsetof(Vertex, frame) },
+      { 2, AttribType::Vec2Half, false, offsetof(Vertex, uv) }
+    };
   }
 }
@@ -0,0 +1,207 @@
+#include "Graphics/MeshletCulling.h"
+
+// SIMD includes. SSE2 is the baseline on x64.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define MESHLET_CULLING_USE_SSE
+  #include <immintrin.h>
+#endif
+
+namespace Strontium
+{
+  enum class MeshletCullResult
+  {
+    Visible,
+    OutsideFrustum,
+    BackFacing
+  };
+
+  MeshletCullView
+  buildMeshletCullView(const glm::mat4 &transform, const Frustum* frustums,
+                       uint numFrustums, const glm::vec4 &viewpoint,
+                       bool coneCulling)
+  {
+    MeshletCullView view;
+    view.numFrustums = std::min<uint>(numFrustums, MESHLET_CULL_MAX_FRUSTUMS);
+    view.coneCulling = coneCulling;
+
+    // dot(n, M * x) - d = dot(M^T * n, x) - (d - dot(n, t)) for the linear
+    // part M and translation t of the transform.
+    glm::mat3 linearTranspose = glm::transpose(glm::mat3(transform));
+    glm::vec3 translation = glm::vec3(transform[3]);
+    for (uint f = 0; f < view.numFrustums; f++)
+    {
+      for (uint p = 0; p < 6; p++)
+      {
+        const Plane &plane = frustums[f].sides[p];
+        glm::vec3 normal = linearTranspose * plane.normal;
+        float distance = plane.d - glm::dot(plane.normal, translation);
+
+        // A singular transform gets a plane everything is in front of.
+        float length = glm::length(normal);
+        view.planes[6 * f + p] = length > 0.0f ? glm::vec4(normal, distance) / length
+                                                : glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+      }
+    }
+
+    glm::mat4 inverse = glm::inverse(transform);
+    if (viewpoint.w != 0.0f)
+    {
+      glm::vec3 position = glm::vec3(inverse * glm::vec4(glm::vec3(viewpoint), 1.0f));
+      view.viewpoint = glm::vec4(position, 1.0f);
+    }
+    else
+    {
+      glm::vec3 direction = glm::vec3(inverse * glm::vec4(glm::vec3(viewpoint), 0.0f));
+      view.viewpoint = glm::vec4(-glm::normalize(direction), 0.0f);
+    }
+
+    return view;
+  }
+
+  static MeshletCullResult
+  testMeshlet(const Meshlet &meshlet, const MeshletCullView &view)
+  {
+    glm::vec3 center = glm::vec3(meshlet.sphere);
+    float radius = meshlet.sphere.w;
+
+    if (view.numFrustums > 0)
+    {
+      bool inside = false;
+      for (uint f = 0; f < view.numFrustums && !inside; f++)
+      {
+        bool inFrustum = true;
+        for (uint p = 0; p < 6; p++)
+        {
+          const glm::vec4 &plane = view.planes[6 * f + p];
+          inFrustum = inFrustum && glm::dot(glm::vec3(plane), center) - plane.w >= -radius;
+        }
+        inside = inFrustum;
+      }
+
+      if (!inside)
+        return MeshletCullResult::OutsideFrustum;
+    }
+
+    if (view.coneCulling)
+    {
+      glm::vec3 d = center * view.viewpoint.w - glm::vec3(view.viewpoint);
+      float cutoff = meshlet.cone.w;
+      if (glm::dot(d, glm::vec3(meshlet.cone)) > cutoff * glm::length(d) + radius * view.viewpoint.w)
+        return MeshletCullResult::BackFacing;
+    }
+
+    return MeshletCullResult::Visible;
+  }
+
+  // Extend the last run if the meshlet follows it.
+  static inline void
+  appendMeshlet(std::vector<MeshletRun> &runs, const Meshlet &meshlet)
+  {
+    if (!runs.empty() && runs.back().firstIndex + runs.back().numIndices == meshlet.firstIndex)
+      runs.back().numIndices += meshlet.numIndices;
+    else
+      runs.push_back({ meshlet.firstIndex, meshlet.numIndices });
+  }
+
+  void
+  cullMeshlets(const std::vector<Meshlet> &meshlets, const MeshletCullView &view,
+               std::vector<MeshletRun> &outRuns, uint &outFrustumCulled,
+               uint &outConeCulled)
+  {
+    outRuns.clear();
+
+    uint numMeshlets = meshlets.size();
+    uint i = 0;
+
+  #if defined(MESHLET_CULLING_USE_SSE)
+    __m128 allOnes = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    __m128 viewpointX = _mm_set1_ps(view.viewpoint.x);
+    __m128 viewpointY = _mm_set1_ps(view.viewpoint.y);
+    __m128 viewpointZ = _mm_set1_ps(view.viewpoint.z);
+    __m128 viewpointW = _mm_set1_ps(view.viewpoint.w);
+
+    for (; i + 4 <= numMeshlets; i += 4)
+    {
+      // Transpose the bounds of four meshlets into x, y, z and w registers.
+      __m128 centerX = _mm_loadu_ps(&meshlets[i].sphere.x);
+      __m128 centerY = _mm_loadu_ps(&meshlets[i + 1].sphere.x);
+      __m128 centerZ = _mm_loadu_ps(&meshlets[i + 2].sphere.x);
+      __m128 radius = _mm_loadu_ps(&meshlets[i + 3].sphere.x);
+      _MM_TRANSPOSE4_PS(centerX, centerY, centerZ, radius);
+
+      __m128 inside = allOnes;
+      if (view.numFrustums > 0)
+      {
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+        inside = _mm_setzero_ps();
+        for (uint f = 0; f < view.numFrustums; f++)
+        {
+          __m128 inFrustum = allOnes;
+          for (uint p = 0; p < 6; p++)
+          {
+            const glm::vec4 &plane = view.planes[6 * f + p];
+            __m128 distance = _mm_sub_ps(_mm_add_ps(_mm_add_ps(
+                                         _mm_mul_ps(_mm_set1_ps(plane.x), centerX),
+                                         _mm_mul_ps(_mm_set1_ps(plane.y), centerY)),
+                                         _mm_mul_ps(_mm_set1_ps(plane.z), centerZ)),
+                                         _mm_set1_ps(plane.w));
+            inFrustum = _mm_and_ps(inFrustum, _mm_cmpge_ps(distance, negRadius));
+          }
+          inside = _mm_or_ps(inside, inFrustum);
+        }
+      }
+
+      __m128 backFacing = _mm_setzero_ps();
+      if (view.coneCulling)
+      {
+        __m128 axisX = _mm_loadu_ps(&meshlets[i].cone.x);
+        __m128 axisY = _mm_loadu_ps(&meshlets[i + 1].cone.x);
+        __m128 axisZ = _mm_loadu_ps(&meshlets[i + 2].cone.x);
+        __m128 cutoff = _mm_loadu_ps(&meshlets[i + 3].cone.x);
+        _MM_TRANSPOSE4_PS(axisX, axisY, axisZ, cutoff);
+
+        __m128 dX = _mm_sub_ps(_mm_mul_ps(centerX, viewpointW), viewpointX);
+        __m128 dY = _mm_sub_ps(_mm_mul_ps(centerY, viewpointW), viewpointY);
+        __m128 dZ = _mm_sub_ps(_mm_mul_ps(centerZ, viewpointW), viewpointZ);
+
+        __m128 dotAxis = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dX, axisX), _mm_mul_ps(dY, axisY)),
+                                    _mm_mul_ps(dZ, axisZ));
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dX, dX), _mm_mul_ps(dY, dY)),
+                                               _mm_mul_ps(dZ, dZ)));
+        __m128 limit = _mm_add_ps(_mm_mul_ps(cutoff, length), _mm_mul_ps(radius, viewpointW));
+        backFacing = _mm_cmpgt_ps(dotAxis, limit);
+      }
+
+      uint insideBits = static_cast<uint>(_mm_movemask_ps(inside));
+      uint backFacingBits = static_cast<uint>(_mm_movemask_ps(backFacing));
+      for (uint k = 0; k < 4; k++)
+      {
+        if (!((insideBits >> k) & 1u))
+          outFrustumCulled++;
+        else if ((backFacingBits >> k) & 1u)
+          outConeCulled++;
+        else
+          appendMeshlet(outRuns, meshlets[i + k]);
+      }
+    }
+  #endif
+
+    // Scalar path for the remaining meshlets (or everything, without SIMD).
+    for (; i < numMeshlets; i++)
+    {
+      switch (testMeshlet(meshlets[i], view))
+      {
+        case MeshletCullResult::OutsideFrustum:
+          outFrustumCulled++;
+          break;
+        case MeshletCullResult::BackFacing:
+          outConeCulled++;
+          break;
+        default:
+          appendMeshlet(outRuns, meshlets[i]);
+          break;
+      }
+    }
+  }
+}
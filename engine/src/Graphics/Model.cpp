@@ -3,6 +3,9 @@
 // Project includes.
 #include "Core/Logs.h"
 #include "Core/Events.h"
+#include "Core/ThreadPool.h"
+#include "Graphics/ModelCache.h"
+#include "Graphics/MeshOptimizer.h"
 #include "Utils/AssimpUtilities.h"
 
 // GLM stuff.
@@ -13,6 +16,10 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+// STL includes.
+#include <sstream>
+#include <iomanip>
+
 namespace Strontium
 {
   Model::Model()
@@ -32,6 +39,17 @@ namespace Strontium
     auto eventDispatcher = EventDispatcher::getInstance();
     eventDispatcher->queueEvent(new GuiEvent(GuiEventType::StartSpinnerEvent, filepath));
 
+    // Cooked models skip the import entirely.
+    if (ModelCache::load(*this, filepath))
+    {
+      this->filepath = filepath;
+      this->loaded = true;
+
+      eventDispatcher->queueEvent(new GuiEvent(GuiEventType::EndSpinnerEvent, ""));
+      logs->logMessage(LogMessage("Model loaded from cooked model at path " + filepath));
+      return;
+    }
+
     auto flags = aiProcess_CalcTangentSpace | aiProcess_GenNormals
                | aiProcess_JoinIdenticalVertices | aiProcess_Triangulate
                | aiProcess_GenUVCoords | aiProcess_SortByPType;
@@ -71,7 +89,11 @@ namespace Strontium
     for (uint i = 0; i < scene->mRootNode->mNumChildren; i++)
       this->rootNode.childNames.emplace_back(scene->mRootNode->mChildren[i]->mName.C_Str());
     
-    this->processNode(scene->mRootNode, scene, directory);
+    // Gather the meshes in node order, then convert them in parallel.
+    std::vector<aiMesh*> meshes;
+    this->processNode(scene->mRootNode, scene, meshes);
+    this->processMeshes(meshes, scene, directory);
+    this->skeleton.build(*this);
 
     // Load in animations.
     if (scene->HasAnimations())
@@ -82,6 +104,9 @@ namespace Strontium
 
     this->loaded = true;
 
+    // Cook the model so the next load can skip the import.
+    ModelCache::save(*this, filepath);
+
     eventDispatcher->queueEvent(new GuiEvent(GuiEventType::EndSpinnerEvent, ""));
     logs->logMessage(LogMessage("Model loaded at path " + filepath));
   }
@@ -92,9 +117,10 @@ namespace Strontium
 
   }
 
-  // Recursively process all the nodes in the mesh.
+  // Recursively process all the nodes in the mesh, gathering the meshes they
+  // reference.
   void
-  Model::processNode(aiNode* node, const aiScene* scene, const std::string &directory)
+  Model::processNode(aiNode* node, const aiScene* scene, std::vector<aiMesh*> &outMeshes)
   {
     if (this->sceneNodes.find(node->mName.C_Str()) == this->sceneNodes.end())
     {
@@ -104,237 +130,219 @@ namespace Strontium
     }
 
     for (uint i = 0; i < node->mNumMeshes; i++)
-    {
-      aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-      this->processMesh(mesh, scene, directory);
-    }
+      outMeshes.emplace_back(scene->mMeshes[node->mMeshes[i]]);
 
     for (uint i = 0; i < node->mNumChildren; i++)
-      this->processNode(node->mChildren[i], scene, directory);
+      this->processNode(node->mChildren[i], scene, outMeshes);
   }
 
-  // Process each individual mesh.
+  // Convert the gathered meshes into preallocated submeshes on the thread
+  // pool.
   void
-  Model::processMesh(aiMesh* mesh, const aiScene* scene, const std::string &directory)
+  Model::processMeshes(const std::vector<aiMesh*> &meshes, const aiScene* scene,
+                       const std::string &directory)
   {
-    std::string meshName = std::string(mesh->mName.C_Str());
-    this->subMeshes.emplace_back(meshName, this);
-    auto& meshVertices = this->subMeshes.back().getData();
-    auto& meshIndicies = this->subMeshes.back().getIndices();
-
-    auto& meshMin = this->subMeshes.back().getMinPos();
-    auto& meshMax = this->subMeshes.back().getMaxPos();
-    meshMin = glm::vec3(std::numeric_limits<float>::max());
-    meshMax = glm::vec3(std::numeric_limits<float>::min());
-
-    auto& materialInfo = this->subMeshes.back().getMaterialInfo();
-
-    // Get the positions.
-    if (mesh->HasPositions())
+    // Merge the bones serially in mesh order first, so bone indices don't
+    // depend on the order the meshes finish in. The conversion jobs only read
+    // the bone map.
+    for (auto mesh : meshes)
     {
-      meshVertices.reserve(mesh->mNumVertices);
-
-      for (uint i = 0; i < mesh->mNumVertices; i++)
-        meshVertices.emplace_back();
+      if (!mesh->HasPositions())
+        continue;
 
-      for (uint i = 0; i < mesh->mNumVertices; i++)
+      for (uint i = 0; i < mesh->mNumBones; i++)
       {
-        meshVertices[i].position.x = mesh->mVertices[i].x;
-        meshVertices[i].position.y = mesh->mVertices[i].y;
-        meshVertices[i].position.z = mesh->mVertices[i].z;
-        meshVertices[i].position.w = 1.0f;
+        std::string boneName = mesh->mBones[i]->mName.C_Str();
+        if (this->boneMap.find(boneName) != this->boneMap.end())
+          continue;
 
-        meshMin = glm::min(meshMin, glm::vec3(meshVertices[i].position));
-        meshMax = glm::max(meshMax, glm::vec3(meshVertices[i].position));
+        this->storedBones.emplace_back(boneName, mesh->mName.C_Str(),
+                                       Utilities::mat4ToGLM(mesh->mBones[i]->mOffsetMatrix));
+        this->boneMap[boneName] = this->storedBones.size() - 1;
       }
     }
-    else
-    {
-      // Nothing that can be done for this mesh as it has no data.
-      return;
-    }
-    this->minPos = glm::min(this->minPos, meshMin);
-    this->maxPos = glm::max(this->maxPos, meshMax);
 
-    if (mesh->HasNormals())
-    {
-      for (uint i = 0; i < mesh->mNumVertices; i++)
-      {
-        meshVertices[i].normal.x = mesh->mNormals[i].x;
-        meshVertices[i].normal.y = mesh->mNormals[i].y;
-        meshVertices[i].normal.z = mesh->mNormals[i].z;
-      }
-    }
+    this->subMeshes.reserve(this->subMeshes.size() + meshes.size());
+    uint firstSubmesh = this->subMeshes.size();
+    for (auto mesh : meshes)
+      this->subMeshes.emplace_back(mesh->mName.C_Str(), this);
 
-    // Get the UV's, but only supporting a single UV channel for now.
-    if (mesh->mTextureCoords[0])
-    {
-      // Loop over the texture coords and assign them.
-      for (uint i = 0; i < mesh->mNumVertices; i++)
-      {
-        meshVertices[i].uv.x = mesh->mTextureCoords[0][i].x;
-        meshVertices[i].uv.y = mesh->mTextureCoords[0][i].y;
-      }
-    }
-    else
+    // The submeshes are reordered for the vertex cache and overdraw, and get
+    // their LOD chains and meshlets, as part of the conversion job.
+    std::vector<VertexCacheStats> statsBefore(meshes.size());
+    std::vector<VertexCacheStats> statsAfter(meshes.size());
+
+    auto workerGroup = ThreadPool::getInstance();
+    workerGroup->parallelFor(meshes.size(), [this, &meshes, scene, &directory, firstSubmesh,
+                                             &statsBefore, &statsAfter](uint start, uint end)
     {
-      for (uint i = 0; i < mesh->mNumVertices; i++)
+      for (uint i = start; i < end; i++)
       {
-        meshVertices[i].uv = glm::vec2(0.0f);
+        auto& submesh = this->subMeshes[firstSubmesh + i];
+        this->processMesh(meshes[i], scene, directory, submesh);
+        if (!submesh.isLoaded())
+          continue;
+
+        MeshOptimizer::optimizeMesh(submesh, statsBefore[i], statsAfter[i]);
+        MeshOptimizer::buildLODs(submesh);
+        MeshOptimizer::buildMeshlets(submesh);
       }
-    }
+    });
 
-    // Fetch the tangents and bitangents.
-    if (mesh->HasTangentsAndBitangents())
+    VertexCacheStats totalBefore, totalAfter;
+    for (uint i = 0; i < meshes.size(); i++)
     {
-      for (uint i = 0; i <mesh->mNumVertices; i++)
-      {
-        meshVertices[i].tangent.x = mesh->mTangents[i].x;
-        meshVertices[i].tangent.y = mesh->mTangents[i].y;
-        meshVertices[i].tangent.z = mesh->mTangents[i].z;
-
-        meshVertices[i].bitangent.x = mesh->mBitangents[i].x;
-        meshVertices[i].bitangent.y = mesh->mBitangents[i].y;
-        meshVertices[i].bitangent.z = mesh->mBitangents[i].z;
-      }
+      totalBefore += statsBefore[i];
+      totalAfter += statsAfter[i];
     }
 
-    // Fetch the indicies.
-    meshIndicies.reserve(mesh->mNumFaces * 3);
-    for (uint i = 0; i < mesh->mNumFaces; i++)
+    if (totalBefore.numTriangles > 0)
     {
-      aiFace face = mesh->mFaces[i];
-
-      for (uint j = 0; j < face.mNumIndices; j++)
-        meshIndicies.push_back(face.mIndices[j]);
+      std::stringstream stream;
+      stream << std::fixed << std::setprecision(3)
+             << "Optimized " << totalBefore.numTriangles << " triangles of " << this->filepath
+             << ", ACMR " << totalBefore.getACMR() << " -> " << totalAfter.getACMR()
+             << ", ATVR " << totalBefore.getATVR() << " -> " << totalAfter.getATVR();
+      Logger::getInstance()->logMessage(LogMessage(stream.str()));
     }
 
-    // Load in the data required to async load material properties.
-    if (mesh->mMaterialIndex >= 0)
+    for (uint i = firstSubmesh; i < this->subMeshes.size(); i++)
     {
-      aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-
-      aiTextureType type = aiTextureType_DIFFUSE;
-      aiString str;
-      for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-      {
-        mat->GetTexture(type, i, &str);
-        materialInfo.albedoTexturePath = directory + "/" + str.C_Str();
-
-        for (unsigned int i = 0; i < materialInfo.albedoTexturePath.size(); i++)
-          if (materialInfo.albedoTexturePath[i] == '\\')
-            materialInfo.albedoTexturePath[i] = '/';
-      }
+      if (!this->subMeshes[i].isLoaded())
+        continue;
 
-      type = aiTextureType_SPECULAR;
-      for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-      {
-        mat->GetTexture(type, i, &str);
-        materialInfo.specularTexturePath = directory + "/" + str.C_Str();
-
-        for (unsigned int i = 0; i < materialInfo.specularTexturePath.size(); i++)
-          if (materialInfo.specularTexturePath[i] == '\\')
-            materialInfo.specularTexturePath[i] = '/';
-      }
+      this->minPos = glm::min(this->minPos, this->subMeshes[i].getMinPos());
+      this->maxPos = glm::max(this->maxPos, this->subMeshes[i].getMaxPos());
+    }
+  }
 
-      type = aiTextureType_NORMALS;
-      for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-      {
-        mat->GetTexture(type, i, &str);
-        materialInfo.normalTexturePath = directory + "/" + str.C_Str();
+  // Fetch the path of the last texture of a type, with forward slashes.
+  static void
+  getTexturePath(aiMaterial* material, aiTextureType type, const std::string &directory,
+                 std::string &outPath)
+  {
+    uint numTextures = material->GetTextureCount(type);
+    if (numTextures == 0)
+      return;
 
-        for (unsigned int i = 0; i < materialInfo.normalTexturePath.size(); i++)
-          if (materialInfo.normalTexturePath[i] == '\\')
-            materialInfo.normalTexturePath[i] = '/';
-      }
+    aiString str;
+    material->GetTexture(type, numTextures - 1, &str);
+    outPath = directory + "/" + str.C_Str();
+    std::replace(outPath.begin(), outPath.end(), '\\', '/');
+  }
 
-      type = aiTextureType_BASE_COLOR;
-      for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-      {
-        mat->GetTexture(type, i, &str);
-        materialInfo.albedoTexturePath = directory + "/" + str.C_Str();
+  // Process each individual mesh. Only writes to the submesh, so meshes can be
+  // processed concurrently.
+  void
+  Model::processMesh(aiMesh* mesh, const aiScene* scene, const std::string &directory,
+                     Mesh &outMesh)
+  {
+    auto& meshVertices = outMesh.getData();
+    auto& meshIndicies = outMesh.getIndices();
 
-        for (unsigned int i = 0; i < materialInfo.albedoTexturePath.size(); i++)
-          if (materialInfo.albedoTexturePath[i] == '\\')
-            materialInfo.albedoTexturePath[i] = '/';
-      }
+    auto& meshMin = outMesh.getMinPos();
+    auto& meshMax = outMesh.getMaxPos();
+    meshMin = glm::vec3(std::numeric_limits<float>::max());
+    meshMax = glm::vec3(std::numeric_limits<float>::min());
 
-      type = aiTextureType_METALNESS;
-      for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-      {
-        mat->GetTexture(type, i, &str);
-        materialInfo.metallicTexturePath = directory + "/" + str.C_Str();
+    auto& materialInfo = outMesh.getMaterialInfo();
 
-        for (unsigned int i = 0; i < materialInfo.metallicTexturePath.size(); i++)
-          if (materialInfo.metallicTexturePath[i] == '\\')
-            materialInfo.metallicTexturePath[i] = '/';
-      }
+    // Nothing that can be done for this mesh if it has no data.
+    if (!mesh->HasPositions())
+      return;
 
-      type = aiTextureType_DIFFUSE_ROUGHNESS;
-      for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-      {
-        mat->GetTexture(type, i, &str);
-        materialInfo.roughnessTexturePath = directory + "/" + str.C_Str();
+    // Copy the vertex attributes in a single pass.
+    meshVertices.resize(mesh->mNumVertices);
+    bool hasNormals = mesh->HasNormals();
+    bool hasUVs = mesh->mTextureCoords[0] != nullptr;
+    bool hasTangents = mesh->HasTangentsAndBitangents();
+    for (uint i = 0; i < mesh->mNumVertices; i++)
+    {
+      auto& vertex = meshVertices[i];
+      vertex.position = Utilities::vec3ToGLM(mesh->mVertices[i]);
+
+      meshMin = glm::min(meshMin, vertex.position);
+      meshMax = glm::max(meshMax, vertex.position);
+
+      glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);
+      glm::vec3 tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+      if (hasNormals)
+        normal = Utilities::vec3ToGLM(mesh->mNormals[i]);
+      if (hasTangents)
+        tangent = Utilities::vec3ToGLM(mesh->mTangents[i]);
+      glm::vec3 bitangent = hasTangents ? Utilities::vec3ToGLM(mesh->mBitangents[i])
+                                        : glm::cross(normal, tangent);
+      vertex.setFrame(normal, tangent, bitangent);
+
+      // Only supporting a single UV channel for now.
+      if (hasUVs)
+        vertex.setUV(Utilities::vec2ToGLM(mesh->mTextureCoords[0][i]));
+    }
 
-        for (unsigned int i = 0; i < materialInfo.roughnessTexturePath.size(); i++)
-          if (materialInfo.roughnessTexturePath[i] == '\\')
-            materialInfo.roughnessTexturePath[i] = '/';
-      }
+    // Fetch the indicies.
+    meshIndicies.reserve(mesh->mNumFaces * 3);
+    for (uint i = 0; i < mesh->mNumFaces; i++)
+    {
+      const aiFace &face = mesh->mFaces[i];
+      meshIndicies.insert(meshIndicies.end(), face.mIndices, face.mIndices + face.mNumIndices);
+    }
 
-      type = aiTextureType_AMBIENT_OCCLUSION;
-      for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-      {
-        mat->GetTexture(type, i, &str);
-        materialInfo.aoTexturePath = directory + "/" + str.C_Str();
+    // Load in the data required to async load material properties. Base
+    // colour textures take priority over diffuse textures.
+    if (mesh->mMaterialIndex < scene->mNumMaterials)
+    {
+      aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
 
-        for (unsigned int i = 0; i < materialInfo.aoTexturePath.size(); i++)
-          if (materialInfo.aoTexturePath[i] == '\\')
-            materialInfo.aoTexturePath[i] = '/';
-      }
+      getTexturePath(mat, aiTextureType_DIFFUSE, directory, materialInfo.albedoTexturePath);
+      getTexturePath(mat, aiTextureType_SPECULAR, directory, materialInfo.specularTexturePath);
+      getTexturePath(mat, aiTextureType_NORMALS, directory, materialInfo.normalTexturePath);
+      getTexturePath(mat, aiTextureType_BASE_COLOR, directory, materialInfo.albedoTexturePath);
+      getTexturePath(mat, aiTextureType_METALNESS, directory, materialInfo.metallicTexturePath);
+      getTexturePath(mat, aiTextureType_DIFFUSE_ROUGHNESS, directory, materialInfo.roughnessTexturePath);
+      getTexturePath(mat, aiTextureType_AMBIENT_OCCLUSION, directory, materialInfo.aoTexturePath);
     }
 
-    // Load in vertex bones.
+    // Load in vertex bones. The bones were merged into the bone map up front.
+    // Influences are gathered at full precision and quantized into the skin
+    // stream afterwards.
     if (mesh->HasBones())
     {
+      std::vector<glm::ivec4> boneIDs(mesh->mNumVertices, glm::ivec4(-1));
+      std::vector<glm::vec4> boneWeights(mesh->mNumVertices, glm::vec4(0.0f));
       for (unsigned int i = 0; i < mesh->mNumBones; i++)
       {
-        std::string boneName = mesh->mBones[i]->mName.C_Str();
-        glm::mat4 offsetMatrix = Utilities::mat4ToGLM(mesh->mBones[i]->mOffsetMatrix);
-
-        unsigned int boneIndex;
-        if (this->boneMap.find(boneName) == this->boneMap.end())
-        {
-          this->storedBones.emplace_back(boneName, meshName, offsetMatrix);
-          this->boneMap[boneName] = this->storedBones.size() - 1;
-          boneIndex = this->storedBones.size() - 1;
-        }
-        else
-        {
-          boneIndex = this->boneMap.at(boneName);
-        }
+        unsigned int boneIndex = this->boneMap.at(mesh->mBones[i]->mName.C_Str());
 
         for (unsigned int j = 0; j < mesh->mBones[i]->mNumWeights; j++)
         {
           unsigned int vertexIndex = mesh->mBones[i]->mWeights[j].mVertexId;
           float weight = mesh->mBones[i]->mWeights[j].mWeight;
 
-          this->addBoneData(boneIndex, weight, meshVertices[vertexIndex]);
+          this->addBoneData(boneIndex, weight, boneIDs[vertexIndex], boneWeights[vertexIndex]);
         }
       }
+
+      auto& skinData = outMesh.getSkinData();
+      skinData.resize(mesh->mNumVertices);
+      for (uint i = 0; i < mesh->mNumVertices; i++)
+        skinData[i].setInfluences(boneIDs[i], boneWeights[i]);
+
+      outMesh.computeBoneBounds();
     }
 
-    this->subMeshes.back().setLoaded(true);
+    outMesh.setLoaded(true);
   }
 
   void
-  Model::addBoneData(unsigned int boneIndex, float boneWeight, Vertex &toMod)
+  Model::addBoneData(unsigned int boneIndex, float boneWeight, glm::ivec4 &boneIDs,
+                     glm::vec4 &boneWeights)
   {
     for (unsigned int i = 0; i < MAX_BONES_PER_VERTEX; i++)
     {
-      if (toMod.boneIDs[i] < 0)
+      if (boneIDs[i] < 0)
       {
-        toMod.boneWeights[i] = boneWeight;
-        toMod.boneIDs[i] = boneIndex;
+        boneWeights[i] = boneWeight;
+        boneIDs[i] = boneIndex;
         return;
       }
     }
@@ -0,0 +1,732 @@
+#include "Graphics/ModelCache.h"
+
+// Project includes.
+#include "Core/Logs.h"
+#include "Graphics/Model.h"
+
+// STL includes.
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+
+// Platform includes for memory mapping.
+#ifdef WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #define NOMINMAX
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace Strontium
+{
+  //----------------------------------------------------------------------------
+  // Memory mapped files.
+  //----------------------------------------------------------------------------
+  // A read only mapping of an entire file.
+  class MappedFile
+  {
+  public:
+    MappedFile(const std::string &filepath);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* getData() const { return this->data; }
+    uint64_t getSize() const { return this->size; }
+    bool isMapped() const { return this->data != nullptr; }
+  private:
+    const uint8_t* data;
+    uint64_t size;
+  #ifdef WIN32
+    HANDLE file;
+    HANDLE mapping;
+  #endif
+  };
+
+  MappedFile::MappedFile(const std::string &filepath)
+    : data(nullptr)
+    , size(0)
+  #ifdef WIN32
+    , file(INVALID_HANDLE_VALUE)
+    , mapping(nullptr)
+  #endif
+  {
+  #ifdef WIN32
+    this->file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (this->file == INVALID_HANDLE_VALUE)
+      return;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(this->file, &fileSize) || fileSize.QuadPart == 0)
+      return;
+
+    this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!this->mapping)
+      return;
+
+    this->data = static_cast<const uint8_t*>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+    if (this->data)
+      this->size = static_cast<uint64_t>(fileSize.QuadPart);
+  #else
+    int descriptor = open(filepath.c_str(), O_RDONLY);
+    if (descriptor < 0)
+      return;
+
+    struct stat fileStats;
+    if (fstat(descriptor, &fileStats) == 0 && fileStats.st_size > 0)
+    {
+      void* mapped = mmap(nullptr, fileStats.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if (mapped != MAP_FAILED)
+      {
+        this->data = static_cast<const uint8_t*>(mapped);
+        this->size = static_cast<uint64_t>(fileStats.st_size);
+      }
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    close(descriptor);
+  #endif
+  }
+
+  MappedFile::~MappedFile()
+  {
+  #ifdef WIN32
+    if (this->data)
+      UnmapViewOfFile(this->data);
+    if (this->mapping)
+      CloseHandle(this->mapping);
+    if (this->file != INVALID_HANDLE_VALUE)
+      CloseHandle(this->file);
+  #else
+    if (this->data)
+      munmap(const_cast<uint8_t*>(this->data), this->size);
+  #endif
+  }
+
+  //----------------------------------------------------------------------------
+  // Source file identification.
+  //----------------------------------------------------------------------------
+  static bool
+  getSourceStamp(const std::string &filepath, uint64_t &outSize, int64_t &outTimestamp)
+  {
+    std::error_code error;
+    outSize = std::filesystem::file_size(filepath, error);
+    if (error)
+      return false;
+
+    auto writeTime = std::filesystem::last_write_time(filepath, error);
+    if (error)
+      return false;
+
+    outTimestamp = static_cast<int64_t>(writeTime.time_since_epoch().count());
+    return true;
+  }
+
+  // 64 bit FNV-1a hash of the contents of a file.
+  static bool
+  hashFile(const std::string &filepath, uint64_t &outHash)
+  {
+    MappedFile file(filepath);
+    if (!file.isMapped())
+      return false;
+
+    outHash = 14695981039346656037ull;
+    const uint8_t* bytes = file.getData();
+    for (uint64_t i = 0; i < file.getSize(); i++)
+    {
+      outHash ^= bytes[i];
+      outHash *= 1099511628211ull;
+    }
+
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Cooked model layout.
+  //----------------------------------------------------------------------------
+  // The header is followed by the sections, each aligned to cacheAlignment.
+  // Every section is a tightly packed array of a single type. Everything else
+  // refers to elements of a section by ranges.
+  static constexpr uint32_t cacheMagic = 0x534D5253; // "SRMS"
+  static constexpr uint64_t cacheAlignment = 16;
+
+  enum class CacheSection : uint32_t
+  {
+    Strings = 0,    // char
+    Submeshes,      // CookedSubmesh
+    Vertices,       // Vertex
+    SkinVertices,   // VertexSkin
+    Indices,        // uint
+    LODs,           // MeshLOD
+    Meshlets,       // Meshlet
+    BoneBounds,     // BoneBounds
+    Bones,          // CookedBone
+    Nodes,          // CookedNode
+    NodeChildren,   // CookedString
+    Animations,     // CookedAnimation
+    AnimatedNodes,  // CookedString
+    Tracks,         // AnimationTrack
+    NodeTracks,     // int
+    KeyTimes,       // float
+    Vec3Keys,       // QuantizedVec3
+    QuatKeys,       // QuantizedQuat
+    FullVec3Keys,   // glm::vec3
+    Count
+  };
+  static constexpr uint numCacheSections = static_cast<uint>(CacheSection::Count);
+
+  struct CookedRange
+  {
+    uint32_t start;
+    uint32_t count;
+  };
+
+  // A range of the string section.
+  using CookedString = CookedRange;
+
+  struct CookedSection
+  {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct CookedHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t rootNode;
+
+    // The source file this was cooked from.
+    uint64_t sourceSize;
+    int64_t sourceTimestamp;
+    uint64_t sourceHash;
+
+    glm::mat4 globalInverseTransform;
+    glm::vec3 minPos;
+    glm::vec3 maxPos;
+
+    CookedSection sections[numCacheSections];
+  };
+
+  struct CookedSubmesh
+  {
+    CookedString name;
+    CookedRange vertices;
+    CookedRange skinVertices;
+    CookedRange indices;
+    CookedRange lods;
+    CookedRange meshlets;
+    CookedRange boneBounds;
+    glm::vec3 minPos;
+    glm::vec3 maxPos;
+
+    CookedString albedoTexturePath;
+    CookedString roughnessTexturePath;
+    CookedString metallicTexturePath;
+    CookedString aoTexturePath;
+    CookedString specularTexturePath;
+    CookedString normalTexturePath;
+
+    uint32_t loaded;
+  };
+
+  struct CookedBone
+  {
+    CookedString name;
+    CookedString parentMesh;
+    glm::mat4 offsetMatrix;
+  };
+
+  struct CookedNode
+  {
+    CookedString name;
+    CookedRange children;
+    glm::mat4 localTransform;
+  };
+
+  struct CookedAnimation
+  {
+    CookedString name;
+    float duration;
+    float ticksPerSecond;
+    uint32_t rawKeyframeMemory;
+
+    CookedRange animatedNodes;
+    CookedRange tracks;
+    CookedRange nodeTracks;
+    CookedRange translationTimes;
+    CookedRange translationKeys;
+    CookedRange rotationTimes;
+    CookedRange rotationKeys;
+    CookedRange scaleTimes;
+    CookedRange scaleKeys;
+    CookedRange fullTranslationKeys;
+    CookedRange fullScaleKeys;
+  };
+
+  static inline uint64_t
+  alignCacheOffset(uint64_t offset)
+  {
+    return (offset + cacheAlignment - 1) & ~(cacheAlignment - 1);
+  }
+
+  // Collects the sections of a cooked model before writing it out.
+  class CacheWriter
+  {
+  public:
+    template <typename T>
+    CookedRange append(CacheSection section, const T* elements, uint count)
+    {
+      auto& bytes = this->sections[static_cast<uint>(section)];
+      CookedRange range = { static_cast<uint32_t>(bytes.size() / sizeof(T)), count };
+
+      auto first = reinterpret_cast<const uint8_t*>(elements);
+      bytes.insert(bytes.end(), first, first + count * sizeof(T));
+      return range;
+    }
+
+    template <typename T>
+    CookedRange append(CacheSection section, const std::vector<T> &elements)
+    {
+      return this->append(section, elements.data(), elements.size());
+    }
+
+    CookedString addString(const std::string &string)
+    {
+      return this->append(CacheSection::Strings, string.data(), string.size());
+    }
+
+    // Writes to a temporary file first, so a reader never sees a partially
+    // written cooked model.
+    bool write(const std::string &filepath, CookedHeader &header)
+    {
+      uint64_t offset = alignCacheOffset(sizeof(CookedHeader));
+      for (uint i = 0; i < numCacheSections; i++)
+      {
+        header.sections[i].offset = offset;
+        header.sections[i].size = this->sections[i].size();
+        offset = alignCacheOffset(offset + this->sections[i].size());
+      }
+
+      std::string tempPath = filepath + ".tmp";
+      {
+        std::ofstream output(tempPath, std::ofstream::binary | std::ofstream::trunc);
+        if (!output)
+          return false;
+
+        const char padding[cacheAlignment] = { 0 };
+        output.write(reinterpret_cast<const char*>(&header), sizeof(CookedHeader));
+        uint64_t written = sizeof(CookedHeader);
+        for (uint i = 0; i < numCacheSections; i++)
+        {
+          output.write(padding, header.sections[i].offset - written);
+          output.write(reinterpret_cast<const char*>(this->sections[i].data()),
+                       this->sections[i].size());
+          written = header.sections[i].offset + header.sections[i].size;
+        }
+
+        if (!output)
+          return false;
+      }
+
+      std::error_code error;
+      std::filesystem::rename(tempPath, filepath, error);
+      if (error)
+      {
+        std::filesystem::remove(tempPath, error);
+        return false;
+      }
+
+      return true;
+    }
+  private:
+    std::vector<uint8_t> sections[numCacheSections];
+  };
+
+  // Bounds checked access to the sections of a mapped cooked model. Any out
+  // of range access marks the cooked model as invalid.
+  class CacheReader
+  {
+  public:
+    CacheReader(const MappedFile &file)
+      : file(file)
+      , header(nullptr)
+      , valid(false)
+    {
+      if (file.getSize() < sizeof(CookedHeader))
+        return;
+
+      this->header = reinterpret_cast<const CookedHeader*>(file.getData());
+      if (this->header->magic != cacheMagic || this->header->version != MODEL_CACHE_VERSION
+          || this->header->vertexStride != sizeof(Vertex))
+        return;
+
+      for (uint i = 0; i < numCacheSections; i++)
+      {
+        auto& section = this->header->sections[i];
+        if (section.offset % cacheAlignment != 0 || section.offset > file.getSize()
+            || section.size > file.getSize() - section.offset)
+          return;
+      }
+
+      this->valid = true;
+    }
+
+    template <typename T>
+    const T* get(CacheSection section, const CookedRange &range)
+    {
+      auto& info = this->header->sections[static_cast<uint>(section)];
+      if ((static_cast<uint64_t>(range.start) + range.count) * sizeof(T) > info.size)
+      {
+        this->valid = false;
+        return nullptr;
+      }
+
+      return reinterpret_cast<const T*>(this->file.getData() + info.offset) + range.start;
+    }
+
+    template <typename T>
+    void getVector(CacheSection section, const CookedRange &range, std::vector<T> &outVector)
+    {
+      const T* elements = this->get<T>(section, range);
+      if (elements)
+        outVector.assign(elements, elements + range.count);
+      else
+        outVector.clear();
+    }
+
+    template <typename T>
+    uint getCount(CacheSection section)
+    {
+      return static_cast<uint>(this->header->sections[static_cast<uint>(section)].size / sizeof(T));
+    }
+
+    std::string getString(const CookedString &string)
+    {
+      const char* characters = this->get<char>(CacheSection::Strings, string);
+      return characters ? std::string(characters, string.count) : std::string();
+    }
+
+    const CookedHeader& getHeader() { return *this->header; }
+    bool isValid() { return this->valid; }
+  private:
+    const MappedFile &file;
+    const CookedHeader* header;
+    bool valid;
+  };
+
+  //----------------------------------------------------------------------------
+  // Model cache.
+  //----------------------------------------------------------------------------
+  std::string
+  ModelCache::getCachePath(const std::string &filepath)
+  {
+    return filepath + MODEL_CACHE_EXTENSION;
+  }
+
+  bool
+  ModelCache::load(Model &model, const std::string &filepath)
+  {
+    Logger* logs = Logger::getInstance();
+
+    uint64_t sourceSize;
+    int64_t sourceTimestamp;
+    if (!getSourceStamp(filepath, sourceSize, sourceTimestamp))
+      return false;
+
+    std::string cachePath = getCachePath(filepath);
+    bool sourceTouched = false;
+    {
+      MappedFile cache(cachePath);
+      if (!cache.isMapped())
+        return false;
+
+      CacheReader reader(cache);
+      if (!reader.isValid())
+      {
+        logs->logMessage(LogMessage("Cooked model at " + cachePath + " is out of date "
+                                    "or invalid, reimporting."));
+        return false;
+      }
+
+      auto& header = reader.getHeader();
+      if (header.sourceSize != sourceSize)
+        return false;
+
+      // The source was touched or copied, only the hash can tell if it changed.
+      if (header.sourceTimestamp != sourceTimestamp)
+      {
+        uint64_t sourceHash;
+        if (!hashFile(filepath, sourceHash) || sourceHash != header.sourceHash)
+          return false;
+        sourceTouched = true;
+      }
+
+      model.getGlobalInverseTransform() = header.globalInverseTransform;
+      model.getMinPos() = header.minPos;
+      model.getMaxPos() = header.maxPos;
+
+      // The node hierarchy.
+      auto& sceneNodes = model.getSceneNodes();
+      uint numNodes = reader.getCount<CookedNode>(CacheSection::Nodes);
+      const CookedNode* nodes = reader.get<CookedNode>(CacheSection::Nodes, { 0, numNodes });
+      for (uint i = 0; i < numNodes && reader.isValid(); i++)
+      {
+        SceneNode node(reader.getString(nodes[i].name), nodes[i].localTransform);
+
+        const CookedString* children = reader.get<CookedString>(CacheSection::NodeChildren,
+                                                                nodes[i].children);
+        for (uint j = 0; children && j < nodes[i].children.count; j++)
+          node.childNames.emplace_back(reader.getString(children[j]));
+
+        if (i == header.rootNode)
+          model.getRootNode() = node;
+        sceneNodes.emplace(node.name, std::move(node));
+      }
+
+      // The bones.
+      auto& bones = model.getBones();
+      auto& boneMap = model.getBoneMap();
+      uint numBones = reader.getCount<CookedBone>(CacheSection::Bones);
+      const CookedBone* cookedBones = reader.get<CookedBone>(CacheSection::Bones, { 0, numBones });
+      bones.reserve(numBones);
+      for (uint i = 0; i < numBones && reader.isValid(); i++)
+      {
+        bones.emplace_back(reader.getString(cookedBones[i].name),
+                           reader.getString(cookedBones[i].parentMesh),
+                           cookedBones[i].offsetMatrix);
+        boneMap[bones.back().name] = i;
+      }
+
+      // The submeshes. Vertex and index ranges are copied straight out of the
+      // mapping.
+      auto& submeshes = model.getSubmeshes();
+      uint numSubmeshes = reader.getCount<CookedSubmesh>(CacheSection::Submeshes);
+      const CookedSubmesh* cookedSubmeshes = reader.get<CookedSubmesh>(CacheSection::Submeshes,
+                                                                       { 0, numSubmeshes });
+      submeshes.reserve(numSubmeshes);
+      for (uint i = 0; i < numSubmeshes && reader.isValid(); i++)
+      {
+        auto& cooked = cookedSubmeshes[i];
+        auto& submesh = submeshes.emplace_back(reader.getString(cooked.name), &model);
+
+        reader.getVector(CacheSection::Vertices, cooked.vertices, submesh.getData());
+        reader.getVector(CacheSection::SkinVertices, cooked.skinVertices, submesh.getSkinData());
+        reader.getVector(CacheSection::Indices, cooked.indices, submesh.getIndices());
+        reader.getVector(CacheSection::LODs, cooked.lods, submesh.getLODs());
+        reader.getVector(CacheSection::Meshlets, cooked.meshlets, submesh.getMeshlets());
+        reader.getVector(CacheSection::BoneBounds, cooked.boneBounds, submesh.getBoneBounds());
+        submesh.getMinPos() = cooked.minPos;
+        submesh.getMaxPos() = cooked.maxPos;
+
+        auto& materialInfo = submesh.getMaterialInfo();
+        materialInfo.albedoTexturePath = reader.getString(cooked.albedoTexturePath);
+        materialInfo.roughnessTexturePath = reader.getString(cooked.roughnessTexturePath);
+        materialInfo.metallicTexturePath = reader.getString(cooked.metallicTexturePath);
+        materialInfo.aoTexturePath = reader.getString(cooked.aoTexturePath);
+        materialInfo.specularTexturePath = reader.getString(cooked.specularTexturePath);
+        materialInfo.normalTexturePath = reader.getString(cooked.normalTexturePath);
+
+        submesh.setLoaded(cooked.loaded != 0);
+      }
+
+      if (reader.isValid())
+        model.getSkeleton().build(model);
+
+      // The compiled animations.
+      auto& animations = model.getAnimations();
+      uint numAnimations = reader.getCount<CookedAnimation>(CacheSection::Animations);
+      const CookedAnimation* cookedAnimations = reader.get<CookedAnimation>(CacheSection::Animations,
+                                                                            { 0, numAnimations });
+      animations.reserve(numAnimations);
+      for (uint i = 0; i < numAnimations && reader.isValid(); i++)
+      {
+        auto& cooked = cookedAnimations[i];
+        auto& animation = animations.emplace_back(&model);
+
+        animation.name = reader.getString(cooked.name);
+        animation.duration = cooked.duration;
+        animation.ticksPerSecond = cooked.ticksPerSecond;
+        animation.rawKeyframeMemory = cooked.rawKeyframeMemory;
+
+        const CookedString* nodeNames = reader.get<CookedString>(CacheSection::AnimatedNodes,
+                                                                 cooked.animatedNodes);
+        for (uint j = 0; nodeNames && j < cooked.animatedNodes.count; j++)
+        {
+          std::string nodeName = reader.getString(nodeNames[j]);
+          animation.animationNodes.emplace(nodeName, AnimationNode(nodeName));
+        }
+
+        reader.getVector(CacheSection::Tracks, cooked.tracks, animation.tracks);
+        reader.getVector(CacheSection::NodeTracks, cooked.nodeTracks, animation.nodeTracks);
+        reader.getVector(CacheSection::KeyTimes, cooked.translationTimes, animation.translationTimes);
+        reader.getVector(CacheSection::Vec3Keys, cooked.translationKeys, animation.translationKeys);
+        reader.getVector(CacheSection::KeyTimes, cooked.rotationTimes, animation.rotationTimes);
+        reader.getVector(CacheSection::QuatKeys, cooked.rotationKeys, animation.rotationKeys);
+        reader.getVector(CacheSection::KeyTimes, cooked.scaleTimes, animation.scaleTimes);
+        reader.getVector(CacheSection::Vec3Keys, cooked.scaleKeys, animation.scaleKeys);
+        reader.getVector(CacheSection::FullVec3Keys, cooked.fullTranslationKeys,
+                         animation.fullTranslationKeys);
+        reader.getVector(CacheSection::FullVec3Keys, cooked.fullScaleKeys, animation.fullScaleKeys);
+
+        // The tracks index into the skeleton, which must match the one they
+        // were compiled against.
+        if (animation.nodeTracks.size() != model.getSkeleton().getNumNodes())
+          break;
+      }
+
+      bool consistent = reader.isValid() && animations.size() == numAnimations
+                        && (animations.empty() || animations.back().nodeTracks.size()
+                                                  == model.getSkeleton().getNumNodes());
+      if (!consistent)
+      {
+        model.getSubmeshes().clear();
+        model.getAnimations().clear();
+        model.getSceneNodes().clear();
+        model.getBones().clear();
+        model.getBoneMap().clear();
+        model.getRootNode() = SceneNode();
+        model.getSkeleton() = Skeleton();
+        model.getGlobalInverseTransform() = glm::mat4(1.0f);
+        model.getMinPos() = glm::vec3(std::numeric_limits<float>::max());
+        model.getMaxPos() = glm::vec3(std::numeric_limits<float>::min());
+
+        logs->logMessage(LogMessage("Cooked model at " + cachePath + " is corrupt, "
+                                    "reimporting.", true, true));
+        return false;
+      }
+    }
+
+    // Store the new timestamp so the source isn't hashed again next time.
+    if (sourceTouched)
+    {
+      std::fstream cacheFile(cachePath, std::fstream::binary | std::fstream::in | std::fstream::out);
+      if (cacheFile)
+      {
+        cacheFile.seekp(offsetof(CookedHeader, sourceTimestamp));
+        cacheFile.write(reinterpret_cast<const char*>(&sourceTimestamp), sizeof(int64_t));
+      }
+    }
+
+    return true;
+  }
+
+  bool
+  ModelCache::save(Model &model, const std::string &filepath)
+  {
+    Logger* logs = Logger::getInstance();
+
+    CookedHeader header = {};
+    header.magic = cacheMagic;
+    header.version = MODEL_CACHE_VERSION;
+    header.vertexStride = sizeof(Vertex);
+    header.globalInverseTransform = model.getGlobalInverseTransform();
+    header.minPos = model.getMinPos();
+    header.maxPos = model.getMaxPos();
+
+    if (!getSourceStamp(filepath, header.sourceSize, header.sourceTimestamp)
+        || !hashFile(filepath, header.sourceHash))
+      return false;
+
+    CacheWriter writer;
+
+    // The node hierarchy.
+    uint nodeIndex = 0;
+    for (auto& [nodeName, node] : model.getSceneNodes())
+    {
+      std::vector<CookedString> children;
+      children.reserve(node.childNames.size());
+      for (auto& childName : node.childNames)
+        children.emplace_back(writer.addString(childName));
+
+      CookedNode cooked;
+      cooked.name = writer.addString(nodeName);
+      cooked.children = writer.append(CacheSection::NodeChildren, children);
+      cooked.localTransform = node.localTransform;
+      writer.append(CacheSection::Nodes, &cooked, 1);
+
+      if (nodeName == model.getRootNode().name)
+        header.rootNode = nodeIndex;
+      nodeIndex++;
+    }
+
+    // The bones, in the order of their indices.
+    for (auto& bone : model.getBones())
+    {
+      CookedBone cooked;
+      cooked.name = writer.addString(bone.name);
+      cooked.parentMesh = writer.addString(bone.parentMesh);
+      cooked.offsetMatrix = bone.offsetMatrix;
+      writer.append(CacheSection::Bones, &cooked, 1);
+    }
+
+    // The submeshes.
+    for (auto& submesh : model.getSubmeshes())
+    {
+      auto& materialInfo = submesh.getMaterialInfo();
+
+      CookedSubmesh cooked;
+      cooked.name = writer.addString(submesh.getName());
+      cooked.vertices = writer.append(CacheSection::Vertices, submesh.getData());
+      cooked.skinVertices = writer.append(CacheSection::SkinVertices, submesh.getSkinData());
+      cooked.indices = writer.append(CacheSection::Indices, submesh.getIndices());
+      cooked.lods = writer.append(CacheSection::LODs, submesh.getLODs());
+      cooked.meshlets = writer.append(CacheSection::Meshlets, submesh.getMeshlets());
+      cooked.boneBounds = writer.append(CacheSection::BoneBounds, submesh.getBoneBounds());
+      cooked.minPos = submesh.getMinPos();
+      cooked.maxPos = submesh.getMaxPos();
+      cooked.albedoTexturePath = writer.addString(materialInfo.albedoTexturePath);
+      cooked.roughnessTexturePath = writer.addString(materialInfo.roughnessTexturePath);
+      cooked.metallicTexturePath = writer.addString(materialInfo.metallicTexturePath);
+      cooked.aoTexturePath = writer.addString(materialInfo.aoTexturePath);
+      cooked.specularTexturePath = writer.addString(materialInfo.specularTexturePath);
+      cooked.normalTexturePath = writer.addString(materialInfo.normalTexturePath);
+      cooked.loaded = submesh.isLoaded() ? 1 : 0;
+      writer.append(CacheSection::Submeshes, &cooked, 1);
+    }
+
+    // The compiled animations.
+    for (auto& animation : model.getAnimations())
+    {
+      std::vector<CookedString> nodeNames;
+      nodeNames.reserve(animation.animationNodes.size());
+      for (auto& [nodeName, node] : animation.animationNodes)
+        nodeNames.emplace_back(writer.addString(nodeName));
+
+      CookedAnimation cooked;
+      cooked.name = writer.addString(animation.name);
+      cooked.duration = animation.duration;
+      cooked.ticksPerSecond = animation.ticksPerSecond;
+      cooked.rawKeyframeMemory = animation.rawKeyframeMemory;
+      cooked.animatedNodes = writer.append(CacheSection::AnimatedNodes, nodeNames);
+      cooked.tracks = writer.append(CacheSection::Tracks, animation.tracks);
+      cooked.nodeTracks = writer.append(CacheSection::NodeTracks, animation.nodeTracks);
+      cooked.translationTimes = writer.append(CacheSection::KeyTimes, animation.translationTimes);
+      cooked.translationKeys = writer.append(CacheSection::Vec3Keys, animation.translationKeys);
+      cooked.rotationTimes = writer.append(CacheSection::KeyTimes, animation.rotationTimes);
+      cooked.rotationKeys = writer.append(CacheSection::QuatKeys, animation.rotationKeys);
+      cooked.scaleTimes = writer.append(CacheSection::KeyTimes, animation.scaleTimes);
+      cooked.scaleKeys = writer.append(CacheSection::Vec3Keys, animation.scaleKeys);
+      cooked.fullTranslationKeys = writer.append(CacheSection::FullVec3Keys,
+                                                 animation.fullTranslationKeys);
+      cooked.fullScaleKeys = writer.append(CacheSection::FullVec3Keys, animation.fullScaleKeys);
+      writer.append(CacheSection::Animations, &cooked, 1);
+    }
+
+    std::string cachePath = getCachePath(filepath);
+    if (!writer.write(cachePath, header))
+    {
+      logs->logMessage(LogMessage("Failed to write the cooked model at " + cachePath + ".",
+                                  true, true));
+      return false;
+    }
+
+    return true;
+  }
+}
@@ -0,0 +1,233 @@
+#include "Graphics/OcclusionCulling.h"
+
+// Project includes.
+#include "Core/ThreadPool.h"
+
+// Number of mask words (32 boxes each) per occlusion culling job.
+#define OCCLUSION_WORDS_PER_JOB 16
+
+namespace Strontium
+{
+  // The range of source texels a destination texel covers, [first, last).
+  // Ranges overlap when the source size is odd so no row or column is lost.
+  static inline void
+  sourceRange(uint dest, uint sourceSize, uint destSize, uint &outFirst, uint &outLast)
+  {
+    outFirst = (dest * sourceSize) / destSize;
+    outLast = ((dest + 1) * sourceSize + destSize - 1) / destSize;
+  }
+
+  void
+  buildDepthPyramid(const float* depths, uint width, uint height,
+                    const glm::mat4 &viewProjection, const glm::vec3 &viewpoint,
+                    DepthPyramid &outPyramid)
+  {
+    outPyramid.viewProjection = viewProjection;
+    outPyramid.viewpoint = viewpoint;
+    outPyramid.valid = width > 0 && height > 0;
+    if (!outPyramid.valid)
+    {
+      outPyramid.levels.clear();
+      outPyramid.sizes.clear();
+      return;
+    }
+
+    uint numLevels = 1;
+    for (uint w = width, h = height; w > 1 || h > 1; numLevels++)
+    {
+      w = std::max(w / 2, 1u);
+      h = std::max(h / 2, 1u);
+    }
+
+    // The level vectors keep their storage from frame to frame.
+    auto& levels = outPyramid.levels;
+    auto& sizes = outPyramid.sizes;
+    levels.resize(numLevels);
+    sizes.resize(numLevels);
+
+    levels[0].assign(depths, depths + width * height);
+    sizes[0] = glm::uvec2(width, height);
+    for (uint l = 1; l < numLevels; l++)
+    {
+      glm::uvec2 source = sizes[l - 1];
+      glm::uvec2 dest = glm::uvec2(std::max(source.x / 2, 1u), std::max(source.y / 2, 1u));
+      const float* sourceDepths = levels[l - 1].data();
+
+      levels[l].resize(dest.x * dest.y);
+      sizes[l] = dest;
+      for (uint y = 0; y < dest.y; y++)
+      {
+        uint firstY, lastY;
+        sourceRange(y, source.y, dest.y, firstY, lastY);
+        for (uint x = 0; x < dest.x; x++)
+        {
+          uint firstX, lastX;
+          sourceRange(x, source.x, dest.x, firstX, lastX);
+
+          float depth = 0.0f;
+          for (uint sy = firstY; sy < lastY; sy++)
+            for (uint sx = firstX; sx < lastX; sx++)
+              depth = std::max(depth, sourceDepths[sy * source.x + sx]);
+          levels[l][y * dest.x + x] = depth;
+        }
+      }
+    }
+  }
+
+  // The normalized device bounds of a box seen from the view of the pyramid.
+  // False if the box reaches behind the near plane of that view.
+  static bool
+  projectBox(const DepthPyramid &pyramid, const glm::vec3 &center, const glm::vec3 &extents,
+             glm::vec3 &outMin, glm::vec3 &outMax)
+  {
+    outMin = glm::vec3(std::numeric_limits<float>::max());
+    outMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (uint k = 0; k < 8; k++)
+    {
+      glm::vec3 corner = center + extents * glm::vec3((k & 1) ? 1.0f : -1.0f,
+                                                      (k & 2) ? 1.0f : -1.0f,
+                                                      (k & 4) ? 1.0f : -1.0f);
+      glm::vec4 clip = pyramid.viewProjection * glm::vec4(corner, 1.0f);
+      if (!(clip.w > 1e-5f))
+        return false;
+
+      glm::vec3 ndc = glm::vec3(clip) / clip.w;
+      outMin = glm::min(outMin, ndc);
+      outMax = glm::max(outMax, ndc);
+    }
+
+    return true;
+  }
+
+  void
+  clearDepthPyramid(DepthPyramid &pyramid, const std::vector<BoundingBox> &boxes)
+  {
+    if (!pyramid.valid)
+      return;
+
+    for (auto& box : boxes)
+    {
+      glm::vec3 ndcMin, ndcMax;
+      if (!projectBox(pyramid, box.center, box.extents, ndcMin, ndcMax))
+      {
+        pyramid.valid = false;
+        return;
+      }
+
+      if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+        continue;
+
+      glm::vec2 uvMin = glm::clamp(0.5f * glm::vec2(ndcMin) + 0.5f, 0.0f, 1.0f);
+      glm::vec2 uvMax = glm::clamp(0.5f * glm::vec2(ndcMax) + 0.5f, 0.0f, 1.0f);
+
+      // Every level is cleared, the levels are already reduced.
+      for (uint l = 0; l < pyramid.levels.size(); l++)
+      {
+        glm::uvec2 size = pyramid.sizes[l];
+        uint firstX = std::min(static_cast<uint>(uvMin.x * size.x), size.x - 1);
+        uint lastX = std::min(static_cast<uint>(uvMax.x * size.x), size.x - 1);
+        uint firstY = std::min(static_cast<uint>(uvMin.y * size.y), size.y - 1);
+        uint lastY = std::min(static_cast<uint>(uvMax.y * size.y), size.y - 1);
+
+        float* depths = pyramid.levels[l].data();
+        for (uint y = firstY; y <= lastY; y++)
+          std::fill(depths + y * size.x + firstX, depths + y * size.x + lastX + 1, 1.0f);
+      }
+    }
+  }
+
+  // A texel of a level covers at least its share of the screen, so the texels
+  // under a box are found from its normalized screen rectangle at any level.
+  static bool
+  boxOccluded(const DepthPyramid &pyramid, const glm::vec3 &center,
+              const glm::vec3 &extents)
+  {
+    glm::vec3 ndcMin, ndcMax;
+    if (!projectBox(pyramid, center, extents, ndcMin, ndcMax))
+      return false;
+
+    if (ndcMin.x < -1.0f || ndcMin.y < -1.0f || ndcMax.x > 1.0f || ndcMax.y > 1.0f)
+      return false;
+
+    float nearestDepth = 0.5f * ndcMin.z + 0.5f;
+    glm::vec2 uvMin = 0.5f * glm::vec2(ndcMin) + 0.5f;
+    glm::vec2 uvMax = 0.5f * glm::vec2(ndcMax) + 0.5f;
+
+    // The level where the rectangle is at most two texels a side, it touches
+    // three at most.
+    glm::uvec2 baseSize = pyramid.sizes[0];
+    float extent = std::max((uvMax.x - uvMin.x) * baseSize.x, (uvMax.y - uvMin.y) * baseSize.y);
+    uint level = extent > 2.0f ? static_cast<uint>(std::ceil(std::log2(extent / 2.0f))) : 0;
+    level = std::min<uint>(level, pyramid.levels.size() - 1);
+
+    glm::uvec2 size = pyramid.sizes[level];
+    uint firstX = std::min(static_cast<uint>(uvMin.x * size.x), size.x - 1);
+    uint lastX = std::min(static_cast<uint>(uvMax.x * size.x), size.x - 1);
+    uint firstY = std::min(static_cast<uint>(uvMin.y * size.y), size.y - 1);
+    uint lastY = std::min(static_cast<uint>(uvMax.y * size.y), size.y - 1);
+
+    const float* depths = pyramid.levels[level].data();
+    for (uint y = firstY; y <= lastY; y++)
+      for (uint x = firstX; x <= lastX; x++)
+        if (nearestDepth <= depths[y * size.x + x] + HIZ_DEPTH_BIAS)
+          return false;
+
+    return true;
+  }
+
+  void
+  occlusionCullBoxes(const BoundingBoxArray &boxes, const DepthPyramid &pyramid,
+                     const glm::vec3 &viewpoint, const VisibilityMask &testMask,
+                     VisibilityMask &outMask, uint &outTested, uint &outCulled,
+                     bool multithreaded)
+  {
+    uint numWords = boxes.paddedCount() / 32;
+    outMask.assign(numWords, ~0u);
+    if (numWords == 0 || !pyramid.valid)
+      return;
+
+    // Seeing the old depth from a viewpoint moved by d is seeing the boxes
+    // moved by -d from the old viewpoint. Growing the boxes by |d| covers
+    // that, so anything the move uncovers is kept. The camera rotating
+    // doesn't change what's in front of what.
+    float travel = glm::length(viewpoint - pyramid.viewpoint);
+
+    std::atomic<uint> numTested(0);
+    std::atomic<uint> numCulled(0);
+    auto cullWords = [&](uint startWord, uint endWord)
+    {
+      uint tested = 0;
+      uint culled = 0;
+      for (uint w = startWord; w < endWord; w++)
+      {
+        for (uint b = 0; b < 32; b++)
+        {
+          uint i = w * 32 + b;
+          if (i >= boxes.count || !((testMask[w] >> b) & 1u))
+            continue;
+
+          glm::vec3 center = glm::vec3(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+          glm::vec3 extents = glm::vec3(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+
+          tested++;
+          if (boxOccluded(pyramid, center, extents + glm::vec3(travel)))
+          {
+            outMask[w] &= ~(1u << b);
+            culled++;
+          }
+        }
+      }
+
+      numTested += tested;
+      numCulled += culled;
+    };
+
+    if (multithreaded && numWords > OCCLUSION_WORDS_PER_JOB)
+      ThreadPool::getInstance()->parallelFor(numWords, OCCLUSION_WORDS_PER_JOB, cullWords);
+    else
+      cullWords(0, numWords);
+
+    outTested += numTested;
+    outCulled += numCulled;
+  }
+}
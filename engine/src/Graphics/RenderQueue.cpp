@@ -0,0 +1,137 @@
+#include "Graphics/RenderQueue.h"
+
+namespace Strontium
+{
+  // Fold a pointer down to an ID with the requested number of bits. The low
+  // bits of heap pointers are always zero due to alignment, so skip them.
+  static uint64_t
+  foldPointer(const void* pointer, uint numBits)
+  {
+    uint64_t value = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer)) >> 4;
+    value ^= value >> numBits;
+    value ^= value >> (2 * numBits);
+    return value & ((1ull << numBits) - 1ull);
+  }
+
+  uint64_t
+  buildSortKey(uint pass, DrawShader shader, const Material* material,
+               const Mesh* mesh, uint lod, uint depthBucket)
+  {
+    uint64_t key = 0;
+    key |= (static_cast<uint64_t>(pass) & 0xF) << 60;
+    key |= (static_cast<uint64_t>(shader) & 0xFF) << 52;
+    key |= (material ? foldPointer(material, 16) : 0) << 36;
+    key |= (mesh->getIndexType() == IndexType::UnsignedInt ? 1ull : 0ull) << 35;
+    key |= foldPointer(mesh, 16) << 19;
+    key |= (static_cast<uint64_t>(lod) & 0x7) << 16;
+    key |= static_cast<uint64_t>(depthBucket) & 0xFFFF;
+
+    return key;
+  }
+
+  uint
+  computeDepthBucket(float depth, float near, float far)
+  {
+    float normalized = (depth - near) / (far - near);
+    normalized = glm::clamp(normalized, 0.0f, 1.0f);
+
+    return static_cast<uint>(normalized * 65535.0f);
+  }
+
+  void
+  sortDrawItems(std::vector<DrawItem> &items, std::vector<DrawItem> &scratch)
+  {
+    if (items.size() < 2)
+      return;
+
+    scratch.resize(items.size());
+
+    // Histogram all 8 digits in one sweep.
+    uint histograms[8][256] = { };
+    for (auto& item : items)
+    {
+      for (uint digit = 0; digit < 8; digit++)
+        histograms[digit][(item.sortKey >> (digit * 8)) & 0xFF]++;
+    }
+
+    std::vector<DrawItem>* source = &items;
+    std::vector<DrawItem>* destination = &scratch;
+    for (uint digit = 0; digit < 8; digit++)
+    {
+      uint* histogram = histograms[digit];
+
+      // Every key has the same digit, the pass wouldn't move anything.
+      uint firstDigit = ((*source)[0].sortKey >> (digit * 8)) & 0xFF;
+      if (histogram[firstDigit] == items.size())
+        continue;
+
+      uint offsets[256];
+      uint total = 0;
+      for (uint i = 0; i < 256; i++)
+      {
+        offsets[i] = total;
+        total += histogram[i];
+      }
+
+      for (auto& item : *source)
+        (*destination)[offsets[(item.sortKey >> (digit * 8)) & 0xFF]++] = item;
+
+      std::swap(source, destination);
+    }
+
+    // Odd number of passes, the sorted items are in the scratch buffer.
+    if (source != &items)
+      items.swap(scratch);
+  }
+
+  void
+  buildDrawBatches(const std::vector<DrawItem> &items,
+                   const std::vector<Renderable> &renderables,
+                   std::vector<DrawBatch> &batches,
+                   std::vector<InstanceData> &instances)
+  {
+    batches.clear();
+    instances.clear();
+
+    for (uint i = 0; i < items.size(); i++)
+    {
+      const DrawItem &item = items[i];
+      bool isStatic = getSortKeyShader(item.sortKey) == DrawShader::Static;
+
+      if (isStatic)
+      {
+        const Renderable &renderable = renderables[item.renderable];
+
+        InstanceData instance;
+        instance.transform = renderable.transform;
+        instance.maskColourID = renderable.drawSelectionMask ? glm::vec4(1.0f) : glm::vec4(0.0f);
+        instance.maskColourID.w = renderable.id + 1.0f;
+
+        // Add an instance to the previous batch if only the transform differs.
+        if (!batches.empty() && batches.back().instanced)
+        {
+          DrawBatch &previous = batches.back();
+          const DrawItem &first = items[previous.firstItem];
+          if (first.mesh == item.mesh && first.material == item.material
+              && first.firstIndex == item.firstIndex && first.numIndices == item.numIndices
+              && getSortKeyPass(first.sortKey) == getSortKeyPass(item.sortKey)
+              && first.skinnedVertex < 0 && item.skinnedVertex < 0)
+          {
+            previous.numItems++;
+            instances.push_back(instance);
+            continue;
+          }
+        }
+
+        instances.push_back(instance);
+      }
+
+      DrawBatch batch;
+      batch.firstItem = i;
+      batch.numItems = 1;
+      batch.firstInstance = isStatic ? instances.size() - 1 : 0;
+      batch.instanced = isStatic;
+      batches.push_back(batch);
+    }
+  }
+}
@@ -12,11 +12,180 @@ namespace Strontium
     void shadowPass();
     void lightingPass();
     void postProcessPass(Shared<FrameBuffer> frontBuffer);
+    static void selectAnimationLODs();
 
     RendererStorage* storage;
     RendererState* state;
     RendererStats* stats;
 
+    // std140 layouts of the per-frame constant blocks.
+    struct CameraBlock
+    {
+      glm::mat4 view;
+      glm::mat4 projection;
+      glm::vec4 position;
+    };
+
+    struct CascadeShadowBlock
+    {
+      glm::mat4 lightVP[NUM_CASCADES];
+      glm::vec4 splits[NUM_CASCADES];
+      glm::vec4 shadowParams;
+    };
+
+    struct PostProcessBlock
+    {
+      glm::mat4 invViewProj;
+      glm::mat4 viewProj;
+      glm::vec4 data0;
+      glm::vec4 data1;
+      glm::ivec4 settings;
+    };
+
+    struct ClusterBlock
+    {
+      glm::mat4 invProjection;
+      glm::vec4 screenSize;
+      glm::vec4 nearFarScaleBias;
+      glm::uvec4 gridSize;
+      glm::uvec4 lightCounts;
+    };
+
+    struct ClusterSpotLight
+    {
+      glm::vec4 positionRadius;
+      glm::vec4 colourIntensity;
+      glm::vec4 direction;
+      glm::vec4 cutoffs;
+    };
+
+    // Frustum planes of the views culled by the GPU, packed as (normal, d).
+    struct CullViewBlock
+    {
+      glm::vec4 planes[NUM_CASCADES * 6];
+      glm::uvec4 settings;
+    };
+
+    // First source vertex, first destination vertex, the number of vertices
+    // and the first palette bone of a compute skinning dispatch. The first
+    // vertex of the skin stream is in skinOffset.x.
+    struct SkinningBlock
+    {
+      glm::uvec4 settings;
+      glm::uvec4 skinOffset;
+    };
+
+    // Per-draw data of non-instanced draws. The first palette bone of the
+    // renderable is in boneOffset.x, boneOffset.y is added to gl_VertexID to
+    // find the skin stream entry of a vertex.
+    struct ModelBlock
+    {
+      glm::mat4 transform;
+      glm::uvec4 boneOffset;
+    };
+
+    // Source and destination sizes of a depth reduction, if the source is
+    // the depth attachment and if the level is read back.
+    struct HiZBlock
+    {
+      glm::ivec4 sizes;
+      glm::ivec4 settings;
+    };
+
+    //--------------------------------------------------------------------------
+    // Hierarchical-Z occlusion culling.
+    //--------------------------------------------------------------------------
+    // The first level of the GPU pyramid is half the size of the screen.
+    static void
+    resizeHiZBuffer(uint width, uint height)
+    {
+      storage->hiZBuffer.setSize(std::max(width / 2, 1u), std::max(height / 2, 1u), 1);
+      storage->hiZBuffer.initNullTexture();
+      storage->hiZBuffer.generateMips();
+    }
+
+    // Read back the depth level written NUM_RING_BUFFER_FRAMES frames ago,
+    // the ring already waited for the GPU to finish that frame. The pyramid
+    // is dropped if there's nothing to read, stale depth isn't safe to cull
+    // with.
+    static void
+    readBackHiZ()
+    {
+      storage->currentHiZReadback = (storage->currentHiZReadback + 1) % NUM_RING_BUFFER_FRAMES;
+      auto& readback = storage->hiZReadbacks[storage->currentHiZReadback];
+      if (!readback.valid)
+      {
+        storage->depthPyramid.valid = false;
+        return;
+      }
+
+      auto& depths = storage->hiZReadbackData;
+      depths.resize(readback.size.x * readback.size.y);
+      readback.buffer->getData(0, depths.size() * sizeof(float), depths.data());
+      readback.valid = false;
+
+      buildDepthPyramid(depths.data(), readback.size.x, readback.size.y,
+                        readback.viewProjection, readback.viewpoint,
+                        storage->depthPyramid);
+    }
+
+    // Reduce the depth of the geometry pass into the GPU pyramid, down to the
+    // first level which fits in HIZ_READBACK_MAX_SIZE. That level is copied
+    // into this frame's readback buffer.
+    static void
+    buildHiZ()
+    {
+      if (!state->occlusionCulling)
+        return;
+
+      auto& frameData = storage->frameData;
+      auto& readback = storage->hiZReadbacks[storage->currentHiZReadback];
+      Shader* program = ShaderCache::getShader("hiz_downsample");
+
+      glm::ivec2 sourceSize = glm::ivec2(storage->gBuffer.getSize());
+      glm::ivec2 levelSize = glm::ivec2(storage->hiZBuffer.width, storage->hiZBuffer.height);
+      storage->gBuffer.bindAttachment(FBOTargetParam::Depth, 0);
+
+      uint level = 0;
+      while (true)
+      {
+        bool readBack = levelSize.x <= HIZ_READBACK_MAX_SIZE && levelSize.y <= HIZ_READBACK_MAX_SIZE;
+        if (readBack)
+        {
+          uint readbackSize = levelSize.x * levelSize.y * sizeof(float);
+          if (readback.buffer->size() != readbackSize)
+            readback.buffer->resize(readbackSize, BufferType::Dynamic);
+          readback.buffer->bindToPoint(0);
+        }
+
+        HiZBlock block;
+        block.sizes = glm::ivec4(sourceSize, levelSize);
+        block.settings = glm::ivec4(level == 0 ? 1 : 0, readBack ? 1 : 0, 0, 0);
+        uint offset = frameData.allocate(sizeof(HiZBlock), &block);
+        frameData.bindUniformRange(1, offset, sizeof(HiZBlock));
+
+        if (level > 0)
+          storage->hiZBuffer.bindAsImage(0, level - 1, ImageAccessPolicy::Read);
+        storage->hiZBuffer.bindAsImage(1, level, ImageAccessPolicy::Write);
+        program->launchCompute((levelSize.x + 7) / 8, (levelSize.y + 7) / 8, 1);
+        Shader::memoryBarrier(MemoryBarrierType::ShaderImageAccess);
+
+        if (readBack)
+          break;
+
+        sourceSize = levelSize;
+        levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+        level++;
+      }
+      Shader::memoryBarrier(MemoryBarrierType::BufferUpdate);
+
+      const Camera &camera = storage->sceneCam;
+      readback.viewProjection = camera.projection * camera.view;
+      readback.viewpoint = camera.position;
+      readback.size = glm::uvec2(levelSize);
+      readback.valid = true;
+    }
+
     // Initialize the renderer.
     void
     init(const uint width, const uint height)
@@ -71,6 +240,18 @@ namespace Strontium
       storage->halfResBuffer1.setParams(bloomParams);
       storage->halfResBuffer1.initNullTexture();
 
+      // The hierarchical depth pyramid, reduced with texel fetches.
+      Texture2DParams hiZParams = Texture2DParams();
+      hiZParams.sWrap = TextureWrapParams::ClampEdges;
+      hiZParams.tWrap = TextureWrapParams::ClampEdges;
+      hiZParams.minFilter = TextureMinFilterParams::NearestMipMapNearest;
+      hiZParams.maxFilter = TextureMaxFilterParams::Nearest;
+      hiZParams.internal = TextureInternalFormats::R32f;
+      hiZParams.format = TextureFormats::Red;
+      hiZParams.dataType = TextureDataType::Floats;
+      storage->hiZBuffer.setParams(hiZParams);
+      resizeHiZBuffer(width, height);
+
       // Prepare the shadow buffers.
       auto dSpec = FBOCommands::getDefaultDepthSpec();
       auto vSpec = FBOCommands::getFloatColourSpec(FBOTargetParam::Colour0);
@@ -119,8 +300,23 @@ namespace Strontium
       storage->sceneCam = sceneCamera;
       storage->camFrustum = buildCameraFrustum(sceneCamera);
 
+      // Start writing to the next region of the ring, then upload the camera
+      // constants for the whole frame.
+      storage->frameData.beginFrame();
+      readBackHiZ();
+
+      CameraBlock cameraBlock;
+      cameraBlock.view = sceneCamera.view;
+      cameraBlock.projection = sceneCamera.projection;
+      cameraBlock.position = glm::vec4(sceneCamera.position, 1.0f);
+      uint cameraOffset = storage->frameData.allocate(sizeof(CameraBlock), &cameraBlock);
+      storage->frameData.bindUniformRange(0, cameraOffset, sizeof(CameraBlock));
+
       // Resize the framebuffer at the start of a frame, if required.
       storage->drawEdge = false;
+      storage->boundsComputed = false;
+      storage->drawablesCulled = false;
+      storage->shadowCastersCulled = false;
 
       // Update the frame.
       state->currentFrame++;
@@ -155,6 +351,8 @@ namespace Strontium
         storage->halfResBuffer1.setSize(width / 2, height / 2, 4);
         storage->halfResBuffer1.initNullTexture();
 
+        resizeHiZBuffer(width, height);
+
         storage->width = width;
         storage->height = height;
       }
@@ -174,21 +372,49 @@ namespace Strontium
       stats->numPointLights = 0;
       stats->numSpotLights = 0;
 
+      stats->cullFrametime = 0.0f;
       stats->geoFrametime = 0.0f;
       stats->shadowFrametime = 0.0f;
       stats->lightFrametime = 0.0f;
       stats->postFramtime = 0.0f;
 
+      stats->numInstances = 0;
+      stats->skippedShaderBinds = 0;
+      stats->skippedMaterialBinds = 0;
+      stats->drawCommands = 0;
+      stats->numAnimators = 0;
+      stats->numReducedRateAnimators = 0;
+      stats->numFrozenAnimators = 0;
+      stats->numSkinnedVertices = 0;
+      for (uint i = 0; i < MAX_MESH_LODS; i++)
+      {
+        stats->numLODTriangles[i] = 0;
+        stats->numShadowLODTriangles[i] = 0;
+      }
+      stats->numMeshlets = 0;
+      stats->numFrustumCulledMeshlets = 0;
+      stats->numConeCulledMeshlets = 0;
+      stats->numShadowMeshlets = 0;
+      stats->numShadowFrustumCulledMeshlets = 0;
+      stats->numShadowConeCulledMeshlets = 0;
+      stats->numOcclusionTested = 0;
+      stats->numOcclusionCulled = 0;
+
       // Clear the render queues.
-      storage->staticRenderQueue.clear();
-      storage->dynamicRenderQueue.clear();
+      storage->renderables.clear();
     }
 
     void
     end(Shared<FrameBuffer> frontBuffer)
     {
+      if (!storage->drawablesCulled)
+        cullDrawables();
+      skinningPass();
       geometryPass();
 
+      if (!storage->shadowCastersCulled)
+        cullShadowCasters();
+      selectAnimationLODs();
       shadowPass();
 
       lightingPass();
@@ -196,6 +422,50 @@ namespace Strontium
       postProcessPass(frontBuffer);
     }
 
+    // Register the renderer stages in a frame task graph. Scenes submit
+    // between "Renderer3D::Begin" and the passes.
+    void
+    registerFrameTasks(TaskGraph &graph, uint width, uint height,
+                       const Camera &sceneCamera, Shared<FrameBuffer> frontBuffer)
+    {
+      graph.addTask("Renderer3D::Begin", [width, height, sceneCamera]()
+      {
+        begin(width, height, sceneCamera);
+      }, TaskAffinity::MainThread);
+
+      // Culling only touches the CPU side, the shadow casters get culled while
+      // the geometry pass is running.
+      graph.addTask("Renderer3D::ComputeBounds", []() { computeSubmeshBounds(); });
+      graph.addTask("Renderer3D::FrustumCulling", []() { cullDrawables(); });
+      graph.addTask("Renderer3D::ShadowCasterCulling", []() { cullShadowCasters(); });
+      graph.addTask("Renderer3D::AnimationLOD", []() { selectAnimationLODs(); });
+      graph.addTask("Renderer3D::SkinningPass", []() { skinningPass(); },
+                    TaskAffinity::MainThread);
+      graph.addTask("Renderer3D::GeometryPass", []() { geometryPass(); },
+                    TaskAffinity::MainThread);
+      graph.addTask("Renderer3D::ShadowPass", []() { shadowPass(); },
+                    TaskAffinity::MainThread);
+      graph.addTask("Renderer3D::LightingPass", []() { lightingPass(); },
+                    TaskAffinity::MainThread);
+      graph.addTask("Renderer3D::PostProcessPass", [frontBuffer]()
+      {
+        postProcessPass(frontBuffer);
+      }, TaskAffinity::MainThread);
+
+      graph.addDependency("Renderer3D::Begin", "Renderer3D::ComputeBounds");
+      graph.addDependency("Renderer3D::ComputeBounds", "Renderer3D::FrustumCulling");
+      graph.addDependency("Renderer3D::ComputeBounds", "Renderer3D::ShadowCasterCulling");
+      graph.addDependency("Renderer3D::ComputeBounds", "Renderer3D::SkinningPass");
+      graph.addDependency("Renderer3D::FrustumCulling", "Renderer3D::AnimationLOD");
+      graph.addDependency("Renderer3D::ShadowCasterCulling", "Renderer3D::AnimationLOD");
+      graph.addDependency("Renderer3D::FrustumCulling", "Renderer3D::GeometryPass");
+      graph.addDependency("Renderer3D::SkinningPass", "Renderer3D::GeometryPass");
+      graph.addDependency("Renderer3D::GeometryPass", "Renderer3D::ShadowPass");
+      graph.addDependency("Renderer3D::ShadowCasterCulling", "Renderer3D::ShadowPass");
+      graph.addDependency("Renderer3D::ShadowPass", "Renderer3D::LightingPass");
+      graph.addDependency("Renderer3D::LightingPass", "Renderer3D::PostProcessPass");
+    }
+
     // Draw the data to the screen.
     void
     draw(VertexArray* data, Shader* program)
@@ -217,7 +487,6 @@ namespace Strontium
       RendererCommands::depthFunction(DepthFunctions::LEq);
       storage->currentEnvironment->configure();
 
-      storage->camBuffer.bindToPoint(0);
       storage->blankVAO.bind();
       ShaderCache::getShader("skybox")->bind();
       RendererCommands::drawArrays(PrimativeType::Triangle, 0, 36);
@@ -225,40 +494,578 @@ namespace Strontium
       RendererCommands::depthFunction(DepthFunctions::Less);
     }
 
+    // Renderables are culled in a batch once everything has been submitted,
+    // see cullDrawables() and cullShadowCasters().
     void
     submit(Model* data, ModelMaterial &materials, const glm::mat4 &model,
-           float id, bool drawSelectionMask)
+           float id, bool drawSelectionMask, const glm::mat4* previousModel)
     {
-      // Cull the model early.
-      glm::vec3 min = data->getMinPos();
-      glm::vec3 max = data->getMaxPos();
-      glm::vec3 center = (min + max) / 2.0f;
-
-      if (boundingBoxInFrustum(storage->camFrustum, min, max, model) && state->frustumCull)
-        storage->staticRenderQueue.emplace_back(data, &materials, model, id,
-                                                drawSelectionMask);
-      else if (!state->frustumCull)
-        storage->staticRenderQueue.emplace_back(data, &materials, model, id,
-                                                drawSelectionMask);
-
-      storage->staticShadowQueue.emplace_back(data, model);
+      storage->renderables.emplace_back(data, nullptr, &materials, model, id,
+                                        drawSelectionMask, previousModel);
     }
 
     void submit(Model* data, Animator* animation, ModelMaterial &materials,
-                const glm::mat4 &model, float id, bool drawSelectionMask)
+                const glm::mat4 &model, float id, bool drawSelectionMask,
+                const glm::mat4* previousModel)
     {
-      // Cull the model early.
-      glm::vec3 min = data->getMinPos();
-      glm::vec3 max = data->getMaxPos();
-
-      if (boundingBoxInFrustum(storage->camFrustum, min, max, model) && state->frustumCull)
-        storage->dynamicRenderQueue.emplace_back(data, animation, &materials,
-                                                 model, id, drawSelectionMask);
-      else if (!state->frustumCull)
-        storage->dynamicRenderQueue.emplace_back(data, animation, &materials,
-                                                 model, id, drawSelectionMask);
-
-      storage->dynamicShadowQueue.emplace_back(data, animation, model);
+      storage->renderables.emplace_back(data, animation, &materials, model, id,
+                                        drawSelectionMask, previousModel);
+    }
+
+    void
+    invalidateOcclusion()
+    {
+      for (uint i = 0; i < NUM_RING_BUFFER_FRAMES; i++)
+        storage->hiZReadbacks[i].valid = false;
+      storage->depthPyramid.valid = false;
+    }
+
+    //--------------------------------------------------------------------------
+    // Batch frustum culling.
+    //--------------------------------------------------------------------------
+    static void
+    setAllVisible(const BoundingBoxArray &bounds, VisibilityMask &mask)
+    {
+      mask.assign(bounds.paddedCount() / 32, ~0u);
+    }
+
+    // Pack the bones of the animated renderables into the palette, as the
+    // transposed top three rows of each matrix.
+    static void
+    packBonePalette()
+    {
+      auto& renderables = storage->renderables;
+      auto& palette = storage->bonePalette;
+      auto& offsets = storage->boneOffsets;
+
+      offsets.resize(renderables.size());
+
+      uint numBones = 0;
+      for (uint i = 0; i < renderables.size(); i++)
+      {
+        offsets[i] = numBones;
+        if (renderables[i].animator)
+          numBones += renderables[i].animator->getFinalBoneTransforms().size();
+      }
+      palette.resize(3 * numBones);
+
+      ThreadPool::getInstance()->parallelFor(renderables.size(), 16, [&renderables, &palette, &offsets](uint start, uint end)
+      {
+        for (uint i = start; i < end; i++)
+        {
+          if (!renderables[i].animator)
+            continue;
+
+          auto& bones = renderables[i].animator->getFinalBoneTransforms();
+          glm::vec4* rows = palette.data() + 3 * offsets[i];
+          for (uint j = 0; j < bones.size(); j++)
+          {
+            const glm::mat4 &bone = bones[j];
+            for (uint k = 0; k < 3; k++)
+              rows[3 * j + k] = glm::vec4(bone[0][k], bone[1][k], bone[2][k], bone[3][k]);
+          }
+        }
+      });
+    }
+
+    // Upload the bone palette to the ring once for all the passes.
+    static void
+    bindBonePalette()
+    {
+      auto& palette = storage->bonePalette;
+      if (palette.empty())
+        return;
+
+      uint paletteSize = palette.size() * sizeof(glm::vec4);
+      uint offset = storage->frameData.allocate(paletteSize, palette.data());
+      storage->frameData.bindStorageRange(4, offset, paletteSize);
+    }
+
+    // Bound a submesh in the current pose from the bind pose bounds of its
+    // bones. Every skinned vertex is a weighted average of its positions
+    // under each influencing bone, so it stays within the union of the
+    // transformed bone bounds. Keeps the bind pose bounds if the submesh
+    // isn't skinned.
+    static void
+    computePosedBounds(Mesh &submesh, const std::vector<glm::mat4> &bones,
+                       glm::vec3 &outMin, glm::vec3 &outMax)
+    {
+      auto& boneBounds = submesh.getBoneBounds();
+      if (boneBounds.empty() || bones.empty())
+        return;
+
+      glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+      glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+      for (auto& bounds : boneBounds)
+      {
+        if (bounds.bone == BoneBounds::unskinnedBone || bounds.bone >= bones.size())
+        {
+          min = glm::min(min, bounds.min);
+          max = glm::max(max, bounds.max);
+          continue;
+        }
+
+        expandTransformedBounds(bounds.min, bounds.max, bones[bounds.bone], min, max);
+      }
+
+      outMin = min;
+      outMax = max;
+    }
+
+    // Flatten the submeshes of the renderables into a SoA array of worldspace
+    // bounds. The submeshes of renderable i start at boundsOffsets[i].
+    void
+    computeSubmeshBounds()
+    {
+      auto start = std::chrono::steady_clock::now();
+
+      auto& renderables = storage->renderables;
+      auto& bounds = storage->renderableBounds;
+      auto& offsets = storage->boundsOffsets;
+
+      offsets.resize(renderables.size());
+
+      uint numBoxes = 0;
+      for (uint i = 0; i < renderables.size(); i++)
+      {
+        offsets[i] = numBoxes;
+        numBoxes += renderables[i].model->getSubmeshes().size();
+      }
+      bounds.resize(numBoxes);
+
+      auto& submissions = storage->modelSubmissions;
+      submissions.clear();
+      for (auto& renderable : renderables)
+        submissions[renderable.model]++;
+      for (auto& renderable : renderables)
+        renderable.repeated = submissions[renderable.model] > 1;
+
+      packBonePalette();
+
+      // Reserve a skinned copy of the vertices of every animated submesh.
+      auto& skinnedOffsets = storage->skinnedVertexOffsets;
+      skinnedOffsets.assign(numBoxes, -1);
+      storage->numSkinnedVertices = 0;
+      if (state->computeSkinning)
+      {
+        for (uint i = 0; i < renderables.size(); i++)
+        {
+          auto& renderable = renderables[i];
+          if (!renderable.animator || renderable.animator->getFinalBoneTransforms().empty())
+            continue;
+
+          auto& submeshes = renderable.model->getSubmeshes();
+          for (uint j = 0; j < submeshes.size(); j++)
+          {
+            if (!submeshes[j].isLoaded() || !submeshes[j].isSkinned())
+              continue;
+
+            skinnedOffsets[offsets[i] + j] = storage->numSkinnedVertices;
+            storage->numSkinnedVertices += submeshes[j].getData().size();
+          }
+        }
+      }
+
+      auto& posedBounds = storage->posedBounds;
+      posedBounds.resize(2 * numBoxes);
+
+      ThreadPool::getInstance()->parallelFor(renderables.size(), 64, [&renderables, &bounds, &offsets, &posedBounds](uint start, uint end)
+      {
+        for (uint i = start; i < end; i++)
+        {
+          auto& submeshes = renderables[i].model->getSubmeshes();
+          const glm::mat4 &transform = renderables[i].transform;
+
+          for (uint j = 0; j < submeshes.size(); j++)
+          {
+            glm::vec3 min = submeshes[j].getMinPos();
+            glm::vec3 max = submeshes[j].getMaxPos();
+            if (renderables[i].animator)
+            {
+              computePosedBounds(submeshes[j], renderables[i].animator->getFinalBoneTransforms(),
+                                 min, max);
+              posedBounds[2 * (offsets[i] + j)] = glm::vec4(min, 1.0f);
+              posedBounds[2 * (offsets[i] + j) + 1] = glm::vec4(max, 1.0f);
+            }
+
+            bounds.set(offsets[i] + j, buildBoundingBox(min, max, transform));
+          }
+        }
+      });
+
+      storage->boundsComputed = true;
+
+      auto end = std::chrono::steady_clock::now();
+      std::chrono::duration<double> elapsed = end - start;
+      stats->cullFrametime += elapsed.count() * 1000.0f;
+    }
+
+    // Compute skinned submeshes are drawn with the static shaders, animated
+    // submeshes are only skinned in the vertex shader without the pre-pass.
+    // Submeshes without a skin stream are always static.
+    static DrawShader
+    getDrawShader(const Renderable &renderable, Mesh &submesh, int skinnedVertex)
+    {
+      if (renderable.animator && submesh.isSkinned() && skinnedVertex < 0)
+        return DrawShader::Dynamic;
+      return DrawShader::Static;
+    }
+
+    // Pick the coarsest LOD of a submesh whose error projects to at most
+    // threshold pixels, using the distance from the camera to the submesh's
+    // bounding box.
+    static uint
+    selectMeshLOD(Mesh &submesh, const glm::mat4 &transform, uint boxIndex, float threshold)
+    {
+      uint numLODs = submesh.getNumLODs();
+      if (!state->meshLOD || numLODs == 1)
+        return 0;
+
+      auto& bounds = storage->renderableBounds;
+      const Camera &camera = storage->sceneCam;
+
+      glm::vec3 center = glm::vec3(bounds.centerX[boxIndex], bounds.centerY[boxIndex],
+                                   bounds.centerZ[boxIndex]);
+      glm::vec3 extents = glm::vec3(bounds.extentX[boxIndex], bounds.extentY[boxIndex],
+                                    bounds.extentZ[boxIndex]);
+      float distance = glm::length(center - camera.position) - glm::length(extents);
+      distance = std::max(distance, camera.near);
+
+      // LOD errors are in model units.
+      float scale = std::max(glm::length(glm::vec3(transform[0])),
+                             std::max(glm::length(glm::vec3(transform[1])),
+                                      glm::length(glm::vec3(transform[2]))));
+      // projection[1][1] is 1 / tan(fov / 2). The editor and scene cameras
+      // don't agree on the units of the fov, the projection is always right.
+      float pixelsPerUnit = 0.5f * static_cast<float>(storage->height)
+                            * camera.projection[1][1];
+      float errorToPixels = scale * pixelsPerUnit / distance;
+
+      uint lod = 0;
+      while (lod + 1 < numLODs && submesh.getLOD(lod + 1).error * errorToPixels <= threshold)
+        lod++;
+
+      return lod;
+    }
+
+    // Push the draw item of a submesh, covering its whole LOD. Static
+    // submeshes drawn at full detail with meshlets get an item per run of
+    // meshlets visible in any of the frustums instead, see cullMeshlets().
+    // Models submitted more than once skip meshlet culling, every copy would
+    // get its own runs and they couldn't be instanced anymore.
+    static void
+    pushDrawItem(std::vector<DrawItem> &items, std::vector<MeshletRun> &runs, DrawItem &item,
+                 const Frustum* frustums, uint numFrustums, const glm::vec4 &viewpoint,
+                 uint &outNumMeshlets, uint &outFrustumCulled, uint &outConeCulled)
+    {
+      Mesh* mesh = item.mesh;
+      bool meshletCulled = state->meshletCulling && item.lod == 0 && mesh->hasMeshlets()
+                           && getSortKeyShader(item.sortKey) == DrawShader::Static
+                           && item.skinnedVertex < 0
+                           && !storage->renderables[item.renderable].repeated;
+      if (!meshletCulled)
+      {
+        MeshLOD lod = mesh->getLOD(item.lod);
+        item.firstIndex = lod.firstIndex;
+        item.numIndices = lod.numIndices;
+        items.push_back(item);
+        return;
+      }
+
+      auto& meshlets = mesh->getMeshlets();
+      MeshletCullView view = buildMeshletCullView(storage->renderables[item.renderable].transform,
+                                                  frustums, state->frustumCull ? numFrustums : 0,
+                                                  viewpoint, state->meshletConeCulling);
+      cullMeshlets(meshlets, view, runs, outFrustumCulled, outConeCulled);
+      outNumMeshlets += meshlets.size();
+
+      for (auto& run : runs)
+      {
+        item.firstIndex = run.firstIndex;
+        item.numIndices = run.numIndices;
+        items.push_back(item);
+      }
+    }
+
+    // Turn the submeshes visible to the camera into sorted draw items. Draws
+    // without a material are dropped here so the pass doesn't have to.
+    static void
+    buildGeometryItems()
+    {
+      auto& items = storage->geometryItems;
+      auto& bounds = storage->renderableBounds;
+      const Camera &camera = storage->sceneCam;
+
+      items.clear();
+      for (uint i = 0; i < storage->renderables.size(); i++)
+      {
+        auto& renderable = storage->renderables[i];
+        auto& submeshes = renderable.model->getSubmeshes();
+
+        for (uint j = 0; j < submeshes.size(); j++)
+        {
+          uint boxIndex = storage->boundsOffsets[i] + j;
+          int skinnedVertex = storage->skinnedVertexOffsets[boxIndex];
+          DrawShader shader = getDrawShader(renderable, submeshes[j], skinnedVertex);
+
+          // Static submeshes are culled by the GPU, see cullInstancesGPU().
+          bool cpuCulled = shader == DrawShader::Dynamic || !state->gpuCulling;
+          if (cpuCulled && !isVisible(storage->cameraVisibility, boxIndex))
+            continue;
+
+          // Occlusion is only known on the CPU, it applies to every submesh.
+          if (!isVisible(storage->occlusionVisibility, boxIndex))
+            continue;
+
+          auto& submesh = submeshes[j];
+          Material* material = renderable.materials->getMaterial(submesh.getName());
+          if (!material)
+            continue;
+
+          // Enable edge detection for selected mesh outlines.
+          if (renderable.drawSelectionMask)
+            storage->drawEdge = true;
+
+          glm::vec3 center = glm::vec3(bounds.centerX[boxIndex], bounds.centerY[boxIndex],
+                                       bounds.centerZ[boxIndex]);
+          float depth = glm::dot(center - camera.position, camera.front);
+          uint lod = selectMeshLOD(submesh, renderable.transform, boxIndex,
+                                   state->meshLODThreshold);
+          stats->numLODTriangles[lod] += submesh.getLOD(lod).numIndices / 3;
+
+          DrawItem item;
+          item.sortKey = buildSortKey(0, shader, material, &submesh, lod,
+                                      computeDepthBucket(depth, camera.near, camera.far));
+          item.mesh = &submesh;
+          item.material = material;
+          item.renderable = i;
+          item.lod = lod;
+          item.skinnedVertex = skinnedVertex;
+          pushDrawItem(items, storage->geometryMeshletRuns, item, &storage->camFrustum, 1,
+                       glm::vec4(camera.position, 1.0f), stats->numMeshlets,
+                       stats->numFrustumCulledMeshlets, stats->numConeCulledMeshlets);
+        }
+      }
+
+      sortDrawItems(items, storage->geometrySortScratch);
+      buildDrawBatches(items, storage->renderables, storage->geometryBatches,
+                       storage->geometryInstances);
+    }
+
+    // Shadow draw items, the cascade index is the pass of the key. GPU culled
+    // items are shared by the cascades, so shadow LODs are picked from the
+    // camera distance for all of them, and their meshlets are kept if they're
+    // in any of the cascades.
+    static void
+    buildShadowItems()
+    {
+      auto& items = storage->shadowItems;
+      glm::vec4 viewpoint = glm::vec4(storage->cascadeDirection, 0.0f);
+
+      items.clear();
+      storage->shadowBatches.clear();
+      storage->shadowInstances.clear();
+      if (!storage->hasCascades)
+        return;
+
+      for (uint i = 0; i < storage->renderables.size(); i++)
+      {
+        auto& renderable = storage->renderables[i];
+        auto& submeshes = renderable.model->getSubmeshes();
+
+        for (uint j = 0; j < submeshes.size(); j++)
+        {
+          uint boxIndex = storage->boundsOffsets[i] + j;
+          int skinnedVertex = storage->skinnedVertexOffsets[boxIndex];
+          DrawShader shader = getDrawShader(renderable, submeshes[j], skinnedVertex);
+          uint lod = selectMeshLOD(submeshes[j], renderable.transform, boxIndex,
+                                   state->meshLODThreshold * state->meshLODShadowBias);
+
+          // GPU culled static submeshes are shared by all the cascades and
+          // only get an item for the first one.
+          if (shader == DrawShader::Static && state->gpuCulling)
+          {
+            stats->numShadowLODTriangles[lod] += submeshes[j].getLOD(lod).numIndices / 3;
+
+            DrawItem item;
+            item.sortKey = buildSortKey(0, shader, nullptr, &submeshes[j], lod, 0);
+            item.mesh = &submeshes[j];
+            item.material = nullptr;
+            item.renderable = i;
+            item.lod = lod;
+            item.skinnedVertex = skinnedVertex;
+            pushDrawItem(items, storage->shadowMeshletRuns, item, storage->cascadeFrustums,
+                         NUM_CASCADES, viewpoint, stats->numShadowMeshlets,
+                         stats->numShadowFrustumCulledMeshlets,
+                         stats->numShadowConeCulledMeshlets);
+            continue;
+          }
+
+          for (uint k = 0; k < NUM_CASCADES; k++)
+          {
+            if (!isVisible(storage->cascadeVisibility[k], boxIndex))
+              continue;
+
+            stats->numShadowLODTriangles[lod] += submeshes[j].getLOD(lod).numIndices / 3;
+
+            DrawItem item;
+            item.sortKey = buildSortKey(k, shader, nullptr, &submeshes[j], lod, 0);
+            item.mesh = &submeshes[j];
+            item.material = nullptr;
+            item.renderable = i;
+            item.lod = lod;
+            item.skinnedVertex = skinnedVertex;
+            pushDrawItem(items, storage->shadowMeshletRuns, item, &storage->cascadeFrustums[k],
+                         1, viewpoint, stats->numShadowMeshlets,
+                         stats->numShadowFrustumCulledMeshlets,
+                         stats->numShadowConeCulledMeshlets);
+          }
+        }
+      }
+
+      sortDrawItems(items, storage->shadowSortScratch);
+      buildDrawBatches(items, storage->renderables, storage->shadowBatches,
+                       storage->shadowInstances);
+    }
+
+    // Pick the animation LOD of the animated renderables from their screen
+    // coverage. The animators use it for their next update. Needs both the
+    // camera and the cascades culled.
+    static void
+    selectAnimationLODs()
+    {
+      const Camera &camera = storage->sceneCam;
+      // projection[1][1] is 1 / tan(fov / 2), whatever units the camera
+      // keeps its fov in.
+      float tanHalfFOV = 1.0f / camera.projection[1][1];
+
+      for (uint i = 0; i < storage->renderables.size(); i++)
+      {
+        auto& renderable = storage->renderables[i];
+        if (!renderable.animator)
+          continue;
+
+        stats->numAnimators++;
+        if (!state->animationLOD)
+        {
+          renderable.animator->setLOD(1, 0);
+          continue;
+        }
+
+        // Off-screen models freeze if none of their submeshes are visible,
+        // to the camera or to a cascade they cast into.
+        uint numSubmeshes = renderable.model->getSubmeshes().size();
+        bool visible = false;
+        for (uint j = 0; j < numSubmeshes && !visible; j++)
+        {
+          uint boxIndex = storage->boundsOffsets[i] + j;
+          visible = isVisible(storage->cameraVisibility, boxIndex);
+          for (uint c = 0; c < NUM_CASCADES && storage->hasCascades && !visible; c++)
+            visible = isVisible(storage->cascadeVisibility[c], boxIndex);
+        }
+
+        if (!visible && state->aniLODFreezeOffscreen)
+        {
+          renderable.animator->setLOD(0, 0);
+          stats->numFrozenAnimators++;
+          continue;
+        }
+
+        BoundingBox box = buildBoundingBox(renderable.model->getMinPos(),
+                                           renderable.model->getMaxPos(),
+                                           renderable.transform);
+        float distance = glm::length(box.center - camera.position);
+        float radius = glm::length(box.extents);
+        float screenSize = distance > radius ? radius / (distance * tanHalfFOV) : 1.0f;
+
+        uint updateInterval = 4;
+        if (screenSize >= state->aniLODFullRateSize)
+          updateInterval = 1;
+        else if (screenSize >= state->aniLODHalfRateSize)
+          updateInterval = 2;
+
+        uint droppedBoneLevels = screenSize < state->aniLODReducedBonesSize
+                                 ? state->aniLODDroppedBoneLevels : 0;
+
+        renderable.animator->setLOD(updateInterval, droppedBoneLevels);
+        if (updateInterval > 1)
+          stats->numReducedRateAnimators++;
+      }
+    }
+
+    // Keep the boxes of the submeshes which moved this frame, at their
+    // current bounds and at those bounds taken back to the previous
+    // transform. Kept in this frame's readback slot, which was last used by
+    // the frame the read back depth is from.
+    static void
+    recordMovedBounds()
+    {
+      auto& moved = storage->movedBounds[storage->currentHiZReadback];
+      moved.clear();
+
+      auto& bounds = storage->renderableBounds;
+      for (uint i = 0; i < storage->renderables.size(); i++)
+      {
+        auto& renderable = storage->renderables[i];
+        if (!renderable.moved)
+          continue;
+
+        glm::mat4 previous = renderable.previousTransform * glm::inverse(renderable.transform);
+        uint numSubmeshes = renderable.model->getSubmeshes().size();
+        for (uint j = 0; j < numSubmeshes; j++)
+        {
+          uint box = storage->boundsOffsets[i] + j;
+          glm::vec3 center = glm::vec3(bounds.centerX[box], bounds.centerY[box], bounds.centerZ[box]);
+          glm::vec3 extents = glm::vec3(bounds.extentX[box], bounds.extentY[box], bounds.extentZ[box]);
+
+          moved.push_back({ center, extents });
+          moved.push_back(buildBoundingBox(center - extents, center + extents, previous));
+        }
+      }
+    }
+
+    void
+    cullDrawables()
+    {
+      if (!storage->boundsComputed)
+        computeSubmeshBounds();
+
+      auto start = std::chrono::steady_clock::now();
+
+      if (state->frustumCull)
+      {
+        boundingBoxesInFrustums(storage->renderableBounds, &storage->camFrustum, 1,
+                                &storage->cameraVisibility);
+      }
+      else
+        setAllVisible(storage->renderableBounds, storage->cameraVisibility);
+
+      // The depth is a few frames old, it's cleared wherever something moved
+      // since. Only the submeshes in the frustum are tested against it.
+      recordMovedBounds();
+      if (state->occlusionCulling)
+      {
+        for (uint i = 0; i < NUM_RING_BUFFER_FRAMES; i++)
+          clearDepthPyramid(storage->depthPyramid, storage->movedBounds[i]);
+      }
+
+      if (state->occlusionCulling && storage->depthPyramid.valid)
+      {
+        occlusionCullBoxes(storage->renderableBounds, storage->depthPyramid,
+                           storage->sceneCam.position, storage->cameraVisibility,
+                           storage->occlusionVisibility, stats->numOcclusionTested,
+                           stats->numOcclusionCulled);
+      }
+      else
+        setAllVisible(storage->renderableBounds, storage->occlusionVisibility);
+
+      buildGeometryItems();
+
+      storage->drawablesCulled = true;
+
+      auto end = std::chrono::steady_clock::now();
+      std::chrono::duration<double> elapsed = end - start;
+      stats->cullFrametime += elapsed.count() * 1000.0f;
     }
 
     void
@@ -294,133 +1101,433 @@ namespace Strontium
       stats->numSpotLights++;
     }
 
-    //--------------------------------------------------------------------------
-    // Deferred geometry pass.
-    //--------------------------------------------------------------------------
-    void geometryPass()
+    // Upload the instance data of a pass to the ring and bind it.
+    static void
+    bindInstances(const std::vector<InstanceData> &instances)
     {
-      auto start = std::chrono::steady_clock::now();
+      if (instances.empty())
+        return;
 
-      // Upload camera uniforms to the camera uniform buffer.
-      storage->camBuffer.bindToPoint(0);
-      storage->camBuffer.setData(0, sizeof(glm::mat4), glm::value_ptr(storage->sceneCam.view));
-      storage->camBuffer.setData(sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(storage->sceneCam.projection));
-      storage->camBuffer.setData(2 * sizeof(glm::mat4), sizeof(glm::vec3), &(storage->sceneCam.position.x));
+      uint dataSize = instances.size() * sizeof(InstanceData);
+      uint offset = storage->frameData.allocate(dataSize, instances.data());
+      storage->frameData.bindStorageRange(5, offset, dataSize);
+    }
 
-      // Start the geometry pass.
-      storage->gBuffer.beginGeoPass();
+    // Make sure the meshes of the batches are in the geometry arena and
+    // build one indirect command per batch.
+    static void
+    buildIndirectCommands(const std::vector<DrawBatch> &batches,
+                          const std::vector<DrawItem> &items)
+    {
+      auto& commands = storage->indirectCommands;
+      commands.clear();
+      for (auto& batch : batches)
+      {
+        auto& item = items[batch.firstItem];
+        if (!item.mesh->isInArena())
+          item.mesh->uploadToArena(*storage->geometryArena);
+
+        // Skinned meshes share the indices of the bind pose mesh, and every
+        // LOD indexes the same vertices.
+        auto& allocation = item.mesh->getArenaAllocation();
+        uint baseVertex = allocation.getBaseVertex();
+        if (item.skinnedVertex >= 0)
+          baseVertex = storage->skinnedVertices.getBaseVertex() + item.skinnedVertex;
+        commands.push_back({ item.numIndices, batch.numItems,
+                             allocation.getFirstIndex() + item.firstIndex,
+                             static_cast<int>(baseVertex),
+                             batch.firstInstance });
+      }
+    }
 
-      storage->transformBuffer.bindToPoint(2);
-      storage->editorBuffer.bindToPoint(3);
+    // Upload the indirect commands of the batches to the ring. Returns the
+    // offset of the first command, the command of batch i is at index i.
+    static uint
+    uploadIndirectCommands(const std::vector<DrawBatch> &batches,
+                           const std::vector<DrawItem> &items, uint numInstances)
+    {
+      auto& commands = storage->indirectCommands;
+      buildIndirectCommands(batches, items);
+
+      // Instanced draws find their data through the per-instance ID stream.
+      storage->geometryArena->reserveInstanceIDs(numInstances);
 
-      // Static geometry pass.
-      Shader* program = ShaderCache::getShader("geometry_pass_shader");
-      for (auto& drawable : storage->staticRenderQueue)
+      if (commands.empty())
+        return 0;
+
+      uint offset = storage->frameData.allocate(commands.size() * sizeof(DrawElementsIndirectCommand),
+                                                commands.data());
+      storage->frameData.bindDrawIndirect();
+      return offset;
+    }
+
+    // Frustum cull the instances of the batches on the GPU against numViews
+    // views. The command of batch b for view v is at index v * numBatches + b,
+    // and visible instances are compacted into the instance range of their
+    // command, which is bound in place of the instance buffer. Non-instanced
+    // batches keep their commands and are expected to be culled on the CPU.
+    // Returns the offset of the first command.
+    static uint
+    cullInstancesGPU(const std::vector<DrawBatch> &batches,
+                     const std::vector<DrawItem> &items,
+                     const std::vector<InstanceData> &instances,
+                     const Frustum* frustums, uint numViews)
+    {
+      auto& frameData = storage->frameData;
+      auto& commands = storage->indirectCommands;
+      buildIndirectCommands(batches, items);
+
+      uint numBatches = batches.size();
+      uint numInstances = instances.size();
+
+      // The GPU fills in the instance counts. Each view gets its own copy of
+      // the instance data.
+      commands.resize(numViews * numBatches);
+      for (uint i = 0; i < numBatches; i++)
       {
-        auto& [data, materials, transform, id, drawSelectionMask] = drawable;
-        for (auto& submesh : data->getSubmeshes())
+        if (batches[i].instanced)
+          commands[i].instanceCount = 0;
+      }
+      for (uint i = 1; i < numViews; i++)
+      {
+        for (uint j = 0; j < numBatches; j++)
         {
-          // Cull the submesh if it isn't in the frustum.
-          glm::vec3 min = submesh.getMinPos();
-          glm::vec3 max = submesh.getMaxPos();
-
-          if (!boundingBoxInFrustum(storage->camFrustum, min, max, transform) && state->frustumCull)
-            continue;
+          commands[i * numBatches + j] = commands[j];
+          commands[i * numBatches + j].baseInstance += i * numInstances;
+        }
+      }
 
-          Material* material = materials->getMaterial(submesh.getName());
-          if (!material)
-            continue;
+      storage->geometryArena->reserveInstanceIDs(numViews * numInstances);
 
-          storage->transformBuffer.setData(0, sizeof(glm::mat4), glm::value_ptr(transform));
+      if (commands.empty())
+        return 0;
 
-          glm::vec4 maskColourID;
-          if (drawSelectionMask)
-          {
-            // Enable edge detection for selected mesh outlines.
-            storage->drawEdge = true;
-            maskColourID = glm::vec4(1.0f);
-          }
-          else
-            maskColourID = glm::vec4(0.0f);
+      uint commandSize = commands.size() * sizeof(DrawElementsIndirectCommand);
+      if (numInstances == 0)
+      {
+        uint offset = frameData.allocate(commandSize, commands.data());
+        frameData.bindDrawIndirect();
+        return offset;
+      }
 
-          maskColourID.w = id + 1.0f;
-          storage->editorBuffer.setData(0, sizeof(glm::vec4), &maskColourID.x);
+      auto& instanceBatches = storage->instanceBatches;
+      auto& batchBounds = storage->batchBounds;
+      instanceBatches.resize(numInstances);
+      batchBounds.resize(2 * numBatches);
+      for (uint i = 0; i < numBatches; i++)
+      {
+        auto& batch = batches[i];
+        auto& item = items[batch.firstItem];
+        Mesh* mesh = item.mesh;
 
-          material->configure();
+        // Skinned batches are never shared, cull them with their posed bounds.
+        if (item.skinnedVertex >= 0)
+        {
+          auto& submeshes = storage->renderables[item.renderable].model->getSubmeshes();
+          uint boxIndex = storage->boundsOffsets[item.renderable] + (mesh - submeshes.data());
+          batchBounds[2 * i] = storage->posedBounds[2 * boxIndex];
+          batchBounds[2 * i + 1] = storage->posedBounds[2 * boxIndex + 1];
+        }
+        else
+        {
+          batchBounds[2 * i] = glm::vec4(mesh->getMinPos(), 1.0f);
+          batchBounds[2 * i + 1] = glm::vec4(mesh->getMaxPos(), 1.0f);
+        }
 
-          if (submesh.hasVAO())
-            Renderer3D::draw(submesh.getVAO(), program);
-          else
-          {
-            submesh.generateVAO();
-            Renderer3D::draw(submesh.getVAO(), program);
-          }
+        if (batch.instanced)
+        {
+          for (uint j = 0; j < batch.numItems; j++)
+            instanceBatches[batch.firstInstance + j] = i;
+        }
+      }
 
-          stats->drawCalls++;
-          stats->numVertices += submesh.getData().size();
-          stats->numTriangles += submesh.getIndices().size() / 3;
+      CullViewBlock viewBlock;
+      for (uint i = 0; i < numViews; i++)
+      {
+        for (uint j = 0; j < 6; j++)
+        {
+          const Plane &plane = frustums[i].sides[j];
+          viewBlock.planes[i * 6 + j] = glm::vec4(plane.normal, plane.d);
         }
       }
+      viewBlock.settings = glm::uvec4(numInstances, numBatches, numViews,
+                                      state->frustumCull ? 1 : 0);
+
+      // Bind every range right after allocating it, the ring might be
+      // replaced by a later allocation.
+      uint dataSize = numInstances * sizeof(InstanceData);
+      uint offset = frameData.allocate(dataSize, instances.data());
+      frameData.bindStorageRange(0, offset, dataSize);
+
+      dataSize = numInstances * sizeof(uint);
+      offset = frameData.allocate(dataSize, instanceBatches.data());
+      frameData.bindStorageRange(1, offset, dataSize);
+
+      dataSize = batchBounds.size() * sizeof(glm::vec4);
+      offset = frameData.allocate(dataSize, batchBounds.data());
+      frameData.bindStorageRange(2, offset, dataSize);
+
+      dataSize = numViews * numInstances * sizeof(InstanceData);
+      offset = frameData.allocate(dataSize, nullptr);
+      frameData.bindStorageRange(5, offset, dataSize);
+
+      offset = frameData.allocate(sizeof(CullViewBlock), &viewBlock);
+      frameData.bindUniformRange(1, offset, sizeof(CullViewBlock));
 
-      // Dynamic geometry pass.
-      program = ShaderCache::getShader("dynamic_geometry_pass");
-      storage->boneBuffer.bindToPoint(4);
-      for (auto& drawable : storage->dynamicRenderQueue)
+      uint commandOffset = frameData.allocate(commandSize, commands.data());
+      frameData.bindStorageRange(3, commandOffset, commandSize);
+      frameData.bindDrawIndirect();
+
+      ShaderCache::getShader("instance_culling")->launchCompute((numInstances + 63) / 64,
+                                                                  numViews, 1);
+      Shader::memoryBarrier(MemoryBarrierType::ShaderStorage);
+      Shader::memoryBarrier(MemoryBarrierType::Command);
+
+      return commandOffset;
+    }
+
+    // Upload the per-draw data of a non-instanced submesh to the ring and
+    // bind it. The bones are already in the palette, see bindBonePalette().
+    // The editor data is only needed by the geometry pass.
+    static void
+    bindRenderableData(uint renderable, Mesh* mesh, const glm::vec4* maskColourID)
+    {
+      auto& frameData = storage->frameData;
+
+      // gl_VertexID includes the base vertex, the offset relies on unsigned
+      // wrap around when the skin range comes before the vertex range.
+      auto& allocation = mesh->getArenaAllocation();
+      uint skinOffset = allocation.getFirstSkinVertex() - allocation.getBaseVertex();
+
+      ModelBlock block;
+      block.transform = storage->renderables[renderable].transform;
+      block.boneOffset = glm::uvec4(storage->boneOffsets[renderable], skinOffset, 0, 0);
+      uint offset = frameData.allocate(sizeof(ModelBlock), &block);
+      frameData.bindUniformRange(2, offset, sizeof(ModelBlock));
+
+      if (maskColourID)
       {
-        auto& [data, animation, materials, transform, id, drawSelectionMask] = drawable;
+        offset = frameData.allocate(sizeof(glm::vec4), maskColourID);
+        frameData.bindUniformRange(3, offset, sizeof(glm::vec4));
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    // Compute skinning pre-pass.
+    //--------------------------------------------------------------------------
+    // The skinned vertices are written to a range of the geometry arena, so
+    // the geometry and shadow passes draw animated submeshes like static ones
+    // without skinning them once per pass.
+    void
+    skinningPass()
+    {
+      if (!storage->boundsComputed)
+        computeSubmeshBounds();
+
+      // The palette stays bound for the vertex shader skinning in the passes.
+      bindBonePalette();
 
-        auto& bones = animation->getFinalBoneTransforms();
-        storage->boneBuffer.setData(0, bones.size() * sizeof(glm::mat4),
-                                    bones.data());
+      if (storage->numSkinnedVertices == 0)
+        return;
 
-        for (auto& submesh : data->getSubmeshes())
+      auto& frameData = storage->frameData;
+      auto& arena = *storage->geometryArena;
+      auto& renderables = storage->renderables;
+      auto& skinnedOffsets = storage->skinnedVertexOffsets;
+
+      // The source vertices need to be in the arena before the range is
+      // reserved, both can grow the vertex buffer.
+      for (uint i = 0; i < renderables.size(); i++)
+      {
+        auto& submeshes = renderables[i].model->getSubmeshes();
+        for (uint j = 0; j < submeshes.size(); j++)
         {
-          // Cull the submesh if it isn't in the frustum.
-          glm::vec3 min = submesh.getMinPos();
-          glm::vec3 max = submesh.getMaxPos();
+          if (skinnedOffsets[storage->boundsOffsets[i] + j] >= 0 && !submeshes[j].isInArena())
+            submeshes[j].uploadToArena(arena);
+        }
+      }
 
-          if (!boundingBoxInFrustum(storage->camFrustum, min, max, transform) && state->frustumCull)
-            continue;
+      auto& skinnedVertices = storage->skinnedVertices;
+      if (!skinnedVertices.isValid() || skinnedVertices.getNumVertices() < storage->numSkinnedVertices)
+      {
+        skinnedVertices.release();
+        skinnedVertices = arena.allocateVertices(storage->numSkinnedVertices);
+      }
 
-          Material* material = materials->getMaterial(submesh.getName());
-          if (!material)
-          {
+      Shader* program = ShaderCache::getShader("compute_skinning");
+      arena.bindVertexStorage(0);
+      arena.bindSkinStorage(2);
+
+      for (uint i = 0; i < renderables.size(); i++)
+      {
+        uint firstBox = storage->boundsOffsets[i];
+        if (!renderables[i].animator)
+          continue;
+
+        auto& submeshes = renderables[i].model->getSubmeshes();
+        for (uint j = 0; j < submeshes.size(); j++)
+        {
+          int skinnedVertex = skinnedOffsets[firstBox + j];
+          if (skinnedVertex < 0)
             continue;
-          }
 
-          storage->transformBuffer.setData(0, sizeof(glm::mat4), glm::value_ptr(transform));
+          auto& allocation = submeshes[j].getArenaAllocation();
+          SkinningBlock block;
+          block.settings = glm::uvec4(allocation.getBaseVertex(),
+                                      skinnedVertices.getBaseVertex() + skinnedVertex,
+                                      allocation.getNumVertices(),
+                                      storage->boneOffsets[i]);
+          block.skinOffset = glm::uvec4(allocation.getFirstSkinVertex(), 0, 0, 0);
+          uint offset = frameData.allocate(sizeof(SkinningBlock), &block);
+          frameData.bindUniformRange(1, offset, sizeof(SkinningBlock));
+
+          program->launchCompute((allocation.getNumVertices() + 63) / 64, 1, 1);
+          stats->numSkinnedVertices += allocation.getNumVertices();
+        }
+      }
 
-          glm::vec4 maskColourID;
-          if (drawSelectionMask)
-          {
-            // Enable edge detection for selected mesh outlines.
-            storage->drawEdge = true;
-            maskColourID = glm::vec4(1.0f);
-          }
-          else
-            maskColourID = glm::vec4(0.0f);
+      // The arena copies the skinned vertices if it grows later in the frame.
+      Shader::memoryBarrier(MemoryBarrierType::VertexAttribArray);
+      Shader::memoryBarrier(MemoryBarrierType::BufferUpdate);
+    }
 
-          maskColourID.w = id + 1.0f;
-          storage->editorBuffer.setData(0, sizeof(glm::vec4), &maskColourID.x);
+    //--------------------------------------------------------------------------
+    // Deferred geometry pass.
+    //--------------------------------------------------------------------------
+    void geometryPass()
+    {
+      auto start = std::chrono::steady_clock::now();
 
-          material->configureDynamic(program);
+      // Start the geometry pass.
+      storage->gBuffer.beginGeoPass();
 
-          if (submesh.hasVAO())
-            Renderer3D::draw(submesh.getVAO(), program);
-          else
+      uint commandOffset = 0;
+      if (state->gpuCulling)
+      {
+        commandOffset = cullInstancesGPU(storage->geometryBatches, storage->geometryItems,
+                                         storage->geometryInstances, &storage->camFrustum, 1);
+      }
+      else
+      {
+        bindInstances(storage->geometryInstances);
+        commandOffset = uploadIndirectCommands(storage->geometryBatches,
+                                               storage->geometryItems,
+                                               storage->geometryInstances.size());
+      }
+
+      // Draw the sorted batches, only touching the state that changed between
+      // consecutive draws. Every mesh lives in the geometry arena so the VAO
+      // is bound once, and runs of instanced static batches sharing a
+      // material and an index type are merged into a single multi-draw.
+      Shader* staticProgram = ShaderCache::getShader("instanced_geometry_pass");
+      Shader* dynamicProgram = ShaderCache::getShader("dynamic_geometry_pass");
+
+      auto& arena = *storage->geometryArena;
+      arena.bind();
+      arena.bindSkinStorage(6);
+
+      auto& batches = storage->geometryBatches;
+      Shader* boundProgram = nullptr;
+      Material* boundMaterial = nullptr;
+      uint boundRenderable = std::numeric_limits<uint>::max();
+      Mesh* boundMesh = nullptr;
+      IndexType boundIndexType = IndexType::UnsignedInt;
+      arena.bindIndexBuffer(boundIndexType);
+      uint batchIndex = 0;
+      while (batchIndex < batches.size())
+      {
+        auto& batch = batches[batchIndex];
+        auto& item = storage->geometryItems[batch.firstItem];
+
+        Shader* program = batch.instanced ? staticProgram : dynamicProgram;
+        if (program != boundProgram)
+        {
+          program->bind();
+          boundProgram = program;
+
+          // Samplers are program state, the material needs to be configured again.
+          boundMaterial = nullptr;
+        }
+        else
+          stats->skippedShaderBinds++;
+
+        if (!batch.instanced && (item.renderable != boundRenderable || item.mesh != boundMesh))
+        {
+          auto& renderable = storage->renderables[item.renderable];
+
+          glm::vec4 maskColourID = renderable.drawSelectionMask ? glm::vec4(1.0f) : glm::vec4(0.0f);
+          maskColourID.w = renderable.id + 1.0f;
+
+          bindRenderableData(item.renderable, item.mesh, &maskColourID);
+
+          boundRenderable = item.renderable;
+          boundMesh = item.mesh;
+        }
+
+        IndexType indexType = item.mesh->getArenaAllocation().getIndexType();
+        if (indexType != boundIndexType)
+        {
+          arena.bindIndexBuffer(indexType);
+          boundIndexType = indexType;
+        }
+
+        if (item.material != boundMaterial)
+        {
+          item.material->configureDynamic(program);
+          boundMaterial = item.material;
+        }
+        else
+          stats->skippedMaterialBinds++;
+
+        // Find the end of the run of batches drawn by this call.
+        uint runEnd = batchIndex + 1;
+        if (batch.instanced)
+        {
+          while (runEnd < batches.size() && batches[runEnd].instanced)
           {
-            submesh.generateVAO();
-            Renderer3D::draw(submesh.getVAO(), program);
+            auto& next = storage->geometryItems[batches[runEnd].firstItem];
+            if (next.material != item.material ||
+                next.mesh->getArenaAllocation().getIndexType() != indexType)
+              break;
+            runEnd++;
           }
 
-          stats->drawCalls++;
-          stats->numVertices += submesh.getData().size();
-          stats->numTriangles += submesh.getIndices().size() / 3;
+          RendererCommands::multiDrawElementsIndirect(PrimativeType::Triangle,
+            commandOffset + batchIndex * sizeof(DrawElementsIndirectCommand),
+            runEnd - batchIndex, indexType);
+          stats->skippedMaterialBinds += runEnd - batchIndex - 1;
+        }
+        else
+        {
+          auto& command = storage->indirectCommands[batchIndex];
+          RendererCommands::drawElementsBaseVertex(PrimativeType::Triangle, command.count,
+                                                   command.firstIndex, command.baseVertex,
+                                                   indexType);
+        }
+
+        stats->drawCalls++;
+        for (; batchIndex < runEnd; batchIndex++)
+        {
+          auto& drawn = batches[batchIndex];
+          auto& allocation = storage->geometryItems[drawn.firstItem].mesh->getArenaAllocation();
+
+          stats->drawCommands++;
+          if (drawn.instanced)
+            stats->numInstances += drawn.numItems;
+          stats->numVertices += allocation.getNumVertices() * drawn.numItems;
+          stats->numTriangles += (storage->indirectCommands[batchIndex].count / 3) * drawn.numItems;
         }
       }
 
+      arena.unbind();
+      if (boundProgram)
+        boundProgram->unbind();
+
       storage->gBuffer.endGeoPass();
 
+      // Next frames cull against this frame's depth.
+      buildHiZ();
+
       auto end = std::chrono::steady_clock::now();
       std::chrono::duration<double> elapsed = end - start;
       stats->geoFrametime += elapsed.count() * 1000.0f;
@@ -433,7 +1540,7 @@ namespace Strontium
     // Low is a simple box blur, medium->ultra are gaussian with different number
     // of taps. Hard shadows are regular shadow maps with zero prefiltering.
     void
-    shadowPass()
+    cullShadowCasters()
     {
       auto start = std::chrono::steady_clock::now();
 
@@ -449,8 +1556,6 @@ namespace Strontium
 
       glm::mat4 camInvVP = storage->sceneCam.invViewProj;
 
-      Frustum lightCullingFrustums[NUM_CASCADES];
-
       float cascadeSplits[NUM_CASCADES];
       for (unsigned int i = 0; i < NUM_CASCADES; i++)
       {
@@ -466,11 +1571,14 @@ namespace Strontium
       // still need to cast shadows).
       glm::vec3 minPos = glm::vec3(std::numeric_limits<float>::max());
       glm::vec3 maxPos = glm::vec3(std::numeric_limits<float>::min());
-      for (auto& pair : storage->staticShadowQueue)
+      for (auto& renderable : storage->renderables)
       {
-        glm::mat4 mMatrix = pair.second;
-        minPos = glm::min(minPos, glm::vec3(mMatrix * glm::vec4(pair.first->getMinPos(), 1.0f)));
-        maxPos = glm::max(maxPos, glm::vec3(mMatrix * glm::vec4(pair.first->getMaxPos(), 1.0f)));
+        if (renderable.animator)
+          continue;
+
+        glm::mat4 mMatrix = renderable.transform;
+        minPos = glm::min(minPos, glm::vec3(mMatrix * glm::vec4(renderable.model->getMinPos(), 1.0f)));
+        maxPos = glm::max(maxPos, glm::vec3(mMatrix * glm::vec4(renderable.model->getMaxPos(), 1.0f)));
       }
 
       float sceneMaxRadius = glm::length(minPos);
@@ -581,7 +1689,8 @@ namespace Strontium
           cascadeProjMatrix[i] = texelSpaceOrtho;
 
           storage->cascades[i] = cascadeProjMatrix[i] * cascadeViewMatrix[i];
-          lightCullingFrustums[i] = buildCameraFrustum(storage->cascades[i], -lightDir);
+          storage->cascadeFrustums[i] = buildCameraFrustum(storage->cascades[i], -lightDir);
+          storage->cascadeDirection = -lightDir;
 
           previousCascadeDistance = cascadeSplits[i];
 
@@ -589,78 +1698,186 @@ namespace Strontium
         }
       }
 
+      // Cull the shadow casters against all of the cascades in one batch.
+      if (!storage->boundsComputed)
+        computeSubmeshBounds();
+
+      if (storage->hasCascades && state->frustumCull)
+      {
+        boundingBoxesInFrustums(storage->renderableBounds, storage->cascadeFrustums,
+                                NUM_CASCADES, storage->cascadeVisibility);
+      }
+      else
+      {
+        for (unsigned int i = 0; i < NUM_CASCADES; i++)
+          setAllVisible(storage->renderableBounds, storage->cascadeVisibility[i]);
+      }
+
+      buildShadowItems();
+
+      storage->shadowCastersCulled = true;
+
+      auto end = std::chrono::steady_clock::now();
+      std::chrono::duration<double> elapsed = end - start;
+      stats->shadowFrametime += elapsed.count() * 1000.0f;
+    }
+
+    void
+    shadowPass()
+    {
+      auto start = std::chrono::steady_clock::now();
+
       // Actual shadow pass.
       Shader* horizontalShadowBlur = ShaderCache::getShader("gaussian_hori");
       Shader* verticalShadowBlur = ShaderCache::getShader("gaussian_vert");
 
-      storage->transformBuffer.bindToPoint(2);
-
       if (storage->hasCascades)
       {
+        auto& batches = storage->shadowBatches;
+
+        // With GPU culling the static batches lead the list, are shared by
+        // all the cascades and have a set of commands per cascade. The sort
+        // key puts the static batches with 16 bit indices first.
+        uint commandOffset = 0;
+        uint numStaticBatches = 0;
+        uint numShortStaticBatches = 0;
+        if (state->gpuCulling)
+        {
+          commandOffset = cullInstancesGPU(batches, storage->shadowItems,
+                                           storage->shadowInstances,
+                                           storage->cascadeFrustums, NUM_CASCADES);
+
+          while (numStaticBatches < batches.size() && batches[numStaticBatches].instanced)
+          {
+            Mesh* mesh = storage->shadowItems[batches[numStaticBatches].firstItem].mesh;
+            if (mesh->getArenaAllocation().getIndexType() == IndexType::UnsignedShort)
+              numShortStaticBatches++;
+            numStaticBatches++;
+          }
+        }
+        else
+        {
+          bindInstances(storage->shadowInstances);
+          commandOffset = uploadIndirectCommands(batches, storage->shadowItems,
+                                                 storage->shadowInstances.size());
+        }
+
+        Shader* staticProgram = ShaderCache::getShader("instanced_shadow_shader");
+        Shader* dynamicProgram = ShaderCache::getShader("dynamic_shadow_shader");
+
+        auto& arena = *storage->geometryArena;
+        arena.bind();
+        arena.bindSkinStorage(6);
+
+        // The shadow batches are sorted by cascade first, walk them in order.
+        // Static batches come first within a cascade and are drawn with a
+        // multi-draw per index type. Transforms and bones stay valid between
+        // cascades.
+        Shader* boundProgram = nullptr;
+        uint boundRenderable = std::numeric_limits<uint>::max();
+        Mesh* boundMesh = nullptr;
+        IndexType boundIndexType = IndexType::UnsignedInt;
+        arena.bindIndexBuffer(boundIndexType);
+        uint batchIndex = numStaticBatches;
         for (unsigned int i = 0; i < NUM_CASCADES; i++)
         {
           storage->shadowBuffer[i].bind();
           storage->shadowBuffer[i].setViewport();
 
-          storage->cascadeShadowPassBuffer.bindToPoint(6);
-          storage->cascadeShadowPassBuffer.setData(0, sizeof(glm::mat4), glm::value_ptr(storage->cascades[i]));
+          uint cascadeOffset = storage->frameData.allocate(sizeof(glm::mat4), &storage->cascades[i]);
+          storage->frameData.bindUniformRange(6, cascadeOffset, sizeof(glm::mat4));
 
-          // Static shadow pass.
-          Shader* program = ShaderCache::getShader("static_shadow_shader");
-          for (auto& [model, transform] : storage->staticShadowQueue)
+          if (numStaticBatches > 0)
           {
-              storage->transformBuffer.setData(0, sizeof(glm::mat4), glm::value_ptr(transform));
+            if (staticProgram != boundProgram)
+            {
+              staticProgram->bind();
+              boundProgram = staticProgram;
+            }
+            else
+              stats->skippedShaderBinds++;
 
-              for (auto& submesh : model->getSubmeshes())
-              {
-                  // Cull the submesh if it isn't in the frustum.
-                  glm::vec3 min = submesh.getMinPos();
-                  glm::vec3 max = submesh.getMaxPos();
-
-                  if (!boundingBoxInFrustum(lightCullingFrustums[i], min, max, transform) && state->frustumCull)
-                      continue;
-
-                  if (submesh.hasVAO())
-                      Renderer3D::draw(submesh.getVAO(), program);
-                  else
-                  {
-                      submesh.generateVAO();
-                      Renderer3D::draw(submesh.getVAO(), program);
-                  }
-              }
+            uint cascadeCommands = commandOffset + i * batches.size() * sizeof(DrawElementsIndirectCommand);
+            if (numShortStaticBatches > 0)
+            {
+              arena.bindIndexBuffer(IndexType::UnsignedShort);
+              boundIndexType = IndexType::UnsignedShort;
+              RendererCommands::multiDrawElementsIndirect(PrimativeType::Triangle,
+                cascadeCommands, numShortStaticBatches, IndexType::UnsignedShort);
+            }
+            if (numStaticBatches > numShortStaticBatches)
+            {
+              arena.bindIndexBuffer(IndexType::UnsignedInt);
+              boundIndexType = IndexType::UnsignedInt;
+              RendererCommands::multiDrawElementsIndirect(PrimativeType::Triangle,
+                cascadeCommands + numShortStaticBatches * sizeof(DrawElementsIndirectCommand),
+                numStaticBatches - numShortStaticBatches, IndexType::UnsignedInt);
+            }
           }
 
-          // Dynamic shadow pass.
-          program = ShaderCache::getShader("dynamic_shadow_shader");
-          for (auto& drawable : storage->dynamicShadowQueue)
+          while (batchIndex < batches.size())
           {
-            auto& [data, animation, transform] = drawable;
-            storage->transformBuffer.setData(0, sizeof(glm::mat4), glm::value_ptr(transform));
+            auto& batch = batches[batchIndex];
+            auto& item = storage->shadowItems[batch.firstItem];
+            if (getSortKeyPass(item.sortKey) != i)
+              break;
 
-            auto& bones = animation->getFinalBoneTransforms();
-            storage->boneBuffer.setData(0, bones.size() * sizeof(glm::mat4),
-                bones.data());
+            Shader* program = batch.instanced ? staticProgram : dynamicProgram;
+            if (program != boundProgram)
+            {
+              program->bind();
+              boundProgram = program;
+            }
+            else
+              stats->skippedShaderBinds++;
 
-            for (auto& submesh : data->getSubmeshes())
+            IndexType indexType = item.mesh->getArenaAllocation().getIndexType();
+            if (indexType != boundIndexType)
             {
-              // Cull the submesh if it isn't in the frustum.
-              glm::vec3 min = submesh.getMinPos();
-              glm::vec3 max = submesh.getMaxPos();
+              arena.bindIndexBuffer(indexType);
+              boundIndexType = indexType;
+            }
 
-              if (!boundingBoxInFrustum(lightCullingFrustums[i], min, max, transform) && state->frustumCull)
-                  continue;
+            if (batch.instanced)
+            {
+              uint runEnd = batchIndex + 1;
+              while (runEnd < batches.size() && batches[runEnd].instanced)
+              {
+                auto& next = storage->shadowItems[batches[runEnd].firstItem];
+                if (getSortKeyPass(next.sortKey) != i ||
+                    next.mesh->getArenaAllocation().getIndexType() != indexType)
+                  break;
+                runEnd++;
+              }
 
-              if (submesh.hasVAO())
-                  Renderer3D::draw(submesh.getVAO(), program);
-              else
+              RendererCommands::multiDrawElementsIndirect(PrimativeType::Triangle,
+                commandOffset + batchIndex * sizeof(DrawElementsIndirectCommand),
+                runEnd - batchIndex, indexType);
+              batchIndex = runEnd;
+            }
+            else
+            {
+              if (item.renderable != boundRenderable || item.mesh != boundMesh)
               {
-                  submesh.generateVAO();
-                  Renderer3D::draw(submesh.getVAO(), program);
+                bindRenderableData(item.renderable, item.mesh, nullptr);
+
+                boundRenderable = item.renderable;
+                boundMesh = item.mesh;
               }
+
+              auto& command = storage->indirectCommands[batchIndex];
+              RendererCommands::drawElementsBaseVertex(PrimativeType::Triangle, command.count,
+                                                       command.firstIndex, command.baseVertex,
+                                                       indexType);
+              batchIndex++;
             }
           }
         }
 
+        arena.unbind();
+        if (boundProgram)
+          boundProgram->unbind();
+
         if (state->directionalSettings.x == 2)
         {
           // Apply a 2-pass 9 tap Gaussian blur to the shadow map.
@@ -695,14 +1912,140 @@ namespace Strontium
         }
       }
 
-      storage->staticShadowQueue.clear();
-      storage->dynamicShadowQueue.clear();
-
       auto end = std::chrono::steady_clock::now();
       std::chrono::duration<double> elapsed = end - start;
       stats->shadowFrametime += elapsed.count() * 1000.0f;
     }
 
+    // Upload the post processing constants to the ring and bind them.
+    static void
+    bindPostProcessBlock(const glm::vec2 &screenSize)
+    {
+      auto camPos = storage->sceneCam.position;
+
+      PostProcessBlock postBlock;
+      postBlock.invViewProj = storage->sceneCam.invViewProj;
+      postBlock.viewProj = storage->sceneCam.projection * storage->sceneCam.view;
+      postBlock.data0 = glm::vec4(camPos.x, camPos.y, camPos.z, screenSize.x);
+      postBlock.data1 = glm::vec4(screenSize.y, state->gamma, state->bloomIntensity, 0.0f);
+      postBlock.settings = state->postProcessSettings;
+
+      uint offset = storage->frameData.allocate(sizeof(PostProcessBlock), &postBlock);
+      storage->frameData.bindUniformRange(1, offset, sizeof(PostProcessBlock));
+    }
+
+    //--------------------------------------------------------------------------
+    // Clustered lighting. Point and spot lights are culled against a grid of
+    // view space clusters in compute, then shaded in a single fullscreen pass
+    // which only loops over the lights of the fragment's cluster.
+    //--------------------------------------------------------------------------
+    static void
+    clusteredLightPass()
+    {
+      auto& frameData = storage->frameData;
+      auto& pointLights = storage->pointQueue;
+      auto& spotLights = storage->spotQueue;
+
+      // The GPU is done with the statistics of the last frame which used this
+      // buffer, read them back before reusing it.
+      auto& statsBuffer = *storage->clusterStats[storage->currentClusterStats];
+      storage->currentClusterStats = (storage->currentClusterStats + 1) % NUM_RING_BUFFER_FRAMES;
+      if (statsBuffer.hasData())
+      {
+        glm::uvec4 clusterStats;
+        statsBuffer.getData(0, sizeof(glm::uvec4), &clusterStats.x);
+
+        stats->numActiveClusters = clusterStats.x;
+        stats->avgLightsPerCluster = clusterStats.x > 0 ? static_cast<float>(clusterStats.y) / clusterStats.x : 0.0f;
+        stats->maxLightsPerCluster = clusterStats.z;
+        stats->numOverflowedClusters = clusterStats.w;
+      }
+
+      glm::uvec4 clearedStats = glm::uvec4(0);
+      statsBuffer.setData(0, sizeof(glm::uvec4), &clearedStats.x);
+
+      if (pointLights.empty() && spotLights.empty())
+      {
+        stats->clusteredLightGPUTime = 0.0f;
+        return;
+      }
+
+      storage->clusteredLightTimer.begin();
+
+      // Upload the lights.
+      if (!pointLights.empty())
+      {
+        uint dataSize = pointLights.size() * sizeof(PointLight);
+        uint offset = frameData.allocate(dataSize, pointLights.data());
+        frameData.bindStorageRange(1, offset, dataSize);
+      }
+
+      if (!spotLights.empty())
+      {
+        std::vector<ClusterSpotLight> clusterSpotLights;
+        clusterSpotLights.reserve(spotLights.size());
+        for (auto& light : spotLights)
+        {
+          ClusterSpotLight spotLight;
+          spotLight.positionRadius = glm::vec4(light.position, light.radius);
+          spotLight.colourIntensity = glm::vec4(light.colour, light.intensity);
+          spotLight.direction = glm::vec4(light.direction, 0.0f);
+          spotLight.cutoffs = glm::vec4(light.innerCutoff, light.outerCutoff, 0.0f, 0.0f);
+          clusterSpotLights.push_back(spotLight);
+        }
+
+        uint dataSize = clusterSpotLights.size() * sizeof(ClusterSpotLight);
+        uint offset = frameData.allocate(dataSize, clusterSpotLights.data());
+        frameData.bindStorageRange(2, offset, dataSize);
+      }
+
+      const Camera &camera = storage->sceneCam;
+      glm::vec2 screenSize = storage->lightingPass.getSize();
+      float logDepthRatio = std::log(camera.far / camera.near);
+
+      ClusterBlock clusterBlock;
+      clusterBlock.invProjection = glm::inverse(camera.projection);
+      clusterBlock.screenSize = glm::vec4(screenSize.x, screenSize.y, 0.0f, 0.0f);
+      clusterBlock.nearFarScaleBias = glm::vec4(camera.near, camera.far,
+                                                CLUSTER_GRID_Z / logDepthRatio,
+                                                -CLUSTER_GRID_Z * std::log(camera.near) / logDepthRatio);
+      clusterBlock.gridSize = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z,
+                                         MAX_LIGHTS_PER_CLUSTER);
+      clusterBlock.lightCounts = glm::uvec4(pointLights.size(), spotLights.size(), 0, 0);
+
+      uint clusterOffset = frameData.allocate(sizeof(ClusterBlock), &clusterBlock);
+      frameData.bindUniformRange(8, clusterOffset, sizeof(ClusterBlock));
+
+      uint numGroups = (NUM_CLUSTERS + 127) / 128;
+
+      // Rebuild the cluster AABBs if the projection changed.
+      storage->clusterAABBs.bindToPoint(0);
+      if (storage->clusterProjection != camera.projection || storage->clusterScreenSize != screenSize)
+      {
+        ShaderCache::getShader("cluster_aabbs")->launchCompute(numGroups, 1, 1);
+        Shader::memoryBarrier(MemoryBarrierType::ShaderStorage);
+
+        storage->clusterProjection = camera.projection;
+        storage->clusterScreenSize = screenSize;
+      }
+
+      // Build the light lists of each cluster.
+      storage->lightGrid.bindToPoint(3);
+      storage->lightIndices.bindToPoint(4);
+      statsBuffer.bindToPoint(5);
+      ShaderCache::getShader("cluster_light_culling")->launchCompute(numGroups, 1, 1);
+      Shader::memoryBarrier(MemoryBarrierType::ShaderStorage);
+
+      // Shade every light in one pass, blending is still enabled from the
+      // directional lights.
+      storage->blankVAO.bind();
+      ShaderCache::getShader("deferred_clustered_lights")->bind();
+      RendererCommands::drawArrays(PrimativeType::Triangle, 0, 3);
+
+      storage->clusteredLightTimer.end();
+      stats->clusteredLightGPUTime = storage->clusteredLightTimer.getElapsed();
+    }
+
     //--------------------------------------------------------------------------
     // Deferred lighting pass.
     //--------------------------------------------------------------------------
@@ -756,23 +2099,20 @@ namespace Strontium
       // Set the shadow map uniforms.
       if (storage->hasCascades)
       {
-        storage->cascadeShadowBuffer.bindToPoint(7);
+        CascadeShadowBlock cascadeBlock;
         for (unsigned int i = 0; i < NUM_CASCADES; i++)
         {
-          storage->cascadeShadowBuffer.setData(i * sizeof(glm::mat4), sizeof(glm::mat4),
-                                                glm::value_ptr(storage->cascades[i]));
-          storage->cascadeShadowBuffer.setData(NUM_CASCADES * sizeof(glm::mat4)
-                                                + i * sizeof(glm::vec4), sizeof(float),
-                                                &storage->cascadeSplits[i]);
+          cascadeBlock.lightVP[i] = storage->cascades[i];
+          cascadeBlock.splits[i] = glm::vec4(storage->cascadeSplits[i], 0.0f, 0.0f, 0.0f);
           if (state->directionalSettings.x == 2)
             storage->shadowBuffer[i].bindTextureID(FBOTargetParam::Colour0, i + 7);
           else
             storage->shadowBuffer[i].bindTextureID(FBOTargetParam::Depth, i + 7);
         }
-        storage->cascadeShadowBuffer.setData(NUM_CASCADES * sizeof(glm::mat4)
-                                              + NUM_CASCADES * sizeof(glm::vec4),
-                                              sizeof(glm::vec4),
-                                              &(state->shadowParams.x));
+        cascadeBlock.shadowParams = state->shadowParams;
+
+        uint cascadeOffset = storage->frameData.allocate(sizeof(CascadeShadowBlock), &cascadeBlock);
+        storage->frameData.bindUniformRange(7, cascadeOffset, sizeof(CascadeShadowBlock));
       }
 
       for (auto& light : storage->directionalQueue)
@@ -796,9 +2136,7 @@ namespace Strontium
              storage->shadowBuffer[i].bindTextureID(FBOTargetParam::Depth, i + 7);
 
            state->postProcessSettings.w = (uint)(storage->hasCascades && state->enableSkyshafts);
-           storage->postProcessSettings.bindToPoint(1);
-           storage->postProcessSettings.setData(0, sizeof(glm::mat4), glm::value_ptr(storage->sceneCam.invViewProj));
-           storage->postProcessSettings.setData(2 * sizeof(glm::mat4) + 2 * sizeof(glm::vec4), sizeof(glm::ivec4), &state->postProcessSettings.x);
+           bindPostProcessBlock(storage->lightingPass.getSize());
 
           // Launch the godray compute shaders.
           if (state->enableSkyshafts)
@@ -848,24 +2186,12 @@ namespace Strontium
       storage->directionalQueue.clear();
 
       //------------------------------------------------------------------------
-      // Point lighting subpass.
+      // Clustered point and spot lighting subpass.
       //------------------------------------------------------------------------
-      Shader* pointLight = ShaderCache::getShader("deferred_point");
-      storage->pointPassBuffer.bindToPoint(5);
-      for (auto& light : storage->pointQueue)
-      {
-        storage->pointPassBuffer.setData(0, sizeof(PointLight), &light);
-
-        storage->blankVAO.bind();
-        pointLight->bind();
-        RendererCommands::drawArrays(PrimativeType::Triangle, 0, 3);
-      }
+      clusteredLightPass();
       storage->pointQueue.clear();
-
-      //------------------------------------------------------------------------
-      // Spot lighting subpass.
-      //------------------------------------------------------------------------
       storage->spotQueue.clear();
+
       RendererCommands::disable(RendererFunction::Blending);
 
       //------------------------------------------------------------------------
@@ -973,22 +2299,9 @@ namespace Strontium
       // Generalized post processing shader.
       //------------------------------------------------------------------------
       // Prepare the post processing buffer.
-      storage->postProcessSettings.bindToPoint(1);
-      auto viewProj = storage->sceneCam.projection * storage->sceneCam.view;
-      auto invViewProj = storage->sceneCam.invViewProj;
-      auto camPos = storage->sceneCam.position;
-      auto screenSize = frontBuffer->getSize();
-      auto data0 = glm::vec4(camPos.x, camPos.y, camPos.z, screenSize.x);
-      auto data1 = glm::vec4(screenSize.y, state->gamma, state->bloomIntensity, 0.0f);
-
       state->postProcessSettings.y = (uint) state->enableBloom;
       state->postProcessSettings.z = (uint) state->enableFXAA;
-
-      storage->postProcessSettings.setData(0, sizeof(glm::mat4), glm::value_ptr(invViewProj));
-      storage->postProcessSettings.setData(sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(viewProj));
-      storage->postProcessSettings.setData(2 * sizeof(glm::mat4), sizeof(glm::vec4), &data0.x);
-      storage->postProcessSettings.setData(2 * sizeof(glm::mat4) + sizeof(glm::vec4), sizeof(glm::vec4), &data1.x);
-      storage->postProcessSettings.setData(2 * sizeof(glm::mat4) + 2 * sizeof(glm::vec4), sizeof(glm::ivec4), &state->postProcessSettings.x);
+      bindPostProcessBlock(frontBuffer->getSize());
 
       storage->lightingPass.bindTextureID(FBOTargetParam::Colour0, 0);
       storage->gBuffer.bindAttachment(FBOTargetParam::Colour4, 1);
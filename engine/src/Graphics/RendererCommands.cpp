@@ -80,6 +80,34 @@ namespace Strontium
     glDrawElements(static_cast<GLenum>(primative), count, GL_UNSIGNED_INT, indices);
   }
 
+  void
+  RendererCommands::drawElementsInstanced(PrimativeType primative, uint count,
+                                          uint instanceCount, const void* indices)
+  {
+    glDrawElementsInstanced(static_cast<GLenum>(primative), count, GL_UNSIGNED_INT,
+                            indices, instanceCount);
+  }
+
+  void
+  RendererCommands::drawElementsBaseVertex(PrimativeType primative, uint count,
+                                           uint firstIndex, int baseVertex,
+                                           IndexType indexType)
+  {
+    uint indexSize = indexType == IndexType::UnsignedShort ? sizeof(uint16_t) : sizeof(uint);
+    glDrawElementsBaseVertex(static_cast<GLenum>(primative), count,
+                             static_cast<GLenum>(indexType),
+                             (void*) (unsigned long) (firstIndex * indexSize), baseVertex);
+  }
+
+  void
+  RendererCommands::multiDrawElementsIndirect(PrimativeType primative, uint offset,
+                                              uint drawCount, IndexType indexType)
+  {
+    glMultiDrawElementsIndirect(static_cast<GLenum>(primative), static_cast<GLenum>(indexType),
+                                (void*) (unsigned long) offset, drawCount,
+                                sizeof(DrawElementsIndirectCommand));
+  }
+
   void 
   RendererCommands::drawArrays(PrimativeType primative, uint start, uint count)
   {
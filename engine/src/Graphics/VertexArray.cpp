@@ -99,6 +99,16 @@ namespace Strontium
         glVertexAttribIPointer(location, 2, GL_INT, size, (void*) (unsigned long) stride);
         break;
       }
+      case AttribType::Vec2Half:
+      {
+        glVertexAttribPointer(location, 2, GL_HALF_FLOAT, glNormalized, size, (void*) (unsigned long) stride);
+        break;
+      }
+      case AttribType::IVec4Short:
+      {
+        glVertexAttribIPointer(location, 4, GL_SHORT, size, (void*) (unsigned long) stride);
+        break;
+      }
     }
 
 		glEnableVertexAttribArray(location);
@@ -3,12 +3,35 @@
 // Project includes.
 #include "Scenes/Components.h"
 #include "Scenes/Entity.h"
+#include "Core/ThreadPool.h"
+
+// STL includes.
+#include <unordered_set>
+
+// Number of pose groups evaluated per animation job.
+#define ANIMATION_GROUPS_PER_JOB 4
+// Number of reduced rate animators blended per animation job.
+#define ANIMATION_BLENDS_PER_JOB 32
 
 namespace Strontium
 {
   Scene::Scene(const std::string &filepath)
-    : saveFilepath(filepath)
-  { }
+    : hierarchyChanged(true)
+    , occludersRemoved(true)
+    , saveFilepath(filepath)
+  {
+    // Adding or removing transforms and parents changes the order of the
+    // world transform updates.
+    this->sceneECS.on_construct<TransformComponent>().connect<&Scene::onHierarchyChanged>(*this);
+    this->sceneECS.on_destroy<TransformComponent>().connect<&Scene::onHierarchyChanged>(*this);
+    this->sceneECS.on_construct<ParentEntityComponent>().connect<&Scene::onHierarchyChanged>(*this);
+    this->sceneECS.on_destroy<ParentEntityComponent>().connect<&Scene::onHierarchyChanged>(*this);
+    this->sceneECS.on_construct<ChildEntityComponent>().connect<&Scene::onHierarchyChanged>(*this);
+    this->sceneECS.on_destroy<ChildEntityComponent>().connect<&Scene::onHierarchyChanged>(*this);
+
+    // Removed renderables leave holes in the depth the renderer culls against.
+    this->sceneECS.on_destroy<RenderableComponent>().connect<&Scene::onRenderableRemoved>(*this);
+  }
 
   Scene::~Scene()
   { }
@@ -77,7 +100,115 @@ namespace Strontium
   Scene::onUpdateRuntime(float dt)
   {
     this->updateAnimations(dt);
+    this->animateAmbient(dt);
+  }
 
+  void
+  Scene::onRenderEditor(Entity selectedEntity)
+  {
+    this->updateWorldTransforms();
+    this->prepareEnvironment();
+    this->submitLights();
+    this->computeDrawableTransforms();
+    this->updateStaticBatches(selectedEntity);
+    this->submitDrawables(selectedEntity);
+  }
+
+  void
+  Scene::onRenderRuntime()
+  {
+    this->updateWorldTransforms();
+    this->prepareEnvironment();
+    this->submitLights();
+    this->computeDrawableTransforms();
+    this->updateStaticBatches(Entity());
+    this->submitDrawables(Entity());
+  }
+
+  void
+  Scene::registerEditorTasks(TaskGraph &graph, float dt, Entity selectedEntity)
+  {
+    this->prepareComponentPools();
+
+    graph.addTask("Scene::Animation", [this, dt]() { this->updateAnimations(dt); });
+    graph.addDependency("Scene::Animation", "Scene::SubmitDrawables");
+
+    this->registerRenderTasks(graph, selectedEntity);
+  }
+
+  void
+  Scene::registerRuntimeTasks(TaskGraph &graph, float dt)
+  {
+    this->prepareComponentPools();
+
+    graph.addTask("Scene::Animation", [this, dt]() { this->updateAnimations(dt); });
+    graph.addDependency("Scene::Animation", "Scene::SubmitDrawables");
+
+    // The ambient light rotates the sun, which needs to happen before anything
+    // reads the transforms.
+    graph.addTask("Scene::AmbientAnimation", [this, dt]() { this->animateAmbient(dt); });
+    graph.addDependency("Scene::AmbientAnimation", "Scene::Environment");
+    graph.addDependency("Scene::AmbientAnimation", "Scene::WorldTransforms");
+
+    this->registerRenderTasks(graph, Entity());
+  }
+
+  void
+  Scene::registerRenderTasks(TaskGraph &graph, Entity selectedEntity)
+  {
+    // Precomputing the environment needs the OpenGL context.
+    graph.addTask("Scene::Environment", [this]() { this->prepareEnvironment(); },
+                  TaskAffinity::MainThread);
+    graph.addTask("Scene::WorldTransforms", [this]() { this->updateWorldTransforms(); });
+    graph.addTask("Scene::SubmitLights", [this]() { this->submitLights(); });
+    graph.addTask("Scene::Transforms", [this]() { this->computeDrawableTransforms(); });
+    graph.addTask("Scene::StaticBatching", [this, selectedEntity]()
+    {
+      this->updateStaticBatches(selectedEntity);
+    });
+    graph.addTask("Scene::SubmitDrawables", [this, selectedEntity]()
+    {
+      this->submitDrawables(selectedEntity);
+    });
+
+    graph.addDependency("Scene::WorldTransforms", "Scene::SubmitLights");
+    graph.addDependency("Scene::WorldTransforms", "Scene::Transforms");
+    graph.addDependency("Scene::Transforms", "Scene::SubmitDrawables");
+    graph.addDependency("Scene::WorldTransforms", "Scene::StaticBatching");
+    graph.addDependency("Scene::StaticBatching", "Scene::SubmitDrawables");
+
+    // Submission has to happen after the renderer begins a frame and before
+    // the renderer consumes the queues.
+    graph.addDependency("Renderer3D::Begin", "Scene::Environment");
+    graph.addDependency("Renderer3D::Begin", "Scene::SubmitLights");
+    graph.addDependency("Renderer3D::Begin", "Scene::SubmitDrawables");
+    graph.addDependency("Scene::Environment", "Renderer3D::GeometryPass");
+    graph.addDependency("Scene::SubmitDrawables", "Renderer3D::ComputeBounds");
+    graph.addDependency("Scene::SubmitLights", "Renderer3D::ShadowCasterCulling");
+    graph.addDependency("Scene::SubmitLights", "Renderer3D::LightingPass");
+  }
+
+  // entt creates component pools and groups lazily. Make sure they exist
+  // before the stages touch the registry from other threads.
+  void
+  Scene::prepareComponentPools()
+  {
+    this->sceneECS.prepare<ParentEntityComponent>();
+    this->sceneECS.prepare<ChildEntityComponent>();
+    this->sceneECS.prepare<TransformComponent>();
+    this->sceneECS.prepare<WorldTransformComponent>();
+    this->sceneECS.prepare<RenderableComponent>();
+
+    this->sceneECS.group<AmbientComponent>(entt::get<TransformComponent>);
+    this->sceneECS.group<DirectionalLightComponent>(entt::get<TransformComponent>);
+    this->sceneECS.group<PointLightComponent>(entt::get<TransformComponent>);
+    this->sceneECS.group<SpotLightComponent>(entt::get<TransformComponent>);
+    this->sceneECS.group<RenderableComponent>(entt::get<TransformComponent>);
+  }
+
+  void
+  Scene::animateAmbient(float dt)
+  {
     auto ambLight = this->sceneECS.group<AmbientComponent>(entt::get<TransformComponent>);
     for (auto entity : ambLight)
     {
@@ -99,7 +230,7 @@ namespace Strontium
   }
 
   void
-  Scene::onRenderEditor(Entity selectedEntity)
+  Scene::prepareEnvironment()
   {
     // Prepare the ambient component.
     auto ambLight = this->sceneECS.group<AmbientComponent>(entt::get<TransformComponent>);
@@ -135,7 +266,11 @@ namespace Strontium
         env->precomputeSpecular();
       }
     }
+  }
 
+  void
+  Scene::submitLights()
+  {
     // Group together the lights and submit them to the renderer.
     auto dirLight = this->sceneECS.group<DirectionalLightComponent>(entt::get<TransformComponent>);
     for (auto entity : dirLight)
@@ -146,155 +281,76 @@ namespace Strontium
     auto pointLight = this->sceneECS.group<PointLightComponent>(entt::get<TransformComponent>);
     for (auto entity : pointLight)
     {
-      auto [point, transform] = pointLight.get<PointLightComponent, TransformComponent>(entity);
-      glm::mat4 transformMatrix = (glm::mat4) transform;
+      auto& point = pointLight.get<PointLightComponent>(entity);
+      auto& worldTransform = this->sceneECS.get<WorldTransformComponent>(entity);
 
-      // If a drawable item has a transform hierarchy, compute the global
-      // transforms from local transforms.
-      auto currentEntity = Entity(entity, this);
-      if (currentEntity.hasComponent<ParentEntityComponent>())
-        transformMatrix = computeGlobalTransform(currentEntity);
-
-      Renderer3D::submit(point, transformMatrix);
+      Renderer3D::submit(point, worldTransform.worldMatrix);
     }
     auto spotLight = this->sceneECS.group<SpotLightComponent>(entt::get<TransformComponent>);
     for (auto entity : spotLight)
     {
-      auto [spot, transform] = spotLight.get<SpotLightComponent, TransformComponent>(entity);
-      glm::mat4 transformMatrix = (glm::mat4) transform;
-
-      // If a drawable item has a transform hierarchy, compute the global
-      // transforms from local transforms.
-      auto currentEntity = Entity(entity, this);
-      if (currentEntity.hasComponent<ParentEntityComponent>())
-        transformMatrix = computeGlobalTransform(currentEntity);
+      auto& spot = spotLight.get<SpotLightComponent>(entity);
+      auto& worldTransform = this->sceneECS.get<WorldTransformComponent>(entity);
 
-      Renderer3D::submit(spot, transformMatrix);
+      Renderer3D::submit(spot, worldTransform.worldMatrix);
     }
+  }
+
+  void
+  Scene::computeDrawableTransforms()
+  {
+    this->drawableTransforms.clear();
 
-    // Group together the transform and renderable components.
     auto drawables = this->sceneECS.group<RenderableComponent>(entt::get<TransformComponent>);
     for (auto entity : drawables)
     {
-      // Draw all the renderables with transforms.
-      auto [transform, renderable] = drawables.get<TransformComponent, RenderableComponent>(entity);
-      glm::mat4 transformMatrix = (glm::mat4) transform;
-
-      // If a drawable item has a transform hierarchy, compute the global
-      // transforms from local transforms.
-      auto currentEntity = Entity(entity, this);
-      if (currentEntity.hasComponent<ParentEntityComponent>())
-        transformMatrix = computeGlobalTransform(currentEntity);
-
-      bool selected = entity == selectedEntity;
-
-      // Submit the mesh + material + transform to the static deferred renderer queue.
-      if (renderable && !renderable.animator.animationRenderable())
-        Renderer3D::submit(renderable, renderable, transformMatrix,
-                           static_cast<float>(entity), selected);
-      // If it has a valid animation, instead submit it to the dynamic deferred renderer queue.
-      else if (renderable && renderable.animator.animationRenderable())
-        Renderer3D::submit(renderable, &renderable.animator, renderable,
-                           transformMatrix, static_cast<float>(entity), selected);
+      auto& worldTransform = this->sceneECS.get<WorldTransformComponent>(entity);
+      this->drawableTransforms.emplace_back(entity, worldTransform.worldMatrix);
     }
   }
 
   void
-  Scene::onRenderRuntime()
+  Scene::updateStaticBatches(Entity selectedEntity)
   {
-    // Prepare the ambient component.
-    auto ambLight = this->sceneECS.group<AmbientComponent>(entt::get<TransformComponent>);
-    for (auto entity : ambLight)
-    {
-      auto [ambient, transform] = ambLight.get<AmbientComponent, TransformComponent>(entity);
-
-      EnvironmentMap* env = ambient.ambient;
-      if (env->getDrawingType() == MapType::DynamicSky)
-      {
-        if (env->getDynamicSkyType() == DynamicSkyType::Preetham)
-        {
-          auto preethamSkyParams = env->getSkyParams<PreethamSkyParams>(DynamicSkyType::Preetham);
-
-          glm::mat4 rotation = glm::transpose(glm::inverse((glm::mat4)transform));
-          preethamSkyParams.sunPos = glm::vec3(rotation * glm::vec4(0.0, 1.0, 0.0, 0.0f));
-          preethamSkyParams.sunPos.z *= -1.0f;
-
-          env->setSkyModelParams<PreethamSkyParams>(preethamSkyParams);
-        }
-        else if (env->getDynamicSkyType() == DynamicSkyType::Hillaire)
-        {
-          auto hillaireSkyParams = env->getSkyParams<HillaireSkyParams>(DynamicSkyType::Hillaire);
-
-          glm::mat4 rotation = glm::transpose(glm::inverse((glm::mat4)transform));
-          hillaireSkyParams.sunPos = glm::vec3(rotation * glm::vec4(0.0, 1.0, 0.0, 0.0f));
-          hillaireSkyParams.sunPos *= -1.0f;
-
-          env->setSkyModelParams<HillaireSkyParams>(hillaireSkyParams);
-        }
+    this->staticBatcher.update(this->sceneECS, selectedEntity);
+  }
 
-        env->precomputeIrradiance();
-        env->precomputeSpecular();
-      }
-    }
+  void
+  Scene::submitDrawables(Entity selectedEntity)
+  {
+    this->staticBatcher.submit();
 
-    // Group together the lights and submit them to the renderer.
-    auto dirLight = this->sceneECS.group<DirectionalLightComponent>(entt::get<TransformComponent>);
-    for (auto entity : dirLight)
+    // Removed renderables and rebuilt batches leave holes in the depth the
+    // renderer culls against.
+    if (this->occludersRemoved || this->staticBatcher.getStats().numRebuiltBatches > 0)
     {
-      auto [directional, transform] = dirLight.get<DirectionalLightComponent, TransformComponent>(entity);
-      Renderer3D::submit(directional.light, transform);
+      Renderer3D::invalidateOcclusion();
+      this->occludersRemoved = false;
     }
-    auto pointLight = this->sceneECS.group<PointLightComponent>(entt::get<TransformComponent>);
-    for (auto entity : pointLight)
-    {
-      auto [point, transform] = pointLight.get<PointLightComponent, TransformComponent>(entity);
-      glm::mat4 transformMatrix = (glm::mat4) transform;
-
-      // If a drawable item has a transform hierarchy, compute the global
-      // transforms from local transforms.
-      auto currentEntity = Entity(entity, this);
-      if (currentEntity.hasComponent<ParentEntityComponent>())
-        transformMatrix = computeGlobalTransform(currentEntity);
 
-      Renderer3D::submit(point, transformMatrix);
-    }
-    auto spotLight = this->sceneECS.group<SpotLightComponent>(entt::get<TransformComponent>);
-    for (auto entity : spotLight)
+    for (auto& [entity, transformMatrix] : this->drawableTransforms)
     {
-      auto [spot, transform] = spotLight.get<SpotLightComponent, TransformComponent>(entity);
-      glm::mat4 transformMatrix = (glm::mat4) transform;
-
-      // If a drawable item has a transform hierarchy, compute the global
-      // transforms from local transforms.
-      auto currentEntity = Entity(entity, this);
-      if (currentEntity.hasComponent<ParentEntityComponent>())
-        transformMatrix = computeGlobalTransform(currentEntity);
-
-      Renderer3D::submit(spot, transformMatrix);
-    }
+      // Static batches draw these.
+      if (this->staticBatcher.isBatched(entity))
+        continue;
 
-    // Group together the transform and renderable components.
-    auto drawables = this->sceneECS.group<RenderableComponent>(entt::get<TransformComponent>);
-    for (auto entity : drawables)
-    {
       // Draw all the renderables with transforms.
-      auto [transform, renderable] = drawables.get<TransformComponent, RenderableComponent>(entity);
-      glm::mat4 transformMatrix = (glm::mat4) transform;
+      auto& renderable = this->sceneECS.get<RenderableComponent>(entity);
 
-      // If a drawable item has a transform hierarchy, compute the global
-      // transforms from local transforms.
-      auto currentEntity = Entity(entity, this);
-      if (currentEntity.hasComponent<ParentEntityComponent>())
-        transformMatrix = computeGlobalTransform(currentEntity);
+      bool selected = entity == selectedEntity;
+
+      auto& world = this->sceneECS.get<WorldTransformComponent>(entity);
+      const glm::mat4* previousTransform = world.moved ? &world.previousWorldMatrix : nullptr;
 
       // Submit the mesh + material + transform to the static deferred renderer queue.
       if (renderable && !renderable.animator.animationRenderable())
         Renderer3D::submit(renderable, renderable, transformMatrix,
-                           static_cast<float>(entity));
+                           static_cast<float>(entity), selected, previousTransform);
       // If it has a valid animation, instead submit it to the dynamic deferred renderer queue.
       else if (renderable && renderable.animator.animationRenderable())
         Renderer3D::submit(renderable, &renderable.animator, renderable,
-                           transformMatrix, static_cast<float>(entity));
+                           transformMatrix, static_cast<float>(entity), selected,
+                           previousTransform);
     }
   }
 
@@ -324,43 +380,220 @@ namespace Strontium
     return Entity();
   }
 
-  // Compute the global transform given a parent-child transform hierarchy.
-  // Only rotations and translation transforms.
-  glm::mat4
-  Scene::computeGlobalTransform(Entity entity)
+  void
+  Scene::onHierarchyChanged(entt::registry &registry, entt::entity entity)
   {
-    if (entity.hasComponent<ParentEntityComponent>())
+    this->hierarchyChanged = true;
+  }
+
+  void
+  Scene::onRenderableRemoved(entt::registry &registry, entt::entity entity)
+  {
+    this->occludersRemoved = true;
+  }
+
+  // Sort the entities with transforms (or children) so parents come before
+  // their children. Entities without a transform component pass the world
+  // transform of their parent through.
+  void
+  Scene::rebuildTransformHierarchy()
+  {
+    auto& hierarchy = this->transformHierarchy;
+    auto& parents = this->transformParents;
+    hierarchy.clear();
+    parents.clear();
+
+    std::unordered_set<entt::entity> reached;
+
+    // Breadth first through the children of the entities from first onwards.
+    // Children already in the hierarchy are skipped, so a child listed twice
+    // or a cycle of parents can't loop forever.
+    auto addChildren = [this, &hierarchy, &parents, &reached](uint first)
     {
-      auto& parent = entity.getComponent<ParentEntityComponent>().parent;
-      if (entity.hasComponent<TransformComponent>())
+      for (uint i = first; i < hierarchy.size(); i++)
       {
-        auto& localTransform = entity.getComponent<TransformComponent>();
-        return computeGlobalTransform(parent) * (glm::mat4) localTransform;
+        auto children = this->sceneECS.try_get<ChildEntityComponent>(hierarchy[i]);
+        if (!children)
+          continue;
+
+        for (auto& child : children->children)
+        {
+          entt::entity childID = child;
+          if (!this->sceneECS.valid(childID) || !reached.insert(childID).second)
+            continue;
+
+          hierarchy.push_back(childID);
+          parents.push_back(static_cast<int>(i));
+        }
       }
-      else
-        return computeGlobalTransform(parent);
+    };
+
+    this->sceneECS.each([this, &hierarchy, &parents, &reached](auto entity)
+    {
+      if (this->sceneECS.has<ParentEntityComponent>(entity))
+        return;
+
+      if (this->sceneECS.has<TransformComponent>(entity)
+          || this->sceneECS.has<ChildEntityComponent>(entity))
+      {
+        hierarchy.push_back(entity);
+        parents.push_back(-1);
+        reached.insert(entity);
+      }
+    });
+    addChildren(0);
+
+    // Parented entities which weren't reached have a parent that's gone or
+    // doesn't list them. They're roots, their world transform is their local
+    // transform.
+    std::vector<entt::entity> orphans;
+    this->sceneECS.each([this, &reached, &orphans](auto entity)
+    {
+      if (this->sceneECS.has<ParentEntityComponent>(entity) && !reached.count(entity)
+          && (this->sceneECS.has<TransformComponent>(entity)
+              || this->sceneECS.has<ChildEntityComponent>(entity)))
+        orphans.push_back(entity);
+    });
+
+    for (auto orphan : orphans)
+    {
+      if (!reached.insert(orphan).second)
+        continue;
+
+      uint first = hierarchy.size();
+      hierarchy.push_back(orphan);
+      parents.push_back(-1);
+      addChildren(first);
     }
-    else
+
+    for (auto entity : hierarchy)
+      this->sceneECS.get_or_emplace<WorldTransformComponent>(entity);
+  }
+
+  // A single pass in parent first order. Parents are updated before their
+  // children, so their dirty flags are already valid for this frame.
+  void
+  Scene::updateWorldTransforms()
+  {
+    bool updateAll = this->hierarchyChanged;
+    if (this->hierarchyChanged)
     {
-      if (entity.hasComponent<TransformComponent>())
+      this->rebuildTransformHierarchy();
+      this->hierarchyChanged = false;
+    }
+
+    for (uint i = 0; i < this->transformHierarchy.size(); i++)
+    {
+      entt::entity entity = this->transformHierarchy[i];
+      auto& world = this->sceneECS.get<WorldTransformComponent>(entity);
+
+      bool localChanged = false;
+      auto transform = this->sceneECS.try_get<TransformComponent>(entity);
+      if (transform)
+      {
+        localChanged = transform->translation != world.localTranslation
+                       || transform->rotation != world.localRotation
+                       || transform->scale != world.localScale;
+      }
+
+      if (localChanged || updateAll)
       {
-        auto& localTransform = entity.getComponent<TransformComponent>();
-        return (glm::mat4) localTransform;
+        world.localTranslation = transform ? transform->translation : glm::vec3(0.0f);
+        world.localRotation = transform ? transform->rotation : glm::vec3(0.0f);
+        world.localScale = transform ? transform->scale : glm::vec3(1.0f);
+        world.localMatrix = transform ? (glm::mat4) *transform : glm::mat4(1.0f);
+      }
+
+      WorldTransformComponent* parentWorld = nullptr;
+      if (this->transformParents[i] >= 0)
+      {
+        entt::entity parent = this->transformHierarchy[this->transformParents[i]];
+        parentWorld = &this->sceneECS.get<WorldTransformComponent>(parent);
+      }
+
+      world.dirty = localChanged || updateAll || (parentWorld && parentWorld->dirty);
+      world.moved = false;
+      if (world.dirty)
+      {
+        world.previousWorldMatrix = world.worldMatrix;
+        world.worldMatrix = parentWorld ? parentWorld->worldMatrix * world.localMatrix
+                                        : world.localMatrix;
+        world.moved = world.computed && world.worldMatrix != world.previousWorldMatrix;
+        world.computed = true;
       }
-      else
-        return glm::mat4(1.0f);
     }
   }
 
   void
   Scene::updateAnimations(float dt)
   {
-    // Get all the renderable components to update animations.
+    // Advance the clocks of all the animators, only keeping the ones which
+    // have a stale pose.
+    this->animationUpdates.clear();
+    this->animationBlends.clear();
     auto renderables = this->sceneECS.view<RenderableComponent>();
     for (auto entity : renderables)
     {
-      auto& renderable = renderables.get<RenderableComponent>(entity);
-      renderable.animator.onUpdate(dt);
+      auto& animator = renderables.get<RenderableComponent>(entity).animator;
+      if (animator.advance(dt))
+      {
+        this->animationUpdates.push_back({ &animator, animator.getStoredAnimation(),
+                                           animator.getSampleIndex(),
+                                           animator.getDroppedBoneLevels() });
+      }
+
+      if (animator.animationRenderable() && animator.getUpdateInterval() > 1)
+        this->animationBlends.push_back(&animator);
+    }
+
+    if (!this->animationUpdates.empty())
+    {
+      std::sort(this->animationUpdates.begin(), this->animationUpdates.end(),
+                [](const AnimationUpdate &lhs, const AnimationUpdate &rhs)
+      {
+        if (lhs.animation != rhs.animation)
+          return std::less<const Animation*>()(lhs.animation, rhs.animation);
+        if (lhs.sample != rhs.sample)
+          return lhs.sample < rhs.sample;
+        return lhs.droppedBoneLevels < rhs.droppedBoneLevels;
+      });
+
+      // Split the updates into groups which share a pose. The last entry is
+      // the end of the final group.
+      this->animationGroups.clear();
+      for (uint i = 0; i < this->animationUpdates.size(); i++)
+      {
+        auto& update = this->animationUpdates[i];
+        if (i == 0 || update.animation != this->animationUpdates[i - 1].animation
+            || update.sample != this->animationUpdates[i - 1].sample
+            || update.droppedBoneLevels != this->animationUpdates[i - 1].droppedBoneLevels)
+          this->animationGroups.push_back(i);
+      }
+      this->animationGroups.push_back(this->animationUpdates.size());
+
+      uint numGroups = this->animationGroups.size() - 1;
+      ThreadPool::getInstance()->parallelFor(numGroups, ANIMATION_GROUPS_PER_JOB,
+                                             [this](uint start, uint end)
+      {
+        for (uint group = start; group < end; group++)
+        {
+          uint first = this->animationGroups[group];
+          uint last = this->animationGroups[group + 1];
+
+          Animator* leader = this->animationUpdates[first].animator;
+          leader->evaluate();
+          for (uint i = first + 1; i < last; i++)
+            this->animationUpdates[i].animator->copyPose(*leader);
+        }
+      });
     }
+
+    // Blend the reduced rate animators once all the new poses are in.
+    ThreadPool::getInstance()->parallelFor(this->animationBlends.size(), ANIMATION_BLENDS_PER_JOB,
+                                           [this](uint start, uint end)
+    {
+      for (uint i = start; i < end; i++)
+        this->animationBlends[i]->blendPose();
+    });
   }
 }
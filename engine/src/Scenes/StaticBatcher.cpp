@@ -0,0 +1,451 @@
+#include "Scenes/StaticBatcher.h"
+
+// Project includes.
+#include "Core/ThreadPool.h"
+#include "Graphics/Renderer.h"
+#include "Scenes/Components.h"
+#include "Utils/AsyncAssetLoading.h"
+
+namespace Strontium
+{
+  //----------------------------------------------------------------------------
+  // Batch building helpers.
+  //----------------------------------------------------------------------------
+  static bool
+  isStatic(entt::registry &registry, entt::entity entity, RenderableComponent &renderable)
+  {
+    if (registry.has<ParentEntityComponent>(entity) || !registry.has<WorldTransformComponent>(entity))
+      return false;
+
+    if (renderable.animator.animationRenderable() || renderable.animationHandle != "")
+      return false;
+
+    Model* model = renderable;
+    if (!model || !model->isLoaded())
+      return false;
+
+    uint numVertices = 0;
+    for (auto& submesh : model->getSubmeshes())
+    {
+      if (!submesh.isLoaded() || submesh.isSkinned()
+          || !renderable.materials.getMaterial(submesh.getName()))
+        return false;
+
+      numVertices += submesh.getData().size();
+    }
+
+    return numVertices > 0 && numVertices <= STATIC_BATCH_MAX_SOURCE_VERTICES;
+  }
+
+  static glm::vec3
+  safeNormalize(const glm::vec3 &vector, const glm::vec3 &fallback)
+  {
+    float length = glm::length(vector);
+    return length > 1e-8f ? vector / length : fallback;
+  }
+
+  // A submesh of a source entity, merged into a batch submesh.
+  struct BatchedSubmesh
+  {
+    Mesh* submesh;
+    const glm::mat4* transform;
+  };
+
+  // Move the vertices of a submesh into world space. The tangent is
+  // re-orthogonalized against the normal since non-uniform scales skew them,
+  // and the bitangent sign flips with mirroring transforms.
+  static void
+  appendVertices(Mesh &batch, Mesh &submesh, const glm::mat4 &transform)
+  {
+    glm::mat3 linear = glm::mat3(transform);
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+    float handedness = glm::determinant(linear) < 0.0f ? -1.0f : 1.0f;
+
+    auto& vertices = batch.getData();
+    auto& minPos = batch.getMinPos();
+    auto& maxPos = batch.getMaxPos();
+    for (auto& vertex : submesh.getData())
+    {
+      glm::vec3 normal = vertex.getNormal();
+      glm::vec3 tangent = vertex.getTangent();
+
+      glm::vec3 worldNormal = safeNormalize(normalMatrix * normal, normal);
+      glm::vec3 worldTangent = linear * tangent;
+      worldTangent = safeNormalize(worldTangent - worldNormal * glm::dot(worldNormal, worldTangent),
+                                   tangent);
+      glm::vec3 worldBitangent = glm::cross(worldNormal, worldTangent)
+                                 * vertex.getBitangentSign() * handedness;
+
+      Vertex batched;
+      batched.position = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+      batched.setFrame(worldNormal, worldTangent, worldBitangent);
+      batched.uv = vertex.uv;
+      vertices.push_back(batched);
+
+      minPos = glm::min(minPos, batched.position);
+      maxPos = glm::max(maxPos, batched.position);
+    }
+  }
+
+  // Move the meshlets of a submesh into world space, offset to where its
+  // indices start in the batch. Submeshes without meshlets become a single
+  // meshlet. Normal cones only survive uniform scales, the angles of the
+  // others are skewed so their cones are dropped.
+  static void
+  appendMeshlets(Mesh &batch, Mesh &submesh, const glm::mat4 &transform, uint firstIndex)
+  {
+    glm::mat3 linear = glm::mat3(transform);
+    glm::vec3 scales = glm::vec3(glm::length(linear[0]), glm::length(linear[1]),
+                                 glm::length(linear[2]));
+    float maxScale = std::max(scales.x, std::max(scales.y, scales.z));
+    float minScale = std::min(scales.x, std::min(scales.y, scales.z));
+    bool uniform = maxScale - minScale <= 1e-3f * maxScale;
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+
+    auto& meshlets = batch.getMeshlets();
+    if (!submesh.hasMeshlets())
+    {
+      // Bound the transformed corners of the submesh's box.
+      glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+      glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+      for (uint i = 0; i < 8; i++)
+      {
+        glm::vec3 corner = glm::vec3((i & 1) ? submesh.getMaxPos().x : submesh.getMinPos().x,
+                                     (i & 2) ? submesh.getMaxPos().y : submesh.getMinPos().y,
+                                     (i & 4) ? submesh.getMaxPos().z : submesh.getMinPos().z);
+        corner = glm::vec3(transform * glm::vec4(corner, 1.0f));
+        min = glm::min(min, corner);
+        max = glm::max(max, corner);
+      }
+
+      Meshlet meshlet;
+      meshlet.sphere = glm::vec4(0.5f * (min + max), 0.5f * glm::length(max - min));
+      meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+      meshlet.firstIndex = firstIndex;
+      meshlet.numIndices = submesh.getLOD(0).numIndices;
+      meshlets.push_back(meshlet);
+      return;
+    }
+
+    for (auto& source : submesh.getMeshlets())
+    {
+      Meshlet meshlet;
+      meshlet.sphere = glm::vec4(glm::vec3(transform * glm::vec4(glm::vec3(source.sphere), 1.0f)),
+                                 source.sphere.w * maxScale);
+      if (uniform && source.cone.w < 1.0f)
+      {
+        glm::vec3 axis = safeNormalize(normalMatrix * glm::vec3(source.cone), glm::vec3(0.0f));
+        meshlet.cone = glm::vec4(axis, source.cone.w);
+      }
+      else
+        meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+      meshlet.firstIndex = firstIndex + source.firstIndex;
+      meshlet.numIndices = source.numIndices;
+      meshlets.push_back(meshlet);
+    }
+  }
+
+  // Merge submeshes into a batch submesh. Every LOD of the batch is the
+  // concatenation of the same LOD of each submesh, submeshes with shorter
+  // chains repeat their coarsest LOD. The errors are scaled into world units.
+  static void
+  buildBatchSubmesh(Mesh &batch, const std::vector<BatchedSubmesh> &submeshes)
+  {
+    uint numLODs = 1;
+    uint numVertices = 0;
+    for (auto& batched : submeshes)
+    {
+      numLODs = std::max(numLODs, batched.submesh->getNumLODs());
+      numVertices += batched.submesh->getData().size();
+    }
+
+    auto& vertices = batch.getData();
+    auto& indices = batch.getIndices();
+    vertices.reserve(numVertices);
+    batch.getMinPos() = glm::vec3(std::numeric_limits<float>::max());
+    batch.getMaxPos() = glm::vec3(std::numeric_limits<float>::lowest());
+
+    std::vector<uint> baseVertices;
+    baseVertices.reserve(submeshes.size());
+    for (auto& batched : submeshes)
+    {
+      baseVertices.push_back(vertices.size());
+      appendVertices(batch, *batched.submesh, *batched.transform);
+    }
+
+    for (uint lod = 0; lod < numLODs; lod++)
+    {
+      MeshLOD batchLOD = { static_cast<uint>(indices.size()), 0, 0.0f };
+      for (uint i = 0; i < submeshes.size(); i++)
+      {
+        Mesh &submesh = *submeshes[i].submesh;
+        if (lod == 0)
+          appendMeshlets(batch, submesh, *submeshes[i].transform, indices.size());
+
+        glm::mat3 linear = glm::mat3(*submeshes[i].transform);
+        float maxScale = std::max(glm::length(linear[0]),
+                                  std::max(glm::length(linear[1]), glm::length(linear[2])));
+
+        MeshLOD submeshLOD = submesh.getLOD(lod);
+        auto& submeshIndices = submesh.getIndices();
+        for (uint j = 0; j < submeshLOD.numIndices; j++)
+          indices.push_back(baseVertices[i] + submeshIndices[submeshLOD.firstIndex + j]);
+
+        batchLOD.error = std::max(batchLOD.error, submeshLOD.error * maxScale);
+      }
+
+      batchLOD.numIndices = indices.size() - batchLOD.firstIndex;
+      batch.getLODs().push_back(batchLOD);
+    }
+
+    // Meshes without a chain don't keep a LOD list.
+    if (numLODs == 1)
+      batch.getLODs().clear();
+
+    batch.setLoaded(true);
+  }
+
+  //----------------------------------------------------------------------------
+  // Static batcher here.
+  //----------------------------------------------------------------------------
+  StaticBatcher::StaticBatcher()
+    : enabled(false)
+  { }
+
+  StaticBatcher::~StaticBatcher()
+  { }
+
+  void
+  StaticBatcher::update(entt::registry &registry, entt::entity selectedEntity)
+  {
+    this->stats.numRebuiltBatches = 0;
+
+    if (!this->enabled)
+    {
+      if (!this->sources.empty() || !this->batches.empty())
+        this->clear();
+      return;
+    }
+
+    // Models trickling in would rebuild the same batches over and over, wait
+    // for the whole scene instead.
+    if (AsyncLoading::hasPendingModels())
+      return;
+
+    for (auto& [entity, source] : this->sources)
+      source.seen = false;
+
+    auto drawables = registry.group<RenderableComponent>(entt::get<TransformComponent>);
+    for (auto entity : drawables)
+    {
+      auto& renderable = drawables.get<RenderableComponent>(entity);
+      auto loc = this->sources.find(entity);
+
+      if (entity == selectedEntity || !isStatic(registry, entity, renderable))
+      {
+        if (loc != this->sources.end())
+        {
+          this->removeSource(entity, loc->second);
+          this->sources.erase(loc);
+        }
+        continue;
+      }
+
+      Model* model = renderable;
+      auto& submeshes = model->getSubmeshes();
+      const glm::mat4 &transform = registry.get<WorldTransformComponent>(entity).worldMatrix;
+
+      if (loc != this->sources.end())
+      {
+        auto& source = loc->second;
+        source.seen = true;
+
+        bool unchanged = source.model == model && source.transform == transform
+                         && source.materials.size() == submeshes.size();
+        for (uint i = 0; i < submeshes.size() && unchanged; i++)
+          unchanged = source.materials[i] == renderable.materials.getMaterialHandle(submeshes[i].getName());
+        if (unchanged)
+          continue;
+
+        this->removeSource(entity, source);
+        this->sources.erase(loc);
+      }
+
+      Source source;
+      source.model = model;
+      source.transform = transform;
+      source.seen = true;
+      for (auto& submesh : submeshes)
+        source.materials.push_back(renderable.materials.getMaterialHandle(submesh.getName()));
+
+      this->addSource(entity, this->sources.emplace(entity, std::move(source)).first->second);
+    }
+
+    // Entities which were deleted or lost their renderable.
+    for (auto loc = this->sources.begin(); loc != this->sources.end();)
+    {
+      if (loc->second.seen)
+      {
+        loc++;
+        continue;
+      }
+
+      this->removeSource(loc->first, loc->second);
+      loc = this->sources.erase(loc);
+    }
+
+    std::vector<Batch*> dirtyBatches;
+    for (auto loc = this->batches.begin(); loc != this->batches.end();)
+    {
+      if (loc->second.sources.empty())
+      {
+        loc = this->batches.erase(loc);
+        continue;
+      }
+
+      if (loc->second.dirty)
+        dirtyBatches.push_back(&loc->second);
+      loc++;
+    }
+
+    ThreadPool::getInstance()->parallelFor(dirtyBatches.size(), 1, [this, &dirtyBatches](uint start, uint end)
+    {
+      for (uint i = start; i < end; i++)
+        this->rebuildBatch(*dirtyBatches[i]);
+    });
+
+    this->stats.numBatches = this->batches.size();
+    this->stats.numSourceEntities = this->sources.size();
+    this->stats.numRebuiltBatches = dirtyBatches.size();
+    this->stats.numVertices = 0;
+    for (auto& [key, batch] : this->batches)
+      for (auto& submesh : batch.model->getSubmeshes())
+        this->stats.numVertices += submesh.getData().size();
+  }
+
+  void
+  StaticBatcher::submit()
+  {
+    // Batches don't have an entity of their own, so they can't be picked.
+    for (auto& [key, batch] : this->batches)
+    {
+      if (batch.model)
+        Renderer3D::submit(batch.model.get(), batch.materials, glm::mat4(1.0f), -1.0f, false);
+    }
+  }
+
+  void
+  StaticBatcher::clear()
+  {
+    this->batches.clear();
+    this->sources.clear();
+    this->stats = StaticBatchStats();
+  }
+
+  bool
+  StaticBatcher::isBatched(entt::entity entity) const
+  {
+    return this->sources.find(entity) != this->sources.end();
+  }
+
+  // Every submesh of an entity goes in the cell of the entity's center, so
+  // the entity is never split across cells.
+  void
+  StaticBatcher::addSource(entt::entity entity, Source &source)
+  {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+    for (auto& submesh : source.model->getSubmeshes())
+    {
+      min = glm::min(min, submesh.getMinPos());
+      max = glm::max(max, submesh.getMaxPos());
+    }
+
+    glm::vec3 center = glm::vec3(source.transform * glm::vec4(0.5f * (min + max), 1.0f));
+    glm::ivec3 cell = glm::ivec3(glm::floor(center / STATIC_BATCH_CELL_SIZE));
+
+    for (auto& material : source.materials)
+    {
+      BatchKey key = { material, cell };
+      auto& batch = this->batches[key];
+      if (std::find(source.batches.begin(), source.batches.end(), &batch) != source.batches.end())
+        continue;
+
+      batch.key = key;
+      batch.sources.push_back(entity);
+      batch.dirty = true;
+      source.batches.push_back(&batch);
+    }
+  }
+
+  void
+  StaticBatcher::removeSource(entt::entity entity, Source &source)
+  {
+    for (auto batch : source.batches)
+    {
+      auto loc = std::find(batch->sources.begin(), batch->sources.end(), entity);
+      if (loc != batch->sources.end())
+        batch->sources.erase(loc);
+      batch->dirty = true;
+    }
+    source.batches.clear();
+  }
+
+  // Rebuild the merged geometry of a batch from its sources. Only reads the
+  // sources, so batches can be rebuilt in parallel.
+  void
+  StaticBatcher::rebuildBatch(Batch &batch)
+  {
+    // Sources in entity order, so a batch is merged the same way every time.
+    std::sort(batch.sources.begin(), batch.sources.end());
+
+    std::vector<std::vector<BatchedSubmesh>> batchSubmeshes(1);
+    uint numVertices = 0;
+    for (auto entity : batch.sources)
+    {
+      auto& source = this->sources.at(entity);
+      auto& submeshes = source.model->getSubmeshes();
+      for (uint i = 0; i < submeshes.size(); i++)
+      {
+        if (source.materials[i] != batch.key.material)
+          continue;
+
+        uint submeshVertices = submeshes[i].getData().size();
+        if (numVertices + submeshVertices > STATIC_BATCH_MAX_VERTICES && numVertices > 0)
+        {
+          batchSubmeshes.emplace_back();
+          numVertices = 0;
+        }
+
+        batchSubmeshes.back().push_back({ &submeshes[i], &source.transform });
+        numVertices += submeshVertices;
+      }
+    }
+
+    batch.model = createUnique<Model>();
+    batch.materials = ModelMaterial();
+
+    auto& submeshes = batch.model->getSubmeshes();
+    submeshes.reserve(batchSubmeshes.size());
+    for (uint i = 0; i < batchSubmeshes.size(); i++)
+    {
+      std::string name = "StaticBatch" + std::to_string(i);
+      submeshes.emplace_back(name, batch.model.get());
+      buildBatchSubmesh(submeshes.back(), batchSubmeshes[i]);
+      batch.materials.attachMesh(name, batch.key.material);
+    }
+
+    // The renderer fits the shadow cascades around the model bounds.
+    auto& minPos = batch.model->getMinPos();
+    auto& maxPos = batch.model->getMaxPos();
+    minPos = glm::vec3(std::numeric_limits<float>::max());
+    maxPos = glm::vec3(-std::numeric_limits<float>::max());
+    for (auto& submesh : submeshes)
+    {
+      minPos = glm::min(minPos, submesh.getMinPos());
+      maxPos = glm::max(maxPos, submesh.getMaxPos());
+    }
+
+    batch.dirty = false;
+  }
+}
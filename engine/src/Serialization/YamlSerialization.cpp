@@ -466,11 +466,43 @@ namespace Strontium
 
       out << YAML::EndSeq;
 
+      out << YAML::Key << "StaticBatching" << YAML::Value << scene->getStaticBatcher().isEnabled();
+
       out << YAML::Key << "RendererSettings";
       out << YAML::BeginMap;
       out << YAML::Key << "BasicSettings";
       out << YAML::BeginMap;
       out << YAML::Key << "FrustumCull" << YAML::Value << state->frustumCull;
+      out << YAML::Key << "GPUCulling" << YAML::Value << state->gpuCulling;
+      out << YAML::Key << "ComputeSkinning" << YAML::Value << state->computeSkinning;
+      out << YAML::EndMap;
+
+      out << YAML::Key << "AnimationSettings";
+      out << YAML::BeginMap;
+      out << YAML::Key << "EnableLOD" << YAML::Value << state->animationLOD;
+      out << YAML::Key << "FullRateSize" << YAML::Value << state->aniLODFullRateSize;
+      out << YAML::Key << "HalfRateSize" << YAML::Value << state->aniLODHalfRateSize;
+      out << YAML::Key << "ReducedBonesSize" << YAML::Value << state->aniLODReducedBonesSize;
+      out << YAML::Key << "DroppedBoneLevels" << YAML::Value << state->aniLODDroppedBoneLevels;
+      out << YAML::Key << "FreezeOffscreen" << YAML::Value << state->aniLODFreezeOffscreen;
+      out << YAML::EndMap;
+
+      out << YAML::Key << "MeshLODSettings";
+      out << YAML::BeginMap;
+      out << YAML::Key << "EnableLOD" << YAML::Value << state->meshLOD;
+      out << YAML::Key << "ErrorThreshold" << YAML::Value << state->meshLODThreshold;
+      out << YAML::Key << "ShadowBias" << YAML::Value << state->meshLODShadowBias;
+      out << YAML::EndMap;
+
+      out << YAML::Key << "MeshletSettings";
+      out << YAML::BeginMap;
+      out << YAML::Key << "EnableCulling" << YAML::Value << state->meshletCulling;
+      out << YAML::Key << "ConeCulling" << YAML::Value << state->meshletConeCulling;
+      out << YAML::EndMap;
+
+      out << YAML::Key << "OcclusionSettings";
+      out << YAML::BeginMap;
+      out << YAML::Key << "EnableCulling" << YAML::Value << state->occlusionCulling;
       out << YAML::EndMap;
 
       out << YAML::Key << "ShadowSettings";
@@ -946,6 +978,10 @@ namespace Strontium
       for (auto entity : entities)
         deserializeEntity(entity, scene);
 
+      // The scene is batched once its models finish loading.
+      if (data["StaticBatching"])
+        scene->getStaticBatcher().setEnabled(data["StaticBatching"].as<bool>());
+
       auto rendererSettings = data["RendererSettings"];
       if (rendererSettings)
       {
@@ -955,6 +991,48 @@ namespace Strontium
         if (basicSettings)
         {
           state->frustumCull = basicSettings["FrustumCull"].as<bool>();
+          if (basicSettings["GPUCulling"])
+            state->gpuCulling = basicSettings["GPUCulling"].as<bool>();
+          if (basicSettings["ComputeSkinning"])
+            state->computeSkinning = basicSettings["ComputeSkinning"].as<bool>();
+        }
+
+        auto animationSettings = rendererSettings["AnimationSettings"];
+        if (animationSettings)
+        {
+          state->animationLOD = animationSettings["EnableLOD"].as<bool>();
+          state->aniLODFullRateSize = animationSettings["FullRateSize"].as<float>();
+          state->aniLODHalfRateSize = animationSettings["HalfRateSize"].as<float>();
+          state->aniLODReducedBonesSize = animationSettings["ReducedBonesSize"].as<float>();
+          state->aniLODDroppedBoneLevels = animationSettings["DroppedBoneLevels"].as<uint>();
+          state->aniLODFreezeOffscreen = animationSettings["FreezeOffscreen"].as<bool>();
+        }
+
+        auto meshLODSettings = rendererSettings["MeshLODSettings"];
+        if (meshLODSettings)
+        {
+          if (meshLODSettings["EnableLOD"])
+            state->meshLOD = meshLODSettings["EnableLOD"].as<bool>();
+          if (meshLODSettings["ErrorThreshold"])
+            state->meshLODThreshold = meshLODSettings["ErrorThreshold"].as<float>();
+          if (meshLODSettings["ShadowBias"])
+            state->meshLODShadowBias = meshLODSettings["ShadowBias"].as<float>();
+        }
+
+        auto meshletSettings = rendererSettings["MeshletSettings"];
+        if (meshletSettings)
+        {
+          if (meshletSettings["EnableCulling"])
+            state->meshletCulling = meshletSettings["EnableCulling"].as<bool>();
+          if (meshletSettings["ConeCulling"])
+            state->meshletConeCulling = meshletSettings["ConeCulling"].as<bool>();
+        }
+
+        auto occlusionSettings = rendererSettings["OcclusionSettings"];
+        if (occlusionSettings)
+        {
+          if (occlusionSettings["EnableCulling"])
+            state->occlusionCulling = occlusionSettings["EnableCulling"].as<bool>();
         }
 
         auto shadowSettings = rendererSettings["ShadowSettings"];
@@ -13,6 +13,7 @@
 
 // STL includes.
 #include <mutex>
+#include <atomic>
 #include <filesystem>
 
 namespace Strontium
@@ -24,6 +25,9 @@ namespace Strontium
     //--------------------------------------------------------------------------
     std::queue<std::tuple<Model*, Scene*, uint>> asyncModelQueue;
     std::mutex asyncModelMutex;
+    // Models pushed to the thread pool which haven't had their materials
+    // generated yet.
+    std::atomic<uint> numPendingModels(0);
 
     void
     bulkGenerateMaterials()
@@ -170,6 +174,7 @@ namespace Strontium
           }
         }
         asyncModelQueue.pop();
+        numPendingModels--;
       }
 
       for (auto& texturePath : texturesToLoad)
@@ -192,7 +197,7 @@ namespace Strontium
       }
 
       // Fetch the thread pool.
-      auto workerGroup = ThreadPool::getInstance(2);
+      auto workerGroup = ThreadPool::getInstance();
 
       auto loaderImpl = [](const std::string &filepath, const std::string &name,
                            uint entityID, Scene* activeScene)
@@ -218,7 +223,14 @@ namespace Strontium
         }
       };
 
-      workerGroup->push(loaderImpl, filepath, name, entityID, activeScene);
+      numPendingModels++;
+      workerGroup->pushBackground(loaderImpl, filepath, name, entityID, activeScene);
+    }
+
+    bool
+    hasPendingModels()
+    {
+      return numPendingModels > 0;
     }
 
     //--------------------------------------------------------------------------
@@ -379,7 +391,7 @@ namespace Strontium
       std::filesystem::path fsPath(filepath);
       
       // Fetch the thread pool and event dispatcher.
-      auto workerGroup = ThreadPool::getInstance(2);
+      auto workerGroup = ThreadPool::getInstance();
 
       auto loaderImpl = [](const std::filesystem::path& path, const Texture2DParams &params)
       {
@@ -414,7 +426,7 @@ namespace Strontium
         eventDispatcher->queueEvent(new GuiEvent(GuiEventType::EndSpinnerEvent, ""));
       };
 
-      workerGroup->push(loaderImpl, fsPath, params);
+      workerGroup->pushBackground(loaderImpl, fsPath, params);
     }
   }
 }